@@ -0,0 +1,40 @@
+import taichi as ti
+
+# Updating a small box of a large pointer grid, with a struct-for restricted to
+# the box (ti.bounded) versus a full struct-for that skips the other elements.
+
+N = 256
+B = 8
+
+
+def bounded_update(bounded):
+    a = ti.field(dtype=ti.f32)
+    ti.root.pointer(ti.ij, [N, N]).dense(ti.ij, [B, B]).place(a)
+
+    @ti.kernel
+    def fill():
+        for i, j in ti.ndrange(N * B, N * B):
+            a[i, j] = 1.0
+
+    @ti.kernel
+    def update(lo0: ti.i32, lo1: ti.i32, hi0: ti.i32, hi1: ti.i32):
+        if ti.static(bounded):
+            for i, j in ti.bounded(a, (lo0, lo1), (hi0, hi1)):
+                a[i, j] += 1.0
+        else:
+            for i, j in a:
+                if lo0 <= i < hi0 and lo1 <= j < hi1:
+                    a[i, j] += 1.0
+
+    fill()
+    return ti.benchmark(lambda: update(100, 200, 164, 264), repeat=30)
+
+
+@ti.archs_support_sparse
+def benchmark_box_bounded():
+    return bounded_update(True)
+
+
+@ti.archs_support_sparse
+def benchmark_box_full_loop():
+    return bounded_update(False)
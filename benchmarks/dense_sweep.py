@@ -0,0 +1,66 @@
+import taichi as ti
+
+# Sweeps over 3D dense fields, with the index arithmetic of each access
+# reduced to the loop index (see the strength_reduce_indices option) or not.
+
+
+def dense_sweep(layout):
+    n = 256
+    x, y = ti.field(ti.f32), ti.field(ti.f32)
+    if layout == 'flat':
+        block = ti.root.dense(ti.ijk, n)
+    else:
+        block = ti.root.dense(ti.ijk, n // 4).dense(ti.ijk, 4)
+    block.place(x)
+    block.place(y)
+
+    @ti.kernel
+    def saxpy():
+        for i, j, k in x:
+            y[i, j, k] = 2.0 * x[i, j, k] + y[i, j, k]
+
+    return ti.benchmark(saxpy, repeat=10)
+
+
+def range_sweep():
+    n = 256
+    x, y = ti.field(ti.f32, shape=(n, n, n)), ti.field(ti.f32, shape=(n, n, n))
+
+    @ti.kernel
+    def saxpy():
+        for i in range(n):
+            for j in range(n):
+                for k in range(n):
+                    y[i, j, k] = 2.0 * x[i, j, k] + y[i, j, k]
+
+    return ti.benchmark(saxpy, repeat=10)
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_dense_sweep_flat():
+    return dense_sweep('flat')
+
+
+@ti.archs_with([ti.cpu, ti.cuda], strength_reduce_indices=False)
+def benchmark_dense_sweep_flat_no_reduction():
+    return dense_sweep('flat')
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_dense_sweep_blocked():
+    return dense_sweep('blocked')
+
+
+@ti.archs_with([ti.cpu, ti.cuda], strength_reduce_indices=False)
+def benchmark_dense_sweep_blocked_no_reduction():
+    return dense_sweep('blocked')
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_range_sweep():
+    return range_sweep()
+
+
+@ti.archs_with([ti.cpu, ti.cuda], strength_reduce_indices=False)
+def benchmark_range_sweep_no_reduction():
+    return range_sweep()
@@ -0,0 +1,80 @@
+import taichi as ti
+
+# Compares grid layouts on the particle-to-grid scatter and grid-to-particle
+# gather of a 3D MPM-style transfer, where neighboring grid nodes along all
+# axes are accessed together.
+
+
+def transfer(layout):
+    n_grid = 128
+    n_particles = 2**20
+    dx, inv_dx = 1 / n_grid, float(n_grid)
+
+    x = ti.Vector.field(3, dtype=ti.f32, shape=n_particles)
+    v = ti.Vector.field(3, dtype=ti.f32, shape=n_particles)
+    grid_v = ti.Vector.field(3, dtype=ti.f32)
+    grid_m = ti.field(dtype=ti.f32)
+    block = ti.root.dense(ti.ijk, n_grid)
+    layout(block)
+    block.place(grid_v, grid_m)
+
+    @ti.kernel
+    def init():
+        for p in x:
+            # Particles fill the lower half of the domain
+            x[p] = [
+                ti.random() * 0.8 + 0.1,
+                ti.random() * 0.4 + 0.1,
+                ti.random() * 0.8 + 0.1
+            ]
+            v[p] = [0, -1, 0]
+
+    @ti.kernel
+    def substep():
+        for I in ti.grouped(grid_m):
+            grid_v[I] = [0, 0, 0]
+            grid_m[I] = 0
+        for p in x:
+            base = (x[p] * inv_dx - 0.5).cast(int)
+            fx = x[p] * inv_dx - base.cast(float)
+            w = [0.5 * (1.5 - fx)**2, 0.75 - (fx - 1)**2, 0.5 * (fx - 0.5)**2]
+            for i, j, k in ti.static(ti.ndrange(3, 3, 3)):
+                offset = ti.Vector([i, j, k])
+                weight = w[i][0] * w[j][1] * w[k][2]
+                grid_v[base + offset] += weight * v[p]
+                grid_m[base + offset] += weight
+        for I in ti.grouped(grid_m):
+            if grid_m[I] > 0:
+                grid_v[I] /= grid_m[I]
+        for p in x:
+            base = (x[p] * inv_dx - 0.5).cast(int)
+            fx = x[p] * inv_dx - base.cast(float)
+            w = [0.5 * (1.5 - fx)**2, 0.75 - (fx - 1)**2, 0.5 * (fx - 0.5)**2]
+            new_v = ti.Vector.zero(ti.f32, 3)
+            for i, j, k in ti.static(ti.ndrange(3, 3, 3)):
+                weight = w[i][0] * w[j][1] * w[k][2]
+                new_v += weight * grid_v[base + ti.Vector([i, j, k])]
+            v[p] = new_v
+
+    init()
+    ti.benchmark(substep, repeat=100)
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_transfer_row_major():
+    transfer(lambda block: None)
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_transfer_morton():
+    transfer(lambda block: block.morton())
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_transfer_tiled_4():
+    transfer(lambda block: block.tile(4))
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_transfer_tiled_8():
+    transfer(lambda block: block.tile(8))
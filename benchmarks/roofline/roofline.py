@@ -0,0 +1,310 @@
+"""Memory-bandwidth roofline benchmarks for CPU kernels.
+
+Each case reports the achieved GB/s and GFLOP/s of one kernel, together with
+the fraction of the roofline it reaches on this machine. The roofline is the
+minimum of the STREAM triad bandwidth times the arithmetic intensity of the
+kernel and the peak FMA throughput, both measured by stream.c. Since the
+fractions are normalized to the machine, baselines recorded on one machine
+remain meaningful on similar ones.
+
+Usage:
+    python roofline.py [-o result.json] [-b baseline.json] [-k CASE] [-s SIZE]
+
+With -b, cases whose roofline fraction dropped by more than --tolerance
+(relative) compared to the baseline are reported, and the exit code is 1.
+Record a baseline by saving the output of a run, e.g. into baselines/.
+"""
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+import taichi as ti
+
+cases = {}
+
+
+def case(name, **init_kwargs):
+    """Registers a case. The decorated function builds the fields and kernels
+    for |n| elements after ti.init, and returns (run, bytes, flops), where
+    |run| launches the measured kernels once, and |bytes| and |flops| are the
+    minimum memory traffic and floating point operations of one run."""
+    def decorator(func):
+        cases[name] = (func, init_kwargs)
+        return func
+
+    return decorator
+
+
+@case('dense_range_for_saxpy')
+def dense_range_for_saxpy(n):
+    x, y, z = [ti.field(ti.f32, shape=n) for _ in range(3)]
+
+    @ti.kernel
+    def saxpy(a: ti.f32):
+        for i in range(n):
+            z[i] = a * x[i] + y[i]
+
+    return lambda: saxpy(2.0), 12 * n, 2 * n
+
+
+@case('dense_struct_for_saxpy', demote_dense_struct_fors=False)
+def dense_struct_for_saxpy(n):
+    x, y, z = ti.field(ti.f32), ti.field(ti.f32), ti.field(ti.f32)
+    block = ti.root.dense(ti.i, n // 1024)
+    for f in [x, y, z]:
+        block.dense(ti.i, 1024).place(f)
+
+    @ti.kernel
+    def saxpy(a: ti.f32):
+        for i in z:
+            z[i] = a * x[i] + y[i]
+
+    return lambda: saxpy(2.0), 12 * n, 2 * n
+
+
+@case('bitmasked_struct_for_scale')
+def bitmasked_struct_for_scale(n):
+    x = ti.field(ti.f32)
+    ti.root.bitmasked(ti.i, n).place(x)
+
+    @ti.kernel
+    def activate():
+        for i in range(n):
+            if i % 2 == 0:
+                x[i] = 1.0
+
+    @ti.kernel
+    def scale(a: ti.f32):
+        for i in x:
+            x[i] = a * x[i]
+
+    activate()
+    # Half of the elements are active, each read and written once
+    return lambda: scale(0.5), 8 * (n // 2), n // 2
+
+
+@case('pointer_struct_for_scale')
+def pointer_struct_for_scale(n):
+    x = ti.field(ti.f32)
+    ti.root.pointer(ti.i, n // 1024).dense(ti.i, 1024).place(x)
+
+    @ti.kernel
+    def activate():
+        for i in range(n):
+            x[i] = 1.0
+
+    @ti.kernel
+    def scale(a: ti.f32):
+        for i in x:
+            x[i] = a * x[i]
+
+    activate()
+    return lambda: scale(0.5), 8 * n, n
+
+
+@case('dynamic_struct_for_scale')
+def dynamic_struct_for_scale(n):
+    x = ti.field(ti.f32)
+    ti.root.dynamic(ti.i, n, chunk_size=4096).place(x)
+
+    @ti.kernel
+    def fill():
+        for i in range(n):
+            ti.append(x.parent(), [], 1.0)
+
+    @ti.kernel
+    def scale(a: ti.f32):
+        for i in x:
+            x[i] = a * x[i]
+
+    fill()
+    return lambda: scale(0.5), 8 * n, n
+
+
+def make_sum(n):
+    x = ti.field(ti.f32, shape=n)
+    s = ti.field(ti.f32, shape=())
+
+    @ti.kernel
+    def reduce():
+        for i in x:
+            s[None] += x[i]
+
+    return reduce, 4 * n, n
+
+
+@case('tls_reduction', make_thread_local=True)
+def tls_reduction(n):
+    return make_sum(n)
+
+
+@case('atomic_reduction', make_thread_local=False)
+def atomic_reduction(n):
+    return make_sum(n)
+
+
+def make_stencil(n):
+    m = int(n**0.5) // 16 * 16
+    x, y = ti.field(ti.f32), ti.field(ti.f32)
+    for f in [x, y]:
+        ti.root.pointer(ti.ij, m // 16).dense(ti.ij, 16).place(f)
+
+    # Leave a margin of inactive blocks so that the stencil stays in bounds
+    @ti.kernel
+    def activate():
+        for i, j in ti.ndrange((16, m - 16), (16, m - 16)):
+            x[i, j] = 1.0
+
+    @ti.kernel
+    def stencil():
+        ti.cache_shared(x)
+        ti.block_dim(256)
+        for i, j in x:
+            y[i, j] = 0.2 * (x[i, j] + x[i - 1, j] + x[i + 1, j] +
+                             x[i, j - 1] + x[i, j + 1])
+
+    activate()
+    # Each active element of x is read once and of y written once
+    a = m - 32
+    return stencil, 8 * a * a, 5 * a * a
+
+
+@case('bls_stencil', make_block_local=True, demote_dense_struct_fors=False)
+def bls_stencil(n):
+    return make_stencil(n)
+
+
+@case('stencil_without_bls',
+      make_block_local=False,
+      demote_dense_struct_fors=False)
+def stencil_without_bls(n):
+    return make_stencil(n)
+
+
+def measure_machine(n):
+    """Runs stream.c. Returns its JSON output, or None if it cannot be
+    built."""
+    src = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'stream.c')
+    with tempfile.TemporaryDirectory() as tmpdir:
+        exe = os.path.join(tmpdir, 'stream')
+        cmd = [
+            os.environ.get('CC', 'cc'), '-O3', '-march=native', '-fopenmp',
+            '-o', exe, src
+        ]
+        try:
+            subprocess.run(cmd, check=True)
+        except (OSError, subprocess.CalledProcessError):
+            ti.warn(f'Cannot build the STREAM benchmark with {" ".join(cmd)}'
+                    ', roofline fractions will be missing')
+            return None
+        # Use the same number of threads as the Taichi thread pool
+        env = dict(os.environ, OMP_NUM_THREADS=str(os.cpu_count()))
+        out = subprocess.run([exe, str(n)],
+                             check=True,
+                             env=env,
+                             stdout=subprocess.PIPE).stdout
+    return json.loads(out)
+
+
+def measure(run, repeat):
+    # Warm up the caches and the page tables
+    for _ in range(3):
+        run()
+    ti.sync()
+    times = []
+    for _ in range(repeat):
+        t = time.perf_counter()
+        run()
+        ti.sync()
+        times.append(time.perf_counter() - t)
+    return statistics.median(times)
+
+
+def run_case(name, n, repeat, machine):
+    func, init_kwargs = cases[name]
+    ti.init(arch=ti.cpu, **init_kwargs)
+    run, num_bytes, flops = func(n)
+    t = measure(run, repeat)
+    result = {
+        'time_ms': t * 1e3,
+        'GBps': num_bytes / t * 1e-9,
+        'GFLOPps': flops / t * 1e-9,
+        'arithmetic_intensity': flops / num_bytes,
+    }
+    if machine:
+        roofline = min(machine['triad_GBps'] * result['arithmetic_intensity'],
+                       machine['peak_GFLOPps'])
+        result['roofline_GFLOPps'] = roofline
+        result['roofline_fraction'] = result['GFLOPps'] / roofline
+        result['bandwidth_fraction'] = result['GBps'] / machine['triad_GBps']
+    return result
+
+
+def compare(results, baseline, tolerance):
+    """Returns the names of the cases that regressed."""
+    regressions = []
+    for name, result in results['cases'].items():
+        base = baseline['cases'].get(name)
+        if base is None or 'roofline_fraction' not in result or \
+                'roofline_fraction' not in base:
+            continue
+        ratio = result['roofline_fraction'] / base['roofline_fraction']
+        status = 'ok'
+        if ratio < 1 - tolerance:
+            status = 'REGRESSION'
+            regressions.append(name)
+        print(f'{name:32} {base["roofline_fraction"]:7.1%} -> '
+              f'{result["roofline_fraction"]:7.1%}  {status}')
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('-o', '--output', help='Write the results as JSON')
+    parser.add_argument('-b', '--baseline', help='Compare to a stored result')
+    parser.add_argument('-k',
+                        '--case',
+                        action='append',
+                        choices=sorted(cases),
+                        help='Run only these cases')
+    parser.add_argument('-s',
+                        '--size',
+                        type=int,
+                        default=1 << 26,
+                        help='Number of elements per field')
+    parser.add_argument('-r', '--repeat', type=int, default=20)
+    parser.add_argument('--tolerance',
+                        type=float,
+                        default=0.1,
+                        help='Allowed relative drop of the roofline fraction')
+    args = parser.parse_args()
+
+    machine = measure_machine(args.size)
+    results = {'machine': machine, 'size': args.size, 'cases': {}}
+    for name in args.case or sorted(cases):
+        result = run_case(name, args.size, args.repeat, machine)
+        results['cases'][name] = result
+        print(f'{name:32} {result["time_ms"]:9.3f} ms '
+              f'{result["GBps"]:8.2f} GB/s {result["GFLOPps"]:8.2f} GFLOP/s ' +
+              (f'{result["roofline_fraction"]:7.1%} of roofline'
+               if machine else ''))
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(results, f, indent=2)
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        if compare(results, baseline, args.tolerance):
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
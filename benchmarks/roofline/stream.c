@@ -0,0 +1,106 @@
+// STREAM-style measurement of the machine roofline: the sustainable memory
+// bandwidth of copy/scale/add/triad with all cores, and the peak single
+// precision FMA throughput. Prints a JSON object on stdout.
+//
+// Built and run by roofline.py with: cc -O3 -march=native -fopenmp
+
+#include <float.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_TRIALS 10
+#define FMA_CHAINS 16
+#define FMA_WIDTH 8
+#define FMA_ITERATIONS 1000000
+
+static double best_time(double t, double best) {
+  return t < best ? t : best;
+}
+
+static double peak_gflops(void) {
+  double best = DBL_MAX;
+  float trash = 0;
+  for (int trial = 0; trial < 3; trial++) {
+    double t = omp_get_wtime();
+#pragma omp parallel reduction(+ : trash)
+    {
+      float acc[FMA_CHAINS][FMA_WIDTH];
+      float x = 0.999f + omp_get_thread_num() * 1e-6f, y = 1e-3f;
+      for (int i = 0; i < FMA_CHAINS; i++)
+        for (int j = 0; j < FMA_WIDTH; j++)
+          acc[i][j] = (float)(i * FMA_WIDTH + j);
+      // Independent chains hide the FMA latency
+      for (int k = 0; k < FMA_ITERATIONS; k++)
+        for (int i = 0; i < FMA_CHAINS; i++)
+          for (int j = 0; j < FMA_WIDTH; j++)
+            acc[i][j] = acc[i][j] * x + y;
+      for (int i = 0; i < FMA_CHAINS; i++)
+        for (int j = 0; j < FMA_WIDTH; j++)
+          trash += acc[i][j];
+    }
+    best = best_time(omp_get_wtime() - t, best);
+  }
+  if (trash == 42)
+    fprintf(stderr, "%f\n", trash);
+  double flops = 2.0 * FMA_ITERATIONS * FMA_CHAINS * FMA_WIDTH *
+                 omp_get_max_threads();
+  return flops / best * 1e-9;
+}
+
+int main(int argc, char **argv) {
+  long n = argc > 1 ? atol(argv[1]) : 1L << 26;
+  double *a = malloc(sizeof(double) * n);
+  double *b = malloc(sizeof(double) * n);
+  double *c = malloc(sizeof(double) * n);
+  if (!a || !b || !c) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  // First touch by the threads that use the pages later
+#pragma omp parallel for
+  for (long i = 0; i < n; i++) {
+    a[i] = 1.0;
+    b[i] = 2.0;
+    c[i] = 0.0;
+  }
+
+  const double s = 3.0;
+  double copy = DBL_MAX, scale = DBL_MAX, add = DBL_MAX, triad = DBL_MAX;
+  for (int trial = 0; trial < NUM_TRIALS; trial++) {
+    double t = omp_get_wtime();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+      c[i] = a[i];
+    copy = best_time(omp_get_wtime() - t, copy);
+
+    t = omp_get_wtime();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+      b[i] = s * c[i];
+    scale = best_time(omp_get_wtime() - t, scale);
+
+    t = omp_get_wtime();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+      c[i] = a[i] + b[i];
+    add = best_time(omp_get_wtime() - t, add);
+
+    t = omp_get_wtime();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+      a[i] = b[i] + s * c[i];
+    triad = best_time(omp_get_wtime() - t, triad);
+  }
+
+  double bytes = (double)sizeof(double) * n * 1e-9;
+  printf(
+      "{\"threads\": %d, \"copy_GBps\": %.3f, \"scale_GBps\": %.3f, "
+      "\"add_GBps\": %.3f, \"triad_GBps\": %.3f, \"peak_GFLOPps\": %.3f}\n",
+      omp_get_max_threads(), 2 * bytes / copy, 2 * bytes / scale,
+      3 * bytes / add, 3 * bytes / triad, peak_gflops());
+  free(a);
+  free(b);
+  free(c);
+  return 0;
+}
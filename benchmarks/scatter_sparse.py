@@ -0,0 +1,68 @@
+import taichi as ti
+
+
+@ti.archs_support_sparse
+def benchmark_scatter_contended_activation():
+    # Many particles scatter into a few blocks that are not yet active, so that
+    # threads race to activate the same pointer cells.
+    a = ti.field(dtype=ti.f32)
+    x = ti.Vector.field(2, dtype=ti.i32, shape=1024 * 1024)
+    N = 512
+
+    ti.root.pointer(ti.ij, [N, N]).dense(ti.ij, [8, 8]).place(a)
+
+    @ti.kernel
+    def seed():
+        for p in x:
+            x[p] = ti.Vector([ti.random() * 64, ti.random() * 64]).cast(int)
+
+    @ti.kernel
+    def scatter():
+        for p in x:
+            a[x[p]] += 1.0
+
+    @ti.kernel
+    def clear():
+        for i, j in a.parent():
+            ti.deactivate(a.parent().parent(), [i, j])
+
+    seed()
+
+    def task():
+        scatter()
+        clear()
+
+    return ti.benchmark(task, repeat=30)
+
+
+@ti.archs_support_sparse
+def benchmark_scatter_sparse_activation():
+    # Each particle activates its own block; measures the uncontended path.
+    a = ti.field(dtype=ti.f32)
+    N = 512
+    x = ti.Vector.field(2, dtype=ti.i32, shape=N * N)
+
+    ti.root.pointer(ti.ij, [N, N]).dense(ti.ij, [8, 8]).place(a)
+
+    @ti.kernel
+    def seed():
+        for p in x:
+            x[p] = ti.Vector([p // N, p % N]) * 8
+
+    @ti.kernel
+    def scatter():
+        for p in x:
+            a[x[p]] += 1.0
+
+    @ti.kernel
+    def clear():
+        for i, j in a.parent():
+            ti.deactivate(a.parent().parent(), [i, j])
+
+    seed()
+
+    def task():
+        scatter()
+        clear()
+
+    return ti.benchmark(task, repeat=30)
@@ -0,0 +1,64 @@
+import taichi as ti
+
+# 7-point and 27-point stencils over dense and pointer grids. On pointer grids,
+# most neighbors lie in the block of the center, so their sparse lookups can be
+# shared (see the reuse_neighbor_lookups option).
+
+
+def stencil(layout, points):
+    n = 128
+    b = 8
+    x, y = ti.field(ti.f32), ti.field(ti.f32)
+    if layout == 'dense':
+        block = ti.root.dense(ti.ijk, n // b).dense(ti.ijk, b)
+    else:
+        block = ti.root.pointer(ti.ijk, n // b).dense(ti.ijk, b)
+    block.place(x, y)
+
+    @ti.kernel
+    def fill():
+        for i, j, k in ti.ndrange(n, n, n):
+            x[i, j, k] = 1.0
+
+    if points == 7:
+        offsets = [(0, 0, 0), (-1, 0, 0), (1, 0, 0), (0, -1, 0), (0, 1, 0),
+                   (0, 0, -1), (0, 0, 1)]
+    else:
+        offsets = [(i, j, k) for i in range(-1, 2) for j in range(-1, 2)
+                   for k in range(-1, 2)]
+
+    @ti.kernel
+    def step():
+        for I in ti.grouped(x):
+            s = 0.0
+            for o in ti.static(offsets):
+                s += x[I + ti.Vector(o)]
+            y[I] = s * (1 / len(offsets))
+
+    fill()
+    return ti.benchmark(step, repeat=30)
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_stencil_7_dense():
+    return stencil('dense', 7)
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_stencil_27_dense():
+    return stencil('dense', 27)
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_stencil_7_pointer():
+    return stencil('pointer', 7)
+
+
+@ti.archs_with([ti.cpu, ti.cuda])
+def benchmark_stencil_27_pointer():
+    return stencil('pointer', 27)
+
+
+@ti.archs_with([ti.cpu, ti.cuda], reuse_neighbor_lookups=False)
+def benchmark_stencil_27_pointer_no_reuse():
+    return stencil('pointer', 27)
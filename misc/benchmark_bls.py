@@ -4,7 +4,11 @@ sys.path.append('../tests/python/')
 
 from bls_test_template import bls_test_template
 
-ti.init(arch=ti.gpu,
+# Usage: python benchmark_bls.py [cpu|gpu] [nobls]
+arch = ti.cpu if 'cpu' in sys.argv[1:] else ti.gpu
+
+ti.init(arch=arch,
+        make_block_local='nobls' not in sys.argv[1:],
         print_ir=True,
         kernel_profiler=True,
         demote_dense_struct_fors=False)
@@ -0,0 +1,43 @@
+import taichi as ti
+import numpy as np
+import time
+
+ti.init()
+
+x = ti.field(ti.f32, shape=16)
+
+
+@ti.kernel
+def no_args():
+    pass
+
+
+@ti.kernel
+def scalar_args(a: ti.i32, b: ti.f32, c: ti.i64, d: ti.f64):
+    pass
+
+
+@ti.kernel
+def array_arg(arr: ti.ext_arr()):
+    pass
+
+
+@ti.kernel
+def template_args(f: ti.template(), a: ti.i32):
+    pass
+
+
+def benchmark(name, func, *args, n=100000):
+    func(*args)
+    t = time.time()
+    for i in range(n):
+        func(*args)
+    print(f'{name:>24}: {(time.time() - t) / n * 1e6:.3f} us')
+
+
+arr = np.zeros(16, dtype=np.float32)
+
+benchmark('no arguments', no_args)
+benchmark('4 scalar arguments', scalar_args, 1, 2.0, 3, 4.0)
+benchmark('numpy array argument', array_arg, arr, n=20000)
+benchmark('template + scalar', template_args, x, 1)
@@ -1,71 +1,100 @@
-# This file has a kernel with 16 equal offloaded tasks.
+# Compiles many MPM substep kernels (each with 4 equal offloaded tasks) ahead
+# of time, serially and then on all hardware threads, and reports the speedup.
+# Usage: python benchmark_parallel_compilation.py [num_kernels]
 
+import sys
+import time
 import taichi as ti
-ti.init(arch=ti.x64)
-quality = 1  # Use a larger value for higher-res simulations
-n_particles, n_grid = 9000 * quality**2, 128 * quality
-dx, inv_dx = 1 / n_grid, float(n_grid)
-dt = 1e-4 / quality
-p_vol, p_rho = (dx * 0.5)**2, 1
-p_mass = p_vol * p_rho
-E, nu = 0.1e4, 0.2  # Young's modulus and Poisson's ratio
-mu_0, lambda_0 = E / (2 * (1 + nu)), E * nu / (
-    (1 + nu) * (1 - 2 * nu))  # Lame parameters
-x = ti.Vector.field(2, ti.f32, shape=n_particles)  # position
-v = ti.Vector.field(2, ti.f32, shape=n_particles)  # velocity
-# affine velocity field
-C = ti.Matrix.field(2, 2, ti.f32, shape=n_particles)
-# deformation gradient
-F = ti.Matrix.field(2, 2, ti.f32, shape=n_particles)
-material = ti.field(dtype=int, shape=n_particles)  # material id
-Jp = ti.field(ti.f32, shape=n_particles)  # plastic deformation
-grid_v = ti.Vector.field(2, ti.f32,
-                         shape=(n_grid, n_grid))  # grid node momentum/velocity
-grid_m = ti.field(ti.f32, shape=(n_grid, n_grid))  # grid node mass
 
+num_kernels = int(sys.argv[1]) if len(sys.argv) > 1 else 32
 
-@ti.kernel
-def substep():
-    for K in ti.static(range(4)):
-        for p in x:
-            base = (x[p] * inv_dx - 0.5).cast(int)
-            fx = x[p] * inv_dx - base.cast(float)
-            w = [0.5 * (1.5 - fx)**2, 0.75 - (fx - 1)**2, 0.5 * (fx - 0.5)**2]
-            F[p] = (ti.Matrix.identity(ti.f32, 2) + dt * C[p]) @ F[p]
-            h = ti.exp(10 * (1.0 - Jp[p]))
-            if material[p] == 1:
-                h = 0.3
-            mu, la = mu_0 * h, lambda_0 * h
-            if material[p] == 0:  # liquid
-                mu = 0.0
-            U, sig, V = ti.svd(F[p])
-            J = 1.0
-            for d in ti.static(range(2)):
-                new_sig = sig[d, d]
-                if material[p] == 2:  # Snow
-                    new_sig = min(max(sig[d, d], 1 - 2.5e-2), 1 + 4.5e-3)
-                Jp[p] *= sig[d, d] / new_sig
-                sig[d, d] = new_sig
-                J *= new_sig
-            if material[p] == 0:
-                F[p] = ti.Matrix.identity(ti.f32, 2) * ti.sqrt(J)
-            elif material[p] == 2:
-                F[p] = U @ sig @ V.T()
-            stress = 2 * mu * (F[p] - U @ V.T()) @ F[p].T(
-            ) + ti.Matrix.identity(ti.f32, 2) * la * J * (J - 1)
-            stress = (-dt * p_vol * 4 * inv_dx * inv_dx) * stress
-            affine = stress + p_mass * C[p]
-            for i, j in ti.static(ti.ndrange(3, 3)):
-                offset = ti.Vector([i, j])
-                dpos = (offset.cast(float) - fx) * dx
-                weight = w[i][0] * w[j][1]
-                grid_v[base +
-                       offset] += weight * (p_mass * v[p] + affine @ dpos)
-                grid_m[base + offset] += weight * p_mass
 
+def define_fields():
+    global quality, n_particles, n_grid, dx, inv_dx, dt, p_vol, p_rho, p_mass
+    global E, nu, mu_0, lambda_0, x, v, C, F, material, Jp, grid_v, grid_m
+    quality = 1  # Use a larger value for higher-res simulations
+    n_particles, n_grid = 9000 * quality**2, 128 * quality
+    dx, inv_dx = 1 / n_grid, float(n_grid)
+    dt = 1e-4 / quality
+    p_vol, p_rho = (dx * 0.5)**2, 1
+    p_mass = p_vol * p_rho
+    E, nu = 0.1e4, 0.2  # Young's modulus and Poisson's ratio
+    mu_0, lambda_0 = E / (2 * (1 + nu)), E * nu / (
+        (1 + nu) * (1 - 2 * nu))  # Lame parameters
+    x = ti.Vector.field(2, ti.f32, shape=n_particles)  # position
+    v = ti.Vector.field(2, ti.f32, shape=n_particles)  # velocity
+    # affine velocity field
+    C = ti.Matrix.field(2, 2, ti.f32, shape=n_particles)
+    # deformation gradient
+    F = ti.Matrix.field(2, 2, ti.f32, shape=n_particles)
+    material = ti.field(dtype=int, shape=n_particles)  # material id
+    Jp = ti.field(ti.f32, shape=n_particles)  # plastic deformation
+    # grid node momentum/velocity
+    grid_v = ti.Vector.field(2, ti.f32, shape=(n_grid, n_grid))
+    grid_m = ti.field(ti.f32, shape=(n_grid, n_grid))  # grid node mass
 
-for i in range(32):
-    substep()
 
-ti.kernel_profiler_print()
-ti.core.print_profile_info()
+def make_substep(variant):
+    @ti.kernel
+    def substep():
+        for K in ti.static(range(4)):
+            for p in x:
+                base = (x[p] * inv_dx - 0.5).cast(int)
+                fx = x[p] * inv_dx - base.cast(float)
+                w = [
+                    0.5 * (1.5 - fx)**2, 0.75 - (fx - 1)**2,
+                    0.5 * (fx - 0.5)**2
+                ]
+                F[p] = (ti.Matrix.identity(ti.f32, 2) + dt * C[p]) @ F[p]
+                h = ti.exp(10 * (1.0 - Jp[p]))
+                if material[p] == 1:
+                    h = 0.3
+                mu, la = mu_0 * h, lambda_0 * h
+                if material[p] == 0:  # liquid
+                    mu = 0.0
+                U, sig, V = ti.svd(F[p])
+                J = 1.0
+                for d in ti.static(range(2)):
+                    new_sig = sig[d, d]
+                    if material[p] == 2:  # Snow
+                        new_sig = min(max(sig[d, d], 1 - 2.5e-2), 1 + 4.5e-3)
+                    Jp[p] *= sig[d, d] / new_sig
+                    sig[d, d] = new_sig
+                    J *= new_sig
+                if material[p] == 0:
+                    F[p] = ti.Matrix.identity(ti.f32, 2) * ti.sqrt(J)
+                elif material[p] == 2:
+                    F[p] = U @ sig @ V.T()
+                stress = 2 * mu * (F[p] - U @ V.T()) @ F[p].T(
+                ) + ti.Matrix.identity(ti.f32, 2) * la * J * (J - 1)
+                stress = (-dt * p_vol * 4 * inv_dx * inv_dx) * stress
+                affine = stress + p_mass * C[p]
+                for i, j in ti.static(ti.ndrange(3, 3)):
+                    offset = ti.Vector([i, j])
+                    dpos = (offset.cast(float) - fx) * dx
+                    weight = w[i][0] * w[j][1]
+                    grid_v[base +
+                           offset] += weight * (p_mass * v[p] + affine @ dpos)
+                    grid_m[base + offset] += weight * p_mass * (1 + variant)
+
+    return substep
+
+
+def run(num_threads):
+    ti.init(arch=ti.x64)
+    define_fields()
+    kernels = [make_substep(i) for i in range(num_kernels)]
+    t = time.time()
+    compile_times = ti.compile_kernels(*kernels, num_threads=num_threads)
+    wall = time.time() - t
+    slowest = max(compile_times.values())
+    print(f'{num_threads} thread(s): {wall:.2f} s wall, '
+          f'{sum(compile_times.values()):.2f} s summed over kernels, '
+          f'slowest kernel {slowest:.2f} s')
+    ti.reset()
+    return wall
+
+
+serial = run(1)
+parallel = run(0)
+print(f'Speedup: {serial / parallel:.2f}x on {num_kernels} kernels')
@@ -4,7 +4,12 @@ sys.path.append('../tests/python/')
 
 from bls_test_template import bls_particle_grid
 
-ti.init(arch=ti.cuda, kernel_profiler=True)
+# Usage: python benchmark_scatter_bls.py [cpu|cuda] [nobls]
+arch = ti.cpu if 'cpu' in sys.argv[1:] else ti.cuda
+
+ti.init(arch=arch,
+        make_block_local='nobls' not in sys.argv[1:],
+        kernel_profiler=True)
 bls_particle_grid(N=512,
                   ppc=10,
                   block_size=16,
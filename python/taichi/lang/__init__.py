@@ -3,6 +3,8 @@ from .util import deprecated
 from .matrix import Matrix, Vector
 from .transformer import TaichiSyntaxError
 from .ndrange import ndrange, GroupedNDRange
+from .fields_builder import FieldsBuilder, SNodeTree
+from . import aot
 from copy import deepcopy as _deepcopy
 import functools
 import os
@@ -46,6 +48,8 @@ kernel_profiler_print = lambda: get_runtime().prog.kernel_profiler_print()
 kernel_profiler_clear = lambda: get_runtime().prog.kernel_profiler_clear()
 kernel_profiler_total_time = lambda: get_runtime(
 ).prog.kernel_profiler_total_time()
+kernel_profiler_dump = lambda filename: get_runtime(
+).prog.kernel_profiler_dump(filename)
 
 
 def memory_profiler_print():
@@ -53,6 +57,39 @@ def memory_profiler_print():
     get_runtime().prog.print_memory_profiler_info()
 
 
+def print_layout_advice():
+    """Prints the memory traffic of the kernels launched so far, and the
+    grouping of fields into AoS/SoA layouts that reduces it, as estimated by
+    the layout advisor (see ``ti.init(layout_advisor=True)``)."""
+    get_runtime().materialize()
+    get_runtime().prog.print_layout_advice()
+
+
+def save_layout_advice(filename):
+    """Saves the grouping proposed by the layout advisor, to be applied by
+    ``ti.init(layout_advice_file=filename)`` in later runs of the program."""
+    get_runtime().materialize()
+    get_runtime().prog.save_layout_advice(filename)
+
+
+def layout_advice():
+    """Returns the advice of the layout advisor as a dict. ``'current'`` and
+    ``'proposed'`` are lists of groups of fields, as lists of place SNodes,
+    each group in its own dense node. ``'current_bytes'`` and
+    ``'proposed_bytes'`` are the estimated bytes moved by the recorded
+    launches under each grouping."""
+    get_runtime().materialize()
+    current, proposed, current_bytes, proposed_bytes = get_runtime(
+    ).prog.get_layout_advice()
+    to_snodes = lambda groups: [[SNode(p) for p in g] for g in groups]
+    return {
+        'current': to_snodes(current),
+        'proposed': to_snodes(proposed),
+        'current_bytes': current_bytes,
+        'proposed_bytes': proposed_bytes
+    }
+
+
 extension = core.Extension
 is_extension_supported = core.is_extension_supported
 
@@ -262,7 +299,7 @@ determinant = deprecated('ti.determinant(a)',
 tr = deprecated('ti.tr(a)', 'a.trace()')(Matrix.trace)
 
 
-def Tape(loss, clear_gradients=True):
+def Tape(loss, clear_gradients=True, checkpoint_fields=None):
     get_runtime().materialize()
     if len(loss.shape) != 0:
         raise RuntimeError(
@@ -277,7 +314,7 @@ def Tape(loss, clear_gradients=True):
     from .meta import clear_loss
     clear_loss(loss)
 
-    return runtime.get_tape(loss)
+    return runtime.get_tape(loss, checkpoint_fields)
 
 
 def clear_all_gradients():
@@ -781,4 +818,32 @@ def sync():
     get_runtime().sync()
 
 
+def compile_kernels(*kernels, num_threads=0, verbose=False):
+    """Compiles kernels ahead of their first launch, in parallel on LLVM
+    backends.
+
+    Each item is a kernel, or a tuple of a kernel and example arguments that
+    select its instance. Without items, all kernels materialized so far are
+    compiled. ``num_threads=0`` uses all hardware threads.
+
+    Returns a dict from kernel names to compile times in seconds.
+    """
+    get_runtime().materialize()
+    taichi_kernels = []
+    for k in kernels:
+        if isinstance(k, tuple):
+            taichi_kernels.append(materialize_kernel(k[0], k[1:]))
+        else:
+            taichi_kernels.append(materialize_kernel(k))
+    compile_times = get_runtime().prog.compile_kernels(taichi_kernels,
+                                                       num_threads)
+    if verbose:
+        total = sum(t for _, t in compile_times)
+        print(f'Compiled {len(compile_times)} kernels, '
+              f'{total:.3f} s in total:')
+        for name, t in sorted(compile_times, key=lambda x: -x[1]):
+            print(f'  {t * 1000:10.2f} ms  {name}')
+    return dict(compile_times)
+
+
 __all__ = [s for s in dir() if not s.startswith('_')]
@@ -0,0 +1,43 @@
+from .core import taichi_lang_core
+from .kernel import materialize_kernel
+from . import impl
+
+
+class Module:
+    """Collects kernels for ahead-of-time export to a standalone CPU module.
+
+    The saved module contains the optimized kernels, the LLVM runtime and a
+    small C API that initializes the materialized fields and launches the
+    kernels, so that a host application needs neither Python nor a JIT.
+
+    Example::
+
+        m = ti.aot.Module()
+        m.add_kernel(substep)
+        m.add_kernel(paint, 0.5)  # example arguments for non-field args
+        m.save('build', 'sim')  # build/sim.{o,h,c,so}
+    """
+    def __init__(self):
+        impl.get_runtime().materialize()
+        self._builder = taichi_lang_core.make_aot_module_builder_cpu()
+
+    def add_kernel(self, kernel_fn, *example_args, name=None):
+        """Adds a kernel, instantiated for |example_args|.
+
+        Template arguments are fixed at export time. Other arguments only
+        contribute their types, and are set through the C API at launch.
+        The launch function is named <module>_<name>, where |name| defaults
+        to the Python function name. The kernel may only access fields placed
+        under ti.root, not ones built with ti.FieldsBuilder.
+        """
+        if name is None:
+            name = kernel_fn._primal.func.__name__
+        self._builder.add(name, materialize_kernel(kernel_fn, example_args))
+
+    def save(self, dirname, name, shared=True):
+        """Writes <name>.o, <name>.h and <name>.c to |dirname|.
+
+        With |shared|, they are also linked into <name>.so using the system
+        C compiler.
+        """
+        self._builder.dump(dirname, name, shared)
@@ -0,0 +1,87 @@
+from . import impl
+from .snode import SNode
+
+
+class FieldsBuilder:
+    """Builds the layout of fields in a new SNode tree, with its own root
+    buffer. Unlike ``ti.root``, a tree can be added after kernels have run,
+    without recompiling them, and its memory can be freed when it is no
+    longer needed. LLVM backends (CPU and CUDA) only.
+
+    Example::
+
+        fb = ti.FieldsBuilder()
+        x = ti.field(ti.f32)
+        fb.pointer(ti.ij, 16).dense(ti.ij, 8).place(x)
+        tree = fb.finalize()  # x can be used from here on
+        ...
+        tree.destroy()  # x must not be used anymore
+    """
+    def __init__(self):
+        impl.get_runtime().create_program()
+        self.ptr = impl.get_runtime().prog.add_snode_tree()
+        self.root = SNode(self.ptr)
+        self.finalized = False
+
+    def _check_not_finalized(self):
+        assert not self.finalized, 'This FieldsBuilder has been finalized'
+
+    def dense(self, indices, dimensions, list_chunk_size=None):
+        self._check_not_finalized()
+        return self.root.dense(indices, dimensions, list_chunk_size)
+
+    def pointer(self, indices, dimensions, list_chunk_size=None):
+        self._check_not_finalized()
+        return self.root.pointer(indices, dimensions, list_chunk_size)
+
+    def bitmasked(self, indices, dimensions, list_chunk_size=None):
+        self._check_not_finalized()
+        return self.root.bitmasked(indices, dimensions, list_chunk_size)
+
+    def dynamic(self, index, dimension, chunk_size=None, **kwargs):
+        self._check_not_finalized()
+        return self.root.dynamic(index, dimension, chunk_size, **kwargs)
+
+    def hash(self, indices, dimensions):
+        self._check_not_finalized()
+        return self.root.hash(indices, dimensions)
+
+    def place(self, *args, offset=None):
+        self._check_not_finalized()
+        return self.root.place(*args, offset=offset)
+
+    def finalize(self):
+        """Compiles the tree and allocates its memory. Fields placed in
+        ``ti.root`` are materialized first, if they are not yet."""
+        self._check_not_finalized()
+        runtime = impl.get_runtime()
+        runtime.materialize()
+        runtime.prog.materialize_snode_tree(self.ptr)
+        self.finalized = True
+        return SNodeTree(self.ptr)
+
+
+class SNodeTree:
+    """An SNode tree created by :func:`FieldsBuilder.finalize`."""
+    def __init__(self, ptr):
+        self.ptr = ptr
+        self.destroyed = False
+
+    def destroy(self):
+        """Frees the memory of the tree. Accessing its fields, or launching
+        kernels that access them, raises an error afterwards."""
+        assert not self.destroyed, 'This SNode tree has been destroyed'
+        runtime = impl.get_runtime()
+        tree_id = self.ptr.snode_tree_id
+        runtime.prog.destroy_snode_tree(self.ptr)
+        self.destroyed = True
+
+        def destroyed(*args):
+            raise RuntimeError('The field belongs to a destroyed SNode tree')
+
+        # No live tree can share the slot of this one yet
+        for var in runtime.global_vars:
+            snode = var.ptr.snode()
+            if snode is not None and snode.snode_tree_id == tree_id:
+                var.getter = destroyed
+                var.setter = destroyed
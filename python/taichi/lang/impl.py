@@ -1,3 +1,4 @@
+import collections
 import inspect
 from .core import taichi_lang_core
 from .expr import Expr
@@ -61,6 +62,10 @@ def expr_init_func(
 
 
 def begin_frontend_struct_for(group, loop_range):
+    bounds = None
+    if isinstance(loop_range, BoundedLoopRange):
+        bounds = loop_range
+        loop_range = bounds.var
     if not isinstance(loop_range, Expr) or not loop_range.is_global():
         raise TypeError('Can only iterate through global variables/fields')
     if group.size() != len(loop_range.shape):
@@ -69,6 +74,17 @@ def begin_frontend_struct_for(group, loop_range):
             f'({group.size()} != {len(loop_range.shape)}). Maybe you wanted to '
             'use "for I in ti.grouped(x)" to group all indices into a single vector I?'
         )
+    if bounds is not None:
+        if len(bounds.lower) != group.size() or len(
+                bounds.upper) != group.size():
+            raise IndexError(
+                'Bounding box of the struct-for does not match loop variable dimensionality '
+                f'({len(bounds.lower)}, {len(bounds.upper)} != {group.size()})'
+            )
+        taichi_lang_core.begin_frontend_bounded_struct_for(
+            group, loop_range.ptr, bounds.lower_group(),
+            bounds.upper_group())
+        return
     taichi_lang_core.begin_frontend_struct_for(group, loop_range.ptr)
 
 
@@ -194,10 +210,33 @@ class PyTaichi:
         self.target_tape = None
         self.inside_complex_kernel = False
         self.kernels = kernels or []
+        # See ti.cfg.max_num_kernels
+        self.max_num_kernels = 0
+        # Kernel instances, least recently launched first
+        self.kernel_lru = collections.OrderedDict()
 
     def get_num_compiled_functions(self):
         return len(self.compiled_functions) + len(self.compiled_grad_functions)
 
+    def touch_kernel(self, compiled_functions, key):
+        """Marks a kernel instance as the most recently launched one, and
+        deletes the least recently launched ones beyond max_num_kernels."""
+        lru_key = (id(compiled_functions), key)
+        if lru_key in self.kernel_lru:
+            self.kernel_lru.move_to_end(lru_key)
+            return
+        self.kernel_lru[lru_key] = (compiled_functions, key)
+        while len(self.kernel_lru) > self.max_num_kernels:
+            _, (functions, old_key) = self.kernel_lru.popitem(last=False)
+            self.delete_kernel(functions, old_key)
+
+    def delete_kernel(self, compiled_functions, key):
+        function = compiled_functions.pop(key, None)
+        if function is None:
+            return
+        self.kernel_lru.pop((id(compiled_functions), key), None)
+        self.prog.delete_kernel(function.taichi_kernel)
+
     def set_default_fp(self, fp):
         assert fp in [f32, f64]
         self.default_fp = fp
@@ -227,6 +266,7 @@ class PyTaichi:
         ti.trace('Materializing layout...')
         taichi_lang_core.layout(layout)
         self.materialized = True
+        self.max_num_kernels = default_cfg().max_num_kernels
         not_placed = []
         for var in self.global_vars:
             if var.ptr.snode() is None:
@@ -251,9 +291,9 @@ class PyTaichi:
             self.prog = None
         self.materialized = False
 
-    def get_tape(self, loss=None):
+    def get_tape(self, loss=None, checkpoint_fields=None):
         from .tape import Tape
-        return Tape(self, loss)
+        return Tape(self, loss, checkpoint_fields)
 
     def sync(self):
         self.materialize()
@@ -342,6 +382,16 @@ class Root:
 root = Root()
 
 
+def _check_not_materialized():
+    if get_runtime().materialized:
+        raise RuntimeError(
+            "No new variables can be declared after materialization, i.e. kernel invocations "
+            "or Python-scope field accesses. I.e., data layouts must be specified before "
+            "any computation. Try appending ti.init() or ti.reset() "
+            "right after 'import taichi as ti' if you are using Jupyter notebook or Blender, "
+            "or place new fields with ti.FieldsBuilder.")
+
+
 @deprecated('ti.var', 'ti.field')
 def var(dt, shape=None, offset=None, needs_grad=False):
     _taichi_skip_traceback = 1
@@ -368,13 +418,9 @@ def field(dtype, shape=None, offset=None, needs_grad=False):
     assert (offset is not None and shape is None
             ) == False, f'The shape cannot be None when offset is being set'
 
-    if get_runtime().materialized:
-        raise RuntimeError(
-            "No new variables can be declared after materialization, i.e. kernel invocations "
-            "or Python-scope field accesses. I.e., data layouts must be specified before "
-            "any computation. Try appending ti.init() or ti.reset() "
-            "right after 'import taichi as ti' if you are using Jupyter notebook or Blender."
-        )
+    # Fields without a shape can still be placed with ti.FieldsBuilder
+    if shape is not None:
+        _check_not_materialized()
 
     del _taichi_skip_traceback
 
@@ -549,6 +595,54 @@ def static(x, *xs):
         )
 
 
+class BoundedLoopRange:
+    def __init__(self, var, lower, upper):
+        self.var = var.loop_range()
+        self.lower = self._entries(lower)
+        self.upper = self._entries(upper)
+
+    @staticmethod
+    def _entries(x):
+        import taichi as ti
+        if isinstance(x, ti.Matrix):
+            return list(x.entries)
+        if isinstance(x, (list, tuple)):
+            return list(x)
+        return [x]
+
+    @property
+    def shape(self):
+        return self.var.shape
+
+    def loop_range(self):
+        return self
+
+    def lower_group(self):
+        import taichi as ti
+        return make_expr_group([ti.cast(v, ti.i32) for v in self.lower])
+
+    def upper_group(self):
+        import taichi as ti
+        return make_expr_group([ti.cast(v, ti.i32) for v in self.upper])
+
+
+@taichi_scope
+def bounded(x, lower, upper):
+    """Restricts a struct-for over ``x`` to the indices ``I`` with
+    ``lower <= I < upper``, e.g. ``for i, j in ti.bounded(x, (a, b), (c, d))``.
+
+    On LLVM backends, the cells of sparse SNodes outside the box are skipped
+    when the list of elements is generated, so that the loop costs less than
+    a full one guarded by an ``if``.
+
+    Args:
+        x: the field (or SNode) to loop over.
+        lower: the inclusive lower bound of each index.
+        upper: the exclusive upper bound of each index.
+    """
+    return BoundedLoopRange(x, lower, upper)
+
+
 @taichi_scope
 def grouped(x):
     import taichi as ti
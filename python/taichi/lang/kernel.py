@@ -152,6 +152,44 @@ class Func:
 classfunc = obsolete('@ti.classfunc', '@ti.func directly')
 
 
+def materialize_kernel(kernel_fn, args=()):
+    """Materializes the instance of |kernel_fn| for |args| without launching
+    it, and returns the underlying C++ kernel.
+
+    Template arguments select the instance. Other arguments only contribute
+    their types.
+    """
+    if isinstance(kernel_fn, BoundedDifferentiableMethod):
+        kernel = kernel_fn._primal
+        args = (kernel_fn._kernel_owner, ) + tuple(args)
+    else:
+        if not getattr(kernel_fn, '_is_wrapped_kernel', False):
+            raise KernelDefError(f'{kernel_fn} is not a Taichi kernel')
+        kernel = kernel_fn._primal
+    instance_id, arg_features = kernel.mapper.lookup(args)
+    key = (kernel.func, instance_id)
+    kernel.materialize(key=key, args=args, arg_features=arg_features)
+    return kernel.compiled_functions[key].taichi_kernel
+
+
+def delete_kernel(kernel_fn, args=()):
+    """Deletes the instance of |kernel_fn| for |args|, freeing its IR and
+    compiled code. The instance is compiled again if it is launched later.
+
+    Arguments select the instance as in materialize_kernel.
+    """
+    if isinstance(kernel_fn, BoundedDifferentiableMethod):
+        kernel = kernel_fn._primal
+        args = (kernel_fn._kernel_owner, ) + tuple(args)
+    else:
+        if not getattr(kernel_fn, '_is_wrapped_kernel', False):
+            raise KernelDefError(f'{kernel_fn} is not a Taichi kernel')
+        kernel = kernel_fn._primal
+    instance_id, _ = kernel.mapper.lookup(args)
+    kernel.runtime.delete_kernel(kernel.compiled_functions,
+                                 (kernel.func, instance_id))
+
+
 class KernelTemplateMapper:
     def __init__(self, annotations, template_slot_locations):
         self.annotations = annotations
@@ -373,14 +411,45 @@ class Kernel:
         self.compiled_functions[key] = self.get_function_body(taichi_kernel)
 
     def get_function_body(self, t_kernel):
+        # Precomputed for the fast launch path
+        launch_arg_ids = [
+            i for i, needed in enumerate(self.arguments)
+            if not isinstance(needed, template)
+        ]
+        if len(launch_arg_ids) == len(self.arguments):
+            launch_arg_ids = None
+        has_ext_arr_args = any(
+            id(needed) not in real_type_ids
+            and id(needed) not in integer_type_ids
+            and not isinstance(needed, template) for needed in self.arguments)
+
         # The actual function body
         def func__(*args):
             assert len(args) == len(
                 self.arguments), '{} arguments needed but {} provided'.format(
                     len(self.arguments), len(args))
 
-            tmps = []
+            # Both the class kernels and the plain-function kernels are unified now.
+            # In both cases, |self.grad| is another Kernel instance that computes the
+            # gradient. For class kernels, args[0] is always the kernel owner.
             callbacks = []
+            if not self.is_grad and self.runtime.target_tape and not self.runtime.inside_complex_kernel:
+                tape = self.runtime.target_tape
+                call_id = tape.insert(self, args)
+                # The kernel is lowered once launched
+                callbacks.append(lambda: tape.record_written_snodes(
+                    call_id, t_kernel.written_snode_ids))
+
+            # Fast path: pack the arguments and launch in a single call
+            if launch_arg_ids is None:
+                launch_args = args
+            else:
+                launch_args = tuple(args[i] for i in launch_arg_ids)
+            if t_kernel.launch(launch_args):
+                return self.finish_launch(t_kernel, has_ext_arr_args,
+                                          callbacks)
+
+            tmps = []
             has_external_arrays = False
 
             actual_argument_slot = 0
@@ -451,35 +520,36 @@ class Kernel:
                         f'Argument type mismatch. Expecting {needed}, got {type(v)}.'
                     )
                 actual_argument_slot += 1
-            # Both the class kernels and the plain-function kernels are unified now.
-            # In both cases, |self.grad| is another Kernel instance that computes the
-            # gradient. For class kernels, args[0] is always the kernel owner.
-            if not self.is_grad and self.runtime.target_tape and not self.runtime.inside_complex_kernel:
-                self.runtime.target_tape.insert(self, args)
 
             t_kernel(launch_ctx)
 
-            ret = None
-            ret_dt = self.return_type
-            has_ret = ret_dt is not None
+            return self.finish_launch(t_kernel, has_external_arrays,
+                                      callbacks)
 
-            if has_external_arrays or has_ret:
-                import taichi as ti
-                ti.sync()
+        # Used by ti.aot.Module to export the compiled kernel
+        func__.taichi_kernel = t_kernel
+        return func__
 
-            if has_ret:
-                if id(ret_dt) in integer_type_ids:
-                    ret = t_kernel.get_ret_int(0)
-                else:
-                    ret = t_kernel.get_ret_float(0)
+    def finish_launch(self, t_kernel, has_external_arrays, callbacks):
+        ret = None
+        ret_dt = self.return_type
+        has_ret = ret_dt is not None
+
+        if has_external_arrays or has_ret:
+            import taichi as ti
+            ti.sync()
 
-            if callbacks:
-                for c in callbacks:
-                    c()
+        if has_ret:
+            if id(ret_dt) in integer_type_ids:
+                ret = t_kernel.get_ret_int(0)
+            else:
+                ret = t_kernel.get_ret_float(0)
 
-            return ret
+        if callbacks:
+            for c in callbacks:
+                c()
 
-        return func__
+        return ret
 
     def match_ext_arr(self, v, needed):
         needs_array = isinstance(
@@ -499,6 +569,8 @@ class Kernel:
         instance_id, arg_features = self.mapper.lookup(args)
         key = (self.func, instance_id)
         self.materialize(key=key, args=args, arg_features=arg_features)
+        if self.runtime.max_num_kernels:
+            self.runtime.touch_kernel(self.compiled_functions, key)
         return self.compiled_functions[key](*args)
 
 
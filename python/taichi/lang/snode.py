@@ -6,35 +6,78 @@ class SNode:
     def __init__(self, ptr):
         self.ptr = ptr
 
-    def dense(self, indices, dimensions):
+    def _check_not_materialized(self):
+        # Unlike the trees of ti.FieldsBuilder, ti.root is materialized only
+        # once
+        if self.ptr.snode_tree_id == 0:
+            impl._check_not_materialized()
+
+    def _with_list_chunk_size(self, ptr, list_chunk_size):
+        if list_chunk_size is not None:
+            ptr.set_list_chunk_size(list_chunk_size)
+        return SNode(ptr)
+
+    def dense(self, indices, dimensions, list_chunk_size=None):
+        self._check_not_materialized()
         if isinstance(dimensions, int):
             dimensions = [dimensions] * len(indices)
-        return SNode(self.ptr.dense(indices, dimensions))
+        return self._with_list_chunk_size(self.ptr.dense(indices, dimensions),
+                                          list_chunk_size)
 
-    def pointer(self, indices, dimensions):
+    def pointer(self, indices, dimensions, list_chunk_size=None):
+        self._check_not_materialized()
         if isinstance(dimensions, int):
             dimensions = [dimensions] * len(indices)
-        return SNode(self.ptr.pointer(indices, dimensions))
+        return self._with_list_chunk_size(
+            self.ptr.pointer(indices, dimensions), list_chunk_size)
 
     def hash(self, indices, dimensions):
+        self._check_not_materialized()
         if isinstance(dimensions, int):
             dimensions = [dimensions] * len(indices)
         return SNode(self.ptr.hash(indices, dimensions))
 
-    def dynamic(self, index, dimension, chunk_size=None):
+    def dynamic(self,
+                index,
+                dimension,
+                chunk_size=None,
+                chunk_directory=False,
+                list_chunk_size=None):
+        self._check_not_materialized()
         assert len(index) == 1
         if chunk_size is None:
             chunk_size = dimension
-        return SNode(self.ptr.dynamic(index[0], dimension, chunk_size))
+        return self._with_list_chunk_size(
+            self.ptr.dynamic(index[0], dimension, chunk_size, chunk_directory),
+            list_chunk_size)
 
-    def bitmasked(self, indices, dimensions):
+    def bitmasked(self, indices, dimensions, list_chunk_size=None):
+        self._check_not_materialized()
         if isinstance(dimensions, int):
             dimensions = [dimensions] * len(indices)
-        return SNode(self.ptr.bitmasked(indices, dimensions))
+        return self._with_list_chunk_size(
+            self.ptr.bitmasked(indices, dimensions), list_chunk_size)
+
+    def morton(self):
+        """Stores the elements of this dense or bitmasked node in Z-order,
+        which keeps neighbors along every axis close in memory. LLVM backends
+        only."""
+        self.ptr.morton(True)
+        return self
+
+    def tile(self, sizes):
+        """Stores the elements of this dense or bitmasked node in tiles of
+        ``sizes`` (powers of two), row-major within and across tiles. LLVM
+        backends only."""
+        if isinstance(sizes, int):
+            sizes = [sizes]
+        self.ptr.tile(sizes)
+        return self
 
     def place(self, *args, offset=None):
         from .expr import Expr
         from .util import is_taichi_class
+        self._check_not_materialized()
         if offset is None:
             offset = []
         for arg in args:
@@ -60,7 +103,8 @@ class SNode:
             n -= 1
         if p is None:
             return None
-        if p.type == impl.taichi_lang_core.SNodeType.root:
+        if p.type == impl.taichi_lang_core.SNodeType.root and \
+                p.snode_tree_id == 0:
             return impl.root
         return SNode(p)
 
@@ -118,6 +162,12 @@ class SNode:
         runtime.materialize()
         return runtime.prog.get_snode_num_dynamically_allocated(self.ptr)
 
+    @property
+    def num_bytes_released(self):
+        runtime = impl.get_runtime()
+        runtime.materialize()
+        return runtime.prog.get_snode_num_bytes_released(self.ptr)
+
     def deactivate_all(self):
         ch = self.get_children()
         for c in ch:
@@ -1,10 +1,19 @@
 class Tape:
-    def __init__(self, runtime, loss=None):
+    def __init__(self, runtime, loss=None, checkpoint_fields=None):
         self.calls = []
         self.entered = False
         self.gradient_evaluated = False
         self.runtime = runtime
         self.eval_on_exit = loss is not None
+        # Checkpointing: instead of relying on the recorded kernels to keep
+        # all intermediate states, snapshot |checkpoint_fields| every
+        # |checkpoint_interval| calls and recompute the rest during grad().
+        self.checkpoint_fields = checkpoint_fields
+        self.checkpoint_interval = 1
+        self.checkpoints = {}
+        # Call index -> ids of the SNodes written by the call, recorded when
+        # it is launched
+        self.written_snode_ids = {}
 
     def __enter__(self):
         self.runtime.target_tape = self
@@ -14,15 +23,100 @@ class Tape:
     def __exit__(self, type, value, tb):
         # print('# kernel calls', len(self.calls))
         self.runtime.target_tape = None
-        if self.eval_on_exit:
+        # Calls may be missing from the tape if a kernel raised
+        if self.eval_on_exit and type is None:
             self.grad()
 
     def insert(self, func, args):
+        if self.checkpoint_fields is not None:
+            self.insert_checkpoint()
         self.calls.append((func, args))
+        return len(self.calls) - 1
+
+    def checkpointed_snode_ids(self):
+        ids = set()
+        for f in self.checkpoint_fields:
+            for member in f.get_field_members():
+                ids.add(member.snode.ptr.id)
+        return ids
+
+    def record_written_snodes(self, call_id, snode_ids):
+        written = set(snode_ids)
+        if self.checkpoint_fields is not None:
+            checkpointed = self.checkpointed_snode_ids()
+            if written & checkpointed and written - checkpointed:
+                func, _ = self.calls[call_id]
+                raise RuntimeError(
+                    f'Kernel "{func.func.__name__}" writes both checkpoint '
+                    'fields and other fields. With checkpoint_fields, each '
+                    'kernel recorded by ti.Tape must write either only '
+                    'checkpoint fields or none of them.')
+        self.written_snode_ids[call_id] = written
+
+    def take_snapshot(self):
+        # The copy kernels must not be recorded themselves
+        target_tape = self.runtime.target_tape
+        self.runtime.target_tape = None
+        try:
+            return [f.to_numpy() for f in self.checkpoint_fields]
+        finally:
+            self.runtime.target_tape = target_tape
+
+    def restore_snapshot(self, snapshot):
+        target_tape = self.runtime.target_tape
+        self.runtime.target_tape = None
+        try:
+            for f, data in zip(self.checkpoint_fields, snapshot):
+                f.from_numpy(data)
+        finally:
+            self.runtime.target_tape = target_tape
+
+    def insert_checkpoint(self):
+        # Keep about sqrt(#calls) checkpoints: whenever there are more
+        # checkpoints than calls between two checkpoints, double the
+        # interval and drop every other checkpoint.
+        n = len(self.calls)
+        if n % self.checkpoint_interval != 0:
+            return
+        self.checkpoints[n] = self.take_snapshot()
+        if len(self.checkpoints) > self.checkpoint_interval:
+            self.checkpoint_interval *= 2
+            self.checkpoints = {
+                i: s
+                for i, s in self.checkpoints.items()
+                if i % self.checkpoint_interval == 0
+            }
 
     def grad(self):
         assert self.entered == True, "Before evaluating gradiends tape must be entered."
         assert self.gradient_evaluated == False, "Gradients of grad can be evaluated only once."
-        for func, args in reversed(self.calls):
-            func.grad(*args)
+        if self.checkpoint_fields is not None:
+            self.grad_with_checkpoints()
+        else:
+            for func, args in reversed(self.calls):
+                func.grad(*args)
         self.gradient_evaluated = True
+
+    def grad_with_checkpoints(self):
+        checkpointed = self.checkpointed_snode_ids()
+        starts = sorted(self.checkpoints.keys())
+        ends = starts[1:] + [len(self.calls)]
+        for start, end in reversed(list(zip(starts, ends))):
+            # Recompute the segment from its checkpoint. Only the calls
+            # writing checkpoint fields are re-run, and they write nothing
+            # else (see record_written_snodes), so that the other fields,
+            # e.g. a loss accumulated with +=, keep their values after the
+            # forward pass. The state before such a call is kept for its
+            # gradient; the other calls leave the checkpoint fields as is.
+            self.restore_snapshot(self.checkpoints.pop(start))
+            states = {}
+            for i in range(start, end):
+                if self.written_snode_ids[i] & checkpointed:
+                    states[i] = self.take_snapshot()
+                    func, args = self.calls[i]
+                    func(*args)
+            for i in reversed(range(start, end)):
+                if i in states:
+                    self.restore_snapshot(states.pop(i))
+                func, args = self.calls[i]
+                func.grad(*args)
@@ -239,6 +239,22 @@ def print_profile_info():
     taichi.ti_core.print_profile_info()
 
 
+def start_tracing():
+    taichi.ti_core.enable_tracer()
+
+
+def stop_tracing():
+    taichi.ti_core.disable_tracer()
+
+
+def clear_trace():
+    taichi.ti_core.clear_tracer()
+
+
+def export_trace(filename):
+    taichi.ti_core.export_chrome_trace(filename)
+
+
 @deprecated('ti.vec(x, y)', 'ti.core_vec(x, y)')
 def vec(*args, **kwargs):
     return core_vec(*args, **kwargs)
@@ -287,6 +303,10 @@ __all__ = [
     'get_traceback',
     'set_gdb_trigger',
     'print_profile_info',
+    'start_tracing',
+    'stop_tracing',
+    'clear_trace',
+    'export_trace',
     'set_logging_level',
     'info',
     'warn',
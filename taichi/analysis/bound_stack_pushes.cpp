@@ -0,0 +1,87 @@
+#include "taichi/ir/ir.h"
+#include "taichi/ir/analysis.h"
+#include "taichi/ir/statements.h"
+#include "taichi/ir/visitors.h"
+
+TLANG_NAMESPACE_BEGIN
+
+// Bound the number of pushes each adstack receives during one execution of
+// the block that allocates it, using loop trip counts known at compile time.
+class StackPushBounder : public BasicStmtVisitor {
+ public:
+  using BasicStmtVisitor::visit;
+
+  // Trip counts of the enclosing loops. -1 means unknown.
+  std::vector<int64> trip_counts;
+  // Depth in |trip_counts| where each stack is allocated
+  std::unordered_map<Stmt *, std::size_t> alloca_depth;
+  // -1 means unknown
+  std::unordered_map<Stmt *, int64> bounds;
+
+  static constexpr int64 max_bound = 1LL << 31;
+
+  StackPushBounder() {
+    allow_undefined_visitor = true;
+  }
+
+  void visit(StackAllocaStmt *stmt) override {
+    alloca_depth[stmt] = trip_counts.size();
+    bounds[stmt] = 0;
+  }
+
+  void visit(StackPushStmt *stmt) override {
+    auto stack = stmt->stack;
+    if (alloca_depth.find(stack) == alloca_depth.end() || bounds[stack] == -1)
+      return;
+    int64 num_pushes = 1;
+    for (auto i = alloca_depth[stack]; i < trip_counts.size(); i++) {
+      if (trip_counts[i] == -1) {
+        bounds[stack] = -1;
+        return;
+      }
+      num_pushes = std::min(num_pushes * trip_counts[i], max_bound);
+    }
+    bounds[stack] = std::min(bounds[stack] + num_pushes, max_bound);
+  }
+
+  void visit(RangeForStmt *stmt) override {
+    int64 trip_count = -1;
+    auto begin = stmt->begin->cast<ConstStmt>();
+    auto end = stmt->end->cast<ConstStmt>();
+    if (begin && end) {
+      trip_count = std::max(
+          (int64)0, (int64)end->val[0].val_int() - begin->val[0].val_int());
+    }
+    trip_counts.push_back(trip_count);
+    stmt->body->accept(this);
+    trip_counts.pop_back();
+  }
+
+  void visit(StructForStmt *stmt) override {
+    trip_counts.push_back(-1);
+    stmt->body->accept(this);
+    trip_counts.pop_back();
+  }
+
+  void visit(WhileStmt *stmt) override {
+    trip_counts.push_back(-1);
+    stmt->body->accept(this);
+    trip_counts.pop_back();
+  }
+};
+
+namespace irpass::analysis {
+std::unordered_map<Stmt *, std::size_t> bound_stack_pushes(IRNode *root) {
+  StackPushBounder bounder;
+  root->accept(&bounder);
+  std::unordered_map<Stmt *, std::size_t> result;
+  for (auto &it : bounder.bounds) {
+    if (it.second != -1 && it.second < StackPushBounder::max_bound) {
+      result[it.first] = (std::size_t)it.second;
+    }
+  }
+  return result;
+}
+}  // namespace irpass::analysis
+
+TLANG_NAMESPACE_END
@@ -0,0 +1,32 @@
+#include "taichi/ir/ir.h"
+#include "taichi/ir/analysis.h"
+#include "taichi/ir/statements.h"
+
+TLANG_NAMESPACE_BEGIN
+
+namespace irpass::analysis {
+std::unordered_set<SNode *> gather_written_snodes(IRNode *root) {
+  std::unordered_set<SNode *> snodes;
+  auto record = [&](Stmt *ptr) {
+    // Global accesses may or may not have been lowered yet
+    if (auto global_ptr = ptr->cast<GlobalPtrStmt>()) {
+      for (auto snode : global_ptr->snodes.data)
+        snodes.insert(snode);
+    } else if (auto get_ch = ptr->cast<GetChStmt>()) {
+      if (get_ch->output_snode->is_place())
+        snodes.insert(get_ch->output_snode);
+    }
+  };
+  gather_statements(root, [&](Stmt *stmt) {
+    if (auto store = stmt->cast<GlobalStoreStmt>()) {
+      record(store->ptr);
+    } else if (auto atomic = stmt->cast<AtomicOpStmt>()) {
+      record(atomic->dest);
+    }
+    return false;
+  });
+  return snodes;
+}
+}  // namespace irpass::analysis
+
+TLANG_NAMESPACE_END
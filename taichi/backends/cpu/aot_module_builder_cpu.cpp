@@ -0,0 +1,375 @@
+#include "taichi/backends/cpu/aot_module_builder_cpu.h"
+
+#include <cctype>
+#include <fstream>
+
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include "taichi/backends/cpu/codegen_cpu.h"
+#include "taichi/ir/analysis.h"
+#include "taichi/ir/statements.h"
+#include "taichi/program/program.h"
+#include "taichi/util/io.h"
+#include "taichi/util/line_appender.h"
+
+TLANG_NAMESPACE_BEGIN
+
+// Defined in jit_cpu.cpp
+void emit_object_file_cpu(std::unique_ptr<llvm::Module> &module,
+                          const std::string &filename);
+
+namespace {
+
+bool is_c_identifier(const std::string &s) {
+  if (s.empty() || std::isdigit((unsigned char)s[0]))
+    return false;
+  for (char c : s) {
+    if (!std::isalnum((unsigned char)c) && c != '_')
+      return false;
+  }
+  return true;
+}
+
+bool is_runtime_entry(const std::string &func_name) {
+  return starts_with(func_name, "runtime_") ||
+         starts_with(func_name, "LLVMRuntime_");
+}
+
+}  // namespace
+
+AotModuleBuilderCPU::AotModuleBuilderCPU(Program *prog) : prog_(prog) {
+  TI_ERROR_UNLESS(arch_is_cpu(prog->config.arch),
+                  "AOT export is only supported on CPU backends");
+  TI_ERROR_IF(prog->config.kernel_profiler,
+              "AOT export does not support the kernel profiler");
+  TI_ASSERT(prog->llvm_runtime != nullptr);
+  auto tlctx = prog->get_llvm_context(prog->config.arch);
+  // The runtime functions the C API calls. Kernels carry internal copies of
+  // the runtime functions they use.
+  module_ = tlctx->clone_struct_module();
+  TaichiLLVMContext::eliminate_unused_functions(module_.get(),
+                                                is_runtime_entry);
+}
+
+AotModuleBuilderCPU::~AotModuleBuilderCPU() = default;
+
+void AotModuleBuilderCPU::add(const std::string &identifier, Kernel *kernel) {
+  TI_ERROR_UNLESS(is_c_identifier(identifier),
+                  "\"{}\" is not a valid C identifier", identifier);
+  for (auto &k : kernels_) {
+    TI_ERROR_IF(k.identifier == identifier,
+                "Kernel \"{}\" has already been added", identifier);
+  }
+  TI_ASSERT(arch_is_cpu(kernel->arch));
+  if (!kernel->lowered)
+    kernel->lower();
+  // The C API only materializes the tree of ti.root
+  TI_ERROR_IF(!kernel->snode_tree_roots.empty(),
+              "Kernel \"{}\" accesses fields outside of ti.root (SNode tree "
+              "{}) and cannot be exported",
+              kernel->name, kernel->snode_tree_roots[0]->snode_tree_id);
+  auto external_calls =
+      irpass::analysis::gather_statements(kernel->ir.get(), [](Stmt *s) {
+        return s->is<ExternalFuncCallStmt>();
+      });
+  TI_ERROR_IF(!external_calls.empty(),
+              "Kernel \"{}\" calls host functions and cannot be exported",
+              kernel->name);
+
+  auto compiled = CodeGenCPU(kernel).codegen_module();
+  TI_ERROR_IF(llvm::Linker::linkModules(*module_, std::move(compiled.module)),
+              "Failed to link kernel \"{}\"", kernel->name);
+  kernels_.push_back(
+      {identifier, compiled.task_names, kernel->args, kernel->rets});
+}
+
+void AotModuleBuilderCPU::dump(const std::string &output_dir,
+                               const std::string &name,
+                               bool shared) const {
+  TI_ERROR_UNLESS(is_c_identifier(name), "\"{}\" is not a valid C identifier",
+                  name);
+  create_directories(output_dir);
+  auto prefix = fmt::format("{}/{}", output_dir, name);
+
+  auto module = llvm::CloneModule(*module_);
+  emit_object_file_cpu(module, prefix + ".o");
+  std::ofstream(prefix + ".h") << generate_header(name);
+  std::ofstream(prefix + ".c") << generate_source(name);
+
+  if (shared) {
+    TI_ERROR_UNLESS(command_exist("cc"),
+                    "A C compiler (cc) is needed to link {}.so", name);
+    auto cmd = fmt::format("cc -shared -fPIC -O2 -o {0}.so {0}.o {0}.c -lm",
+                           prefix);
+    TI_TRACE("Executing command: {}", cmd);
+    TI_ERROR_IF(std::system(cmd.c_str()) != 0, "Failed to link {}.so", name);
+  }
+  TI_INFO("AOT module \"{}\" with {} kernel(s) written to {}", name,
+          kernels_.size(), output_dir);
+}
+
+std::string AotModuleBuilderCPU::generate_header(
+    const std::string &name) const {
+  LineAppender h;
+  h.append("// Generated by Taichi. Do not edit.");
+  h.append("#pragma once");
+  h.append("");
+  h.append("#include <stddef.h>");
+  h.append("#include <stdint.h>");
+  h.append("#include <string.h>");
+  h.append("");
+  h.append("#ifdef __cplusplus");
+  h.append("extern \"C\" {{");
+  h.append("#endif");
+  h.append("");
+  h.append("// Same layout as taichi::lang::Context");
+  h.append("typedef struct {}_context {{", name);
+  {
+    ScopedIndent _(h);
+    h.append("void *runtime;");
+    h.append("uint64_t args[{}];", taichi_max_num_args);
+    // Shapes of external array arguments
+    h.append("int32_t extra_args[{}][{}];", taichi_max_num_args,
+             taichi_max_num_indices);
+  }
+  h.append("}} {}_context;", name);
+  h.append("");
+  h.append("typedef struct {0}_runtime {0}_runtime;", name);
+  h.append("");
+  h.append("typedef void (*{}_task_fn)(void *context, int task_id);", name);
+  h.append(
+      "typedef void (*{0}_parallel_for_fn)(void *thread_pool, int splits, "
+      "int num_threads, void *context, {0}_task_fn task);",
+      name);
+  h.append("typedef int32_t (*{}_thread_id_fn)(void);", name);
+  h.append("");
+  h.append(
+      "// Allocates |memory_bytes| bytes of zero-filled memory for fields, "
+      "sparse");
+  h.append("// nodes and runtime bookkeeping. Returns NULL on failure.");
+  h.append("{0}_runtime *{0}_initialize(size_t memory_bytes);", name);
+  h.append("");
+  h.append(
+      "// Kernels run serially unless a thread pool is set. |thread_id| must "
+      "return");
+  h.append("// a stable id in [0, {}) for each worker of |thread_pool|.",
+           prog_->config.cpu_max_num_threads);
+  h.append(
+      "void {0}_set_thread_pool({0}_runtime *rt, void *thread_pool, "
+      "{0}_parallel_for_fn parallel_for, {0}_thread_id_fn thread_id);",
+      name);
+  h.append("");
+  h.append("void {0}_finalize({0}_runtime *rt);", name);
+  h.append("");
+  h.append("void {0}_context_init({0}_runtime *rt, {0}_context *ctx);", name);
+  h.append("");
+  h.append("uint64_t {0}_get_ret_raw({0}_runtime *rt, int i);", name);
+  h.append("");
+
+  auto setter = [&](const std::string &suffix, const std::string &c_type) {
+    h.append(
+        "static inline void {0}_set_arg_{1}({0}_context *ctx, int i, {2} v) "
+        "{{",
+        name, suffix, c_type);
+    h.append("  ctx->args[i] = 0;");
+    h.append("  memcpy(&ctx->args[i], &v, sizeof(v));");
+    h.append("}}");
+    h.append("");
+  };
+  setter("i32", "int32_t");
+  setter("i64", "int64_t");
+  setter("f32", "float");
+  setter("f64", "double");
+  setter("ptr", "void *");
+  h.append(
+      "static inline void {0}_set_extra_arg({0}_context *ctx, int i, int j, "
+      "int32_t v) {{",
+      name);
+  h.append("  ctx->extra_args[i][j] = v;");
+  h.append("}}");
+  h.append("");
+
+  for (auto &k : kernels_) {
+    std::string args;
+    for (int i = 0; i < (int)k.args.size(); i++) {
+      auto dt = data_type_name(k.args[i].dt);
+      if (k.args[i].is_nparray)
+        dt += " array";
+      args += fmt::format("{}{}: {}", i ? ", " : "", i, dt);
+    }
+    h.append("// Arguments: {}", args.empty() ? "none" : args);
+    if (!k.rets.empty()) {
+      h.append("// Returns {} via {}_get_ret_raw(rt, 0)",
+               data_type_name(k.rets[0].dt), name);
+    }
+    h.append("void {0}_{1}({0}_context *ctx);", name, k.identifier);
+    h.append("");
+  }
+
+  h.append("#ifdef __cplusplus");
+  h.append("}}");
+  h.append("#endif");
+  return h.lines();
+}
+
+std::string AotModuleBuilderCPU::generate_source(
+    const std::string &name) const {
+  auto &layout = prog_->llvm_runtime_layout;
+  LineAppender s;
+  s.append("// Generated by Taichi. Do not edit.");
+  // For posix_memalign
+  s.append("#define _POSIX_C_SOURCE 200112L");
+  s.append("");
+  s.append("#include \"{}.h\"", name);
+  s.append("");
+  s.append("#include <stdio.h>");
+  s.append("#include <stdlib.h>");
+  s.append("");
+  s.append("// LLVM runtime entries in {}.o", name);
+  s.append(
+      "void runtime_initialize(void *result_buffer, void *prog, size_t "
+      "preallocated_size, void *preallocated_buffer, int32_t "
+      "num_rand_states, void *vm_allocator, void *host_printf, void "
+      "*host_vsnprintf);");
+  s.append(
+      "void runtime_initialize_element_list(void *runtime, int32_t snode_id, "
+      "int32_t num_elements_per_chunk);");
+  s.append(
+      "void runtime_initialize_snode_tree(void *runtime, size_t root_size, "
+      "int32_t root_id, int32_t snode_tree_id);");
+  s.append(
+      "void runtime_NodeAllocator_initialize(void *runtime, int32_t snode_id, "
+      "size_t node_size, int32_t chunk_num_elements, int32_t "
+      "lazy_zero_fill);");
+  s.append(
+      "void runtime_allocate_ambient(void *runtime, int32_t snode_id, size_t "
+      "size);");
+  s.append(
+      "void LLVMRuntime_initialize_thread_pool(void *runtime, void "
+      "*thread_pool, void *parallel_for);");
+  s.append("void LLVMRuntime_set_assert_failed(void *runtime, void *func);");
+  s.append("void LLVMRuntime_set_cpu_thread_id(void *runtime, void *func);");
+  s.append("");
+  s.append("// Offloaded tasks");
+  for (auto &k : kernels_) {
+    for (auto &task : k.task_names) {
+      s.append("void {}(void *context);", task);
+    }
+  }
+  s.append("");
+  s.append("struct {}_runtime {{", name);
+  {
+    ScopedIndent _(s);
+    s.append("uint64_t result_buffer[{}];", taichi_result_buffer_entries);
+    s.append("void *memory;");
+    s.append("void *llvm_runtime;");
+  }
+  s.append("}};");
+  s.append("");
+  s.append(
+      "static void serial_parallel_for(void *thread_pool, int splits, int "
+      "num_threads, void *context, {}_task_fn task) {{",
+      name);
+  s.append("  for (int i = 0; i < splits; i++)");
+  s.append("    task(context, i);");
+  s.append("}}");
+  s.append("");
+  s.append("static int32_t serial_thread_id(void) {{");
+  s.append("  return 0;");
+  s.append("}}");
+  s.append("");
+  s.append("static void assert_failed(const char *message) {{");
+  s.append("  fprintf(stderr, \"[{}] %s\\n\", message);", name);
+  s.append("  abort();");
+  s.append("}}");
+  s.append("");
+  s.append("{0}_runtime *{0}_initialize(size_t memory_bytes) {{", name);
+  {
+    ScopedIndent _(s);
+    s.append("{0}_runtime *rt = ({0}_runtime *)calloc(1, sizeof({0}_runtime));",
+             name);
+    s.append("if (!rt)");
+    s.append("  return NULL;");
+    s.append("if (posix_memalign(&rt->memory, {}, memory_bytes) != 0) {{",
+             taichi_page_size);
+    s.append("  free(rt);");
+    s.append("  return NULL;");
+    s.append("}}");
+    s.append("memset(rt->memory, 0, memory_bytes);");
+    // The runtime allocates everything from the preallocated buffer, so no
+    // host allocator is needed.
+    s.append(
+        "runtime_initialize(rt->result_buffer, NULL, memory_bytes, rt->memory, "
+        "0, NULL, (void *)printf, (void *)vsnprintf);");
+    s.append("rt->llvm_runtime = (void *)rt->result_buffer[{}];",
+             taichi_result_buffer_ret_value_id);
+    for (auto &list : layout.element_lists) {
+      s.append("runtime_initialize_element_list(rt->llvm_runtime, {}, {});",
+               list.snode_id, list.chunk_size);
+    }
+    s.append("runtime_initialize_snode_tree(rt->llvm_runtime, {}, {}, 0);",
+             layout.root_size, layout.root_id);
+    for (auto &allocator : layout.node_allocators) {
+      s.append(
+          "runtime_NodeAllocator_initialize(rt->llvm_runtime, {}, {}, {}, {});",
+          allocator.snode_id, allocator.node_size, allocator.chunk_num_elements,
+          (int)prog_->config.gc_lazy_zero_fill);
+      s.append("runtime_allocate_ambient(rt->llvm_runtime, {}, {});",
+               allocator.snode_id, allocator.node_size);
+    }
+    s.append(
+        "LLVMRuntime_set_assert_failed(rt->llvm_runtime, (void "
+        "*)assert_failed);");
+    s.append("{}_set_thread_pool(rt, NULL, NULL, NULL);", name);
+    s.append("return rt;");
+  }
+  s.append("}}");
+  s.append("");
+  s.append(
+      "void {0}_set_thread_pool({0}_runtime *rt, void *thread_pool, "
+      "{0}_parallel_for_fn parallel_for, {0}_thread_id_fn thread_id) {{",
+      name);
+  {
+    ScopedIndent _(s);
+    s.append("if (!parallel_for || !thread_id) {{");
+    s.append("  thread_pool = NULL;");
+    s.append("  parallel_for = serial_parallel_for;");
+    s.append("  thread_id = serial_thread_id;");
+    s.append("}}");
+    s.append(
+        "LLVMRuntime_initialize_thread_pool(rt->llvm_runtime, thread_pool, "
+        "(void *)parallel_for);");
+    s.append(
+        "LLVMRuntime_set_cpu_thread_id(rt->llvm_runtime, (void "
+        "*)thread_id);");
+  }
+  s.append("}}");
+  s.append("");
+  s.append("void {0}_finalize({0}_runtime *rt) {{", name);
+  s.append("  free(rt->memory);");
+  s.append("  free(rt);");
+  s.append("}}");
+  s.append("");
+  s.append("void {0}_context_init({0}_runtime *rt, {0}_context *ctx) {{",
+           name);
+  s.append("  memset(ctx, 0, sizeof({}_context));", name);
+  s.append("  ctx->runtime = rt->llvm_runtime;");
+  s.append("}}");
+  s.append("");
+  s.append("uint64_t {0}_get_ret_raw({0}_runtime *rt, int i) {{", name);
+  s.append("  return rt->result_buffer[i];");
+  s.append("}}");
+  for (auto &k : kernels_) {
+    s.append("");
+    s.append("void {0}_{1}({0}_context *ctx) {{", name, k.identifier);
+    for (auto &task : k.task_names) {
+      s.append("  {}(ctx);", task);
+    }
+    s.append("}}");
+  }
+  return s.lines();
+}
+
+TLANG_NAMESPACE_END
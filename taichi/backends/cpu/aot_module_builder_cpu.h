@@ -0,0 +1,56 @@
+// Ahead-of-time export of CPU kernels to a standalone object file
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "taichi/lang_util.h"
+#include "taichi/llvm/llvm_fwd.h"
+#include "taichi/program/kernel.h"
+
+TLANG_NAMESPACE_BEGIN
+
+class Program;
+
+// Collects CPU kernels of the current program, and writes them out together
+// with the LLVM runtime as
+//  - <name>.o: the optimized kernels and the runtime functions they use;
+//  - <name>.h: a C header declaring the Context layout and the C API;
+//  - <name>.c: the C API implementation, which replays the runtime
+//    initialization of the materialized SNode tree.
+// With |shared| the three are linked into <name>.so by the system compiler,
+// so that the host application only needs to dlopen it.
+class AotModuleBuilderCPU {
+ public:
+  explicit AotModuleBuilderCPU(Program *prog);
+
+  ~AotModuleBuilderCPU();
+
+  // |identifier| names the launch function in the C API, i.e.
+  // <name>_<identifier>.
+  void add(const std::string &identifier, Kernel *kernel);
+
+  void dump(const std::string &output_dir,
+            const std::string &name,
+            bool shared) const;
+
+ private:
+  struct CompiledKernel {
+    std::string identifier;
+    std::vector<std::string> task_names;
+    std::vector<Kernel::Arg> args;
+    std::vector<Kernel::Ret> rets;
+  };
+
+  std::string generate_header(const std::string &name) const;
+
+  std::string generate_source(const std::string &name) const;
+
+  Program *prog_;
+  std::unique_ptr<llvm::Module> module_;
+  std::vector<CompiledKernel> kernels_;
+};
+
+TLANG_NAMESPACE_END
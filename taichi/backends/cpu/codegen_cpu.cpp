@@ -31,19 +31,59 @@ class CodeGenLLVMCPU : public CodeGenLLVM {
 
     auto *tls_prologue = create_xlogue(stmt->tls_prologue);
 
-    // The loop body
+    // The loop body, which runs the iterations in [begin, end) of a block.
+    // Looping inside the function (rather than calling it per iteration from
+    // the runtime) lets LLVM strength-reduce the address computations from
+    // the loop index.
     llvm::Function *body;
     {
       auto guard = get_function_creation_guard(
           {llvm::PointerType::get(get_runtime_type("Context"), 0),
            llvm::Type::getInt8PtrTy(*llvm_context),
-           tlctx->get_data_type<int>()});
+           tlctx->get_data_type<int>(), tlctx->get_data_type<int>()});
+
+      auto loop_test =
+          llvm::BasicBlock::Create(*llvm_context, "block_loop_test", func);
+      auto loop_body =
+          llvm::BasicBlock::Create(*llvm_context, "block_loop_body", func);
+      auto loop_inc =
+          llvm::BasicBlock::Create(*llvm_context, "block_loop_inc", func);
+      auto after_loop =
+          llvm::BasicBlock::Create(*llvm_context, "block_after_loop", func);
 
       auto loop_var = create_entry_block_alloca(PrimitiveType::i32);
       loop_vars_llvm[stmt].push_back(loop_var);
-      builder->CreateStore(get_arg(2), loop_var);
+      if (!stmt->reversed) {
+        builder->CreateStore(get_arg(2), loop_var);
+      } else {
+        builder->CreateStore(
+            builder->CreateSub(get_arg(3), tlctx->get_constant(1)), loop_var);
+      }
+      builder->CreateBr(loop_test);
+
+      builder->SetInsertPoint(loop_test);
+      llvm::Value *cond;
+      if (!stmt->reversed) {
+        cond = builder->CreateICmp(llvm::CmpInst::Predicate::ICMP_SLT,
+                                   builder->CreateLoad(loop_var), get_arg(3));
+      } else {
+        cond = builder->CreateICmp(llvm::CmpInst::Predicate::ICMP_SGE,
+                                   builder->CreateLoad(loop_var), get_arg(2));
+      }
+      builder->CreateCondBr(cond, loop_body, after_loop);
+
+      builder->SetInsertPoint(loop_body);
+      // Continue stmts in the body go to the next iteration of the block
+      current_offload_reentry = loop_inc;
       stmt->body->accept(this);
+      current_offload_reentry = nullptr;
+      builder->CreateBr(loop_inc);
+
+      builder->SetInsertPoint(loop_inc);
+      create_increment(loop_var, tlctx->get_constant(step));
+      builder->CreateBr(loop_test);
 
+      builder->SetInsertPoint(after_loop);
       body = guard.body;
     }
 
@@ -122,7 +162,14 @@ class CodeGenLLVMCPU : public CodeGenLLVM {
 
 FunctionType CodeGenCPU::codegen() {
   TI_AUTO_PROF
-  return CodeGenLLVMCPU(kernel, ir).gen();
+  CodeGenLLVMCPU llvm_codegen(kernel, ir);
+  llvm_codegen.fast_compile = fast_compile;
+  return llvm_codegen.gen();
+}
+
+LLVMCompiledKernel CodeGenCPU::codegen_module() {
+  TI_AUTO_PROF
+  return CodeGenLLVMCPU(kernel, ir).gen_module();
 }
 
 TLANG_NAMESPACE_END
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "taichi/codegen/codegen.h"
+#include "taichi/codegen/codegen_llvm.h"
 
 TLANG_NAMESPACE_BEGIN
 
@@ -12,6 +13,8 @@ class CodeGenCPU : public KernelCodeGen {
   }
 
   virtual FunctionType codegen() override;
+
+  LLVMCompiledKernel codegen_module();
 };
 
 TLANG_NAMESPACE_END
@@ -1,6 +1,8 @@
 // A LLVM JIT compiler for CPU archs wrapper
 
+#include <algorithm>
 #include <memory>
+#include <unordered_map>
 
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/ADT/StringRef.h"
@@ -25,6 +27,7 @@
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
@@ -32,6 +35,7 @@
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/GVN.h"
 #include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/AlwaysInliner.h"
 
 #include "taichi/lang_util.h"
 #include "taichi/program/program.h"
@@ -45,18 +49,88 @@ using namespace llvm::orc;
 
 class JITSessionCPU;
 
+void global_optimize_module_cpu(std::unique_ptr<llvm::Module> &module,
+                                bool fast_compile = false);
+
+// RTDyldObjectLinkingLayer keeps the memory manager of every object until it
+// is destroyed. This forwards to a SectionMemoryManager that can be released
+// earlier, when the module of the object is removed.
+class ModuleMemoryManager : public RuntimeDyld::MemoryManager {
+ private:
+  std::unique_ptr<SectionMemoryManager> impl;
+  std::size_t allocated_bytes;
+
+ public:
+  ModuleMemoryManager()
+      : impl(std::make_unique<SectionMemoryManager>()), allocated_bytes(0) {
+  }
+
+  uint8_t *allocateCodeSection(uintptr_t size,
+                               unsigned alignment,
+                               unsigned section_id,
+                               StringRef section_name) override {
+    allocated_bytes += size;
+    return impl->allocateCodeSection(size, alignment, section_id,
+                                     section_name);
+  }
+
+  uint8_t *allocateDataSection(uintptr_t size,
+                               unsigned alignment,
+                               unsigned section_id,
+                               StringRef section_name,
+                               bool is_read_only) override {
+    allocated_bytes += size;
+    return impl->allocateDataSection(size, alignment, section_id,
+                                     section_name, is_read_only);
+  }
+
+  void registerEHFrames(uint8_t *addr,
+                        uint64_t load_addr,
+                        size_t size) override {
+    impl->registerEHFrames(addr, load_addr, size);
+  }
+
+  void deregisterEHFrames() override {
+    if (impl)
+      impl->deregisterEHFrames();
+  }
+
+  bool finalizeMemory(std::string *err_msg) override {
+    return impl->finalizeMemory(err_msg);
+  }
+
+  std::size_t get_allocated_bytes() const {
+    return impl ? allocated_bytes : 0;
+  }
+
+  // Frees the code and data of the object
+  void release() {
+    deregisterEHFrames();
+    impl = nullptr;
+  }
+};
+
 class JITModuleCPU : public JITModule {
  private:
   JITSessionCPU *session;
   JITDylib *dylib;
+  VModuleKey key;
 
  public:
-  JITModuleCPU(JITSessionCPU *session, JITDylib *dylib)
-      : session(session), dylib(dylib) {
+  JITModuleCPU(JITSessionCPU *session, JITDylib *dylib, VModuleKey key)
+      : session(session), dylib(dylib), key(key) {
   }
 
   void *lookup_function(const std::string &name) override;
 
+  JITDylib *get_dylib() const {
+    return dylib;
+  }
+
+  VModuleKey get_key() const {
+    return key;
+  }
+
   bool direct_dispatch() const override {
     return true;
   }
@@ -71,61 +145,117 @@ class JITSessionCPU : public JITSession {
   MangleAndInterner Mangle;
   std::mutex mut;
   std::vector<llvm::orc::JITDylib *> all_libs;
+  llvm::orc::JITDylib *shared_lib{nullptr};
   int module_counter;
-  SectionMemoryManager *memory_manager;
+  // Objects are loaded on the thread that looks up their symbols, right after
+  // their memory manager is created
+  static thread_local ModuleMemoryManager *last_memory_manager;
+  // Guards |memory_managers|. Acquired after |mut|.
+  std::mutex memory_mut;
+  std::unordered_map<VModuleKey, ModuleMemoryManager *> memory_managers;
 
  public:
   JITSessionCPU(JITTargetMachineBuilder JTMB, DataLayout DL)
       : object_layer(ES,
-                     [&]() {
-                       auto smgr = std::make_unique<SectionMemoryManager>();
-                       memory_manager = smgr.get();
-                       return smgr;
+                     []() {
+                       auto mgr = std::make_unique<ModuleMemoryManager>();
+                       last_memory_manager = mgr.get();
+                       return mgr;
                      }),
         compile_layer(ES,
                       object_layer,
                       std::make_unique<ConcurrentIRCompiler>(std::move(JTMB))),
         DL(DL),
         Mangle(ES, this->DL),
-        module_counter(0),
-        memory_manager(nullptr) {
+        module_counter(0) {
     if (JTMB.getTargetTriple().isOSBinFormatCOFF()) {
       object_layer.setOverrideObjectFlagsWithResponsibilityFlags(true);
       object_layer.setAutoClaimResponsibilityForObjectSymbols(true);
     }
+    object_layer.setNotifyLoaded(
+        [this](VModuleKey key, const object::ObjectFile &,
+               const RuntimeDyld::LoadedObjectInfo &) {
+          std::lock_guard<std::mutex> _(memory_mut);
+          memory_managers[key] = last_memory_manager;
+        });
   }
 
   ~JITSessionCPU() {
     std::lock_guard<std::mutex> _(mut);
-    if (memory_manager)
-      memory_manager->deregisterEHFrames();
+    std::lock_guard<std::mutex> __(memory_mut);
+    for (auto &it : memory_managers)
+      it.second->deregisterEHFrames();
   }
 
   DataLayout get_data_layout() override {
     return DL;
   }
 
-  JITModule *add_module(std::unique_ptr<llvm::Module> M) override {
+  JITModule *add_module(std::unique_ptr<llvm::Module> M,
+                        bool fast_compile) override {
     TI_ASSERT(M);
-    global_optimize_module_cpu(M);
+    global_optimize_module_cpu(M, fast_compile);
     std::lock_guard<std::mutex> _(mut);
     auto &dylib = ES.createJITDylib(fmt::format("{}", module_counter));
     dylib.addGenerator(
         cantFail(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
             DL.getGlobalPrefix())));
+    if (shared_lib)
+      dylib.addToSearchOrder(*shared_lib);
     auto *thread_safe_context = get_current_program()
                                     .get_llvm_context(host_arch())
                                     ->get_this_thread_thread_safe_context();
-    cantFail(compile_layer.add(dylib, llvm::orc::ThreadSafeModule(
-                                          std::move(M), *thread_safe_context)));
+    auto key = ES.allocateVModule();
+    cantFail(compile_layer.add(
+        dylib,
+        llvm::orc::ThreadSafeModule(std::move(M), *thread_safe_context), key));
     all_libs.push_back(&dylib);
-    auto new_module = std::make_unique<JITModuleCPU>(this, &dylib);
+    auto new_module = std::make_unique<JITModuleCPU>(this, &dylib, key);
     auto new_module_raw_ptr = new_module.get();
     modules.push_back(std::move(new_module));
     module_counter++;
     return new_module_raw_ptr;
   }
 
+  void remove_module(JITModule *module) override {
+    std::lock_guard<std::mutex> _(mut);
+    auto cpu_module = static_cast<JITModuleCPU *>(module);
+    // The symbols stay in the dylib, but it is no longer searched
+    auto lib = std::find(all_libs.begin(), all_libs.end(),
+                         cpu_module->get_dylib());
+    TI_ASSERT(lib != all_libs.end());
+    all_libs.erase(lib);
+    {
+      std::lock_guard<std::mutex> __(memory_mut);
+      auto it = memory_managers.find(cpu_module->get_key());
+      if (it != memory_managers.end()) {
+        it->second->release();
+        memory_managers.erase(it);
+      }
+    }
+    modules.erase(std::find_if(
+        modules.begin(), modules.end(),
+        [&](const std::unique_ptr<JITModule> &m) { return m.get() == module; }));
+  }
+
+  std::size_t get_num_modules() override {
+    std::lock_guard<std::mutex> _(mut);
+    return modules.size();
+  }
+
+  std::size_t get_memory_usage() override {
+    std::lock_guard<std::mutex> _(memory_mut);
+    std::size_t total = 0;
+    for (auto &it : memory_managers)
+      total += it.second->get_allocated_bytes();
+    return total;
+  }
+
+  void set_shared_module(JITModule *module) override {
+    std::lock_guard<std::mutex> _(mut);
+    shared_lib = static_cast<JITModuleCPU *>(module)->get_dylib();
+  }
+
   void *lookup(const std::string Name) override {
     std::lock_guard<std::mutex> _(mut);
 #ifdef __APPLE__
@@ -149,22 +279,17 @@ class JITSessionCPU : public JITSession {
       TI_ERROR("Function \"{}\" not found", Name);
     return (void *)(symbol->getAddress());
   }
-
- private:
-  static void global_optimize_module_cpu(std::unique_ptr<llvm::Module> &module);
 };
 
+thread_local ModuleMemoryManager *JITSessionCPU::last_memory_manager = nullptr;
+
 void *JITModuleCPU::lookup_function(const std::string &name) {
   return session->lookup_in_module(dylib, name);
 }
 
-void JITSessionCPU::global_optimize_module_cpu(
-    std::unique_ptr<llvm::Module> &module) {
-  TI_AUTO_PROF
-  if (llvm::verifyModule(*module, &llvm::errs())) {
-    module->print(llvm::errs(), nullptr);
-    TI_ERROR("Module broken");
-  }
+namespace {
+
+std::unique_ptr<TargetMachine> create_target_machine_cpu(llvm::Module *module) {
   auto JTMB = JITTargetMachineBuilder::detectHost();
   if (!JTMB) {
     TI_ERROR("Target machine creation failed.");
@@ -196,9 +321,6 @@ void JITSessionCPU::global_optimize_module_cpu(
   options.GuaranteedTailCallOpt = false;
   options.StackAlignmentOverride = 0;
 
-  legacy::FunctionPassManager function_pass_manager(module.get());
-  legacy::PassManager module_pass_manager;
-
   llvm::StringRef mcpu = llvm::sys::getHostCPUName();
   std::unique_ptr<TargetMachine> target_machine(target->createTargetMachine(
       triple.str(), mcpu.str(), "", options, llvm::Reloc::PIC_,
@@ -207,6 +329,22 @@ void JITSessionCPU::global_optimize_module_cpu(
   TI_ERROR_UNLESS(target_machine.get(), "Could not allocate target machine!");
 
   module->setDataLayout(target_machine->createDataLayout());
+  return target_machine;
+}
+
+}  // namespace
+
+void global_optimize_module_cpu(std::unique_ptr<llvm::Module> &module,
+                                bool fast_compile) {
+  TI_AUTO_PROF
+  if (llvm::verifyModule(*module, &llvm::errs())) {
+    module->print(llvm::errs(), nullptr);
+    TI_ERROR("Module broken");
+  }
+  auto target_machine = create_target_machine_cpu(module.get());
+
+  legacy::FunctionPassManager function_pass_manager(module.get());
+  legacy::PassManager module_pass_manager;
 
   module_pass_manager.add(createTargetTransformInfoWrapperPass(
       target_machine->getTargetIRAnalysis()));
@@ -214,10 +352,17 @@ void JITSessionCPU::global_optimize_module_cpu(
       target_machine->getTargetIRAnalysis()));
 
   PassManagerBuilder b;
-  b.OptLevel = 3;
-  b.Inliner = createFunctionInliningPass(b.OptLevel, 0, false);
-  b.LoopVectorize = true;
-  b.SLPVectorize = true;
+  if (fast_compile) {
+    // Only inline the functions marked always-inline, and run the cheap
+    // simplification passes
+    b.OptLevel = 1;
+    b.Inliner = createAlwaysInlinerLegacyPass();
+  } else {
+    b.OptLevel = 3;
+    b.Inliner = createFunctionInliningPass(b.OptLevel, 0, false);
+    b.LoopVectorize = true;
+    b.SLPVectorize = true;
+  }
 
   target_machine->adjustPassManager(b);
 
@@ -250,6 +395,26 @@ void JITSessionCPU::global_optimize_module_cpu(
   }
 }
 
+// Optimizes |module| like a JIT module, and writes it to a relocatable object
+// file for the host CPU.
+void emit_object_file_cpu(std::unique_ptr<llvm::Module> &module,
+                          const std::string &filename) {
+  TI_AUTO_PROF
+  global_optimize_module_cpu(module);
+  auto target_machine = create_target_machine_cpu(module.get());
+
+  std::error_code err;
+  llvm::raw_fd_ostream dest(filename, err, llvm::sys::fs::OF_None);
+  TI_ERROR_IF(err, "Could not open file {}: {}", filename, err.message());
+
+  legacy::PassManager pass_manager;
+  TI_ERROR_IF(target_machine->addPassesToEmitFile(pass_manager, dest, nullptr,
+                                                  llvm::CGFT_ObjectFile),
+              "The target machine cannot emit object files.");
+  pass_manager.run(*module);
+  dest.flush();
+}
+
 std::unique_ptr<JITSession> create_llvm_jit_session_cpu(Arch arch) {
   std::unique_ptr<JITTargetMachineBuilder> jtmb;
   TI_ASSERT(arch_is_cpu(arch));
@@ -41,7 +41,7 @@ class CodeGenLLVMCUDA : public CodeGenLLVM {
     }
 
     auto jit = kernel->program.llvm_context_device->jit.get();
-    auto cuda_module = jit->add_module(std::move(module));
+    auto cuda_module = jit->add_module(std::move(module), /*fast_compile=*/false);
 
     return [offloaded_local, cuda_module,
             kernel = this->kernel](Context &context) {
@@ -420,11 +420,12 @@ class CodeGenLLVMCUDA : public CodeGenLLVM {
   void create_bls_buffer(OffloadedStmt *stmt) {
     auto type = llvm::ArrayType::get(llvm::Type::getInt8Ty(*llvm_context),
                                      stmt->bls_size);
-    bls_buffer = new GlobalVariable(
+    auto buffer = new GlobalVariable(
         *module, type, false, llvm::GlobalValue::ExternalLinkage, nullptr,
         "bls_buffer", nullptr, llvm::GlobalVariable::NotThreadLocal,
         3 /*addrspace=shared*/);
-    bls_buffer->setAlignment(llvm::MaybeAlign(8));
+    buffer->setAlignment(llvm::MaybeAlign(8));
+    bls_buffer = buffer;
   }
 
   void visit(OffloadedStmt *stmt) override {
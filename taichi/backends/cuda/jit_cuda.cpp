@@ -86,7 +86,8 @@ class JITSessionCUDA : public JITSession {
       : data_layout(data_layout) {
   }
 
-  virtual JITModule *add_module(std::unique_ptr<llvm::Module> M) override {
+  virtual JITModule *add_module(std::unique_ptr<llvm::Module> M,
+                                bool fast_compile) override {
     auto ptx = compile_module_to_ptx(M);
     if (get_current_program().config.print_kernel_nvptx) {
       static FileSequenceWriter writer("taichi_kernel_nvptx_{:04d}.ptx",
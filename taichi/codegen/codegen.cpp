@@ -34,12 +34,12 @@ FunctionType KernelCodeGen::compile() {
 
 std::unique_ptr<KernelCodeGen> KernelCodeGen::create(Arch arch,
                                                      Kernel *kernel,
-                                                     Stmt *stmt) {
+                                                     IRNode *ir) {
   if (arch_is_cpu(arch)) {
-    return std::make_unique<CodeGenCPU>(kernel, stmt);
+    return std::make_unique<CodeGenCPU>(kernel, ir);
   } else if (arch == Arch::cuda) {
 #if defined(TI_WITH_CUDA)
-    return std::make_unique<CodeGenCUDA>(kernel, stmt);
+    return std::make_unique<CodeGenCUDA>(kernel, ir);
 #else
     TI_NOT_IMPLEMENTED
 #endif
@@ -13,13 +13,19 @@ class KernelCodeGen {
   IRNode *ir;
 
  public:
+  // Trade code quality for compile time, see CompileConfig::tiered_compilation.
+  // Only the CPU backends make use of it.
+  bool fast_compile{false};
+
   KernelCodeGen(Kernel *kernel, IRNode *ir);
 
   virtual ~KernelCodeGen() = default;
 
+  // Compiles |ir| (the whole kernel by default), which may be a task or a
+  // copy of kernel->ir.
   static std::unique_ptr<KernelCodeGen> create(Arch arch,
                                                Kernel *kernel,
-                                               Stmt *stmt = nullptr);
+                                               IRNode *ir = nullptr);
 
   virtual FunctionType compile();
 
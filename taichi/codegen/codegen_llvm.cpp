@@ -120,7 +120,7 @@ CodeGenStmtGuard make_while_after_loop_guard(CodeGenLLVM *cg) {
 
 // CodeGenLLVM
 
-uint64 CodeGenLLVM::task_counter = 0;
+std::atomic<uint64> CodeGenLLVM::task_counter{0};
 
 void CodeGenLLVM::visit(Block *stmt_list) {
   for (auto &stmt : stmt_list->statements) {
@@ -203,7 +203,7 @@ std::unique_ptr<RuntimeObject> CodeGenLLVM::emit_struct_meta_object(
     emit_struct_meta_base("Root", meta->ptr, snode);
   } else if (snode->type == SNodeType::dynamic) {
     meta = std::make_unique<RuntimeObject>("DynamicMeta", this, builder.get());
-    emit_struct_meta_base("Dynamic", meta->ptr, snode);
+    emit_struct_meta_base(get_runtime_snode_name(snode), meta->ptr, snode);
     meta->call("set_chunk_size", tlctx->get_constant(snode->chunk_size));
   } else if (snode->type == SNodeType::bitmasked) {
     meta =
@@ -716,7 +716,11 @@ void CodeGenLLVM::visit(WhileControlStmt *stmt) {
 void CodeGenLLVM::visit(ContinueStmt *stmt) {
   using namespace llvm;
   if (stmt->as_return()) {
-    builder->CreateRetVoid();
+    if (current_offload_reentry != nullptr) {
+      builder->CreateBr(current_offload_reentry);
+    } else {
+      builder->CreateRetVoid();
+    }
   } else {
     TI_ASSERT(current_loop_reentry != nullptr);
     builder->CreateBr(current_loop_reentry);
@@ -764,14 +768,58 @@ void CodeGenLLVM::emit_list_gen(OffloadedStmt *listgen) {
     // Since there's only one container to expand, we need a special kernel for
     // more parallelism.
     call("element_listgen_root", get_runtime(), meta_parent, meta_child);
-  } else {
+  } else if (listgen->bbox_indices.empty()) {
     call("element_listgen_nonroot", get_runtime(), meta_parent, meta_child);
+  } else {
+    // The coordinates of the parent cells to keep, i.e. the bounding box with
+    // its corners rounded down to the cells of the parent
+    auto lower = create_entry_block_alloca(physical_coordinate_ty);
+    auto upper = create_entry_block_alloca(physical_coordinate_ty);
+    for (int i = 0; i < taichi_max_num_indices; i++) {
+      call("PhysicalCoordinates_set_val", lower, tlctx->get_constant(i),
+           tlctx->get_constant(std::numeric_limits<int32>::min()));
+      call("PhysicalCoordinates_set_val", upper, tlctx->get_constant(i),
+           tlctx->get_constant(std::numeric_limits<int32>::max()));
+    }
+    for (int i = 0; i < (int)listgen->bbox_indices.size(); i++) {
+      int k = listgen->bbox_indices[i];
+      // The bounds are i32 values stored in the global temporaries
+      auto load_bound = [&](std::size_t offset) {
+        auto buffer = call("get_temporary_pointer", get_runtime(),
+                           tlctx->get_constant((int64)offset));
+        return builder->CreateLoad(builder->CreatePointerCast(
+            buffer, llvm::Type::getInt32PtrTy(*llvm_context)));
+      };
+      auto cell_mask =
+          tlctx->get_constant(~((1 << snode_parent->extractors[k].start) - 1));
+      auto cell_lower = builder->CreateAnd(
+          load_bound(listgen->bbox_lower_offsets[i]), cell_mask);
+      auto cell_upper = builder->CreateAnd(
+          builder->CreateSub(load_bound(listgen->bbox_upper_offsets[i]),
+                             tlctx->get_constant(1)),
+          cell_mask);
+      call("PhysicalCoordinates_set_val", lower, tlctx->get_constant(k),
+           cell_lower);
+      call("PhysicalCoordinates_set_val", upper, tlctx->get_constant(k),
+           cell_upper);
+    }
+    call("element_listgen_nonroot_bounded", get_runtime(), meta_parent,
+         meta_child, lower, upper);
   }
 }
 
 void CodeGenLLVM::emit_gc(OffloadedStmt *stmt) {
   auto snode = stmt->snode->id;
-  call("node_gc", get_runtime(), tlctx->get_constant(snode));
+  if (arch_is_cpu(current_arch()) && prog->config.cpu_parallel_gc &&
+      prog->config.cpu_max_num_threads > 1) {
+    call("gc_parallel_cpu", get_runtime(), tlctx->get_constant(snode),
+         tlctx->get_constant(prog->config.cpu_max_num_threads));
+  } else {
+    call("node_gc", get_runtime(), tlctx->get_constant(snode));
+  }
+  if (prog->config.compact_sparse_memory) {
+    call("node_compact", get_runtime(), tlctx->get_constant(snode));
+  }
 }
 
 llvm::Value *CodeGenLLVM::create_call(llvm::Value *func,
@@ -1103,7 +1151,7 @@ std::string CodeGenLLVM::get_runtime_snode_name(SNode *snode) {
   } else if (snode->type == SNodeType::dense) {
     return "Dense";
   } else if (snode->type == SNodeType::dynamic) {
-    return "Dynamic";
+    return snode->chunk_directory ? "DynamicDirectory" : "Dynamic";
   } else if (snode->type == SNodeType::pointer) {
     return "Pointer";
   } else if (snode->type == SNodeType::hash) {
@@ -1138,10 +1186,10 @@ llvm::Value *CodeGenLLVM::call(SNode *snode,
 
 void CodeGenLLVM::visit(GetRootStmt *stmt) {
   llvm_val[stmt] = builder->CreateBitCast(
-      get_root(),
-      llvm::PointerType::get(StructCompilerLLVM::get_llvm_node_type(
-                                 module.get(), prog->snode_root.get()),
-                             0));
+      get_root(stmt->root->snode_tree_id),
+      llvm::PointerType::get(
+          StructCompilerLLVM::get_llvm_node_type(module.get(), stmt->root),
+          0));
 }
 
 void CodeGenLLVM::visit(BitExtractStmt *stmt) {
@@ -1153,6 +1201,16 @@ void CodeGenLLVM::visit(BitExtractStmt *stmt) {
 
 void CodeGenLLVM::visit(LinearizeStmt *stmt) {
   llvm::Value *val = tlctx->get_constant(0);
+  if (!stmt->bit_masks.empty()) {
+    // Morton or tiled layout: interleave the bits of the indices
+    for (int i = 0; i < (int)stmt->inputs.size(); i++) {
+      val = builder->CreateOr(
+          val, create_bit_deposit(builder.get(), llvm_val[stmt->inputs[i]],
+                                  (uint32)stmt->bit_masks[i]));
+    }
+    llvm_val[stmt] = val;
+    return;
+  }
   for (int i = 0; i < (int)stmt->inputs.size(); i++) {
     val = builder->CreateAdd(
         builder->CreateMul(val, tlctx->get_constant(stmt->strides[i])),
@@ -1257,9 +1315,13 @@ std::string CodeGenLLVM::init_offloaded_task_function(OffloadedStmt *stmt,
       llvm::FunctionType::get(llvm::Type::getVoidTy(*llvm_context),
                               {llvm::PointerType::get(context_ty, 0)}, false);
 
-  auto task_kernel_name = fmt::format("{}_{}_{}{}", kernel_name, task_counter,
-                                      stmt->task_name(), suffix);
-  task_counter += 1;
+  auto task_kernel_name =
+      fmt::format("{}_{}_{}{}", kernel_name, task_counter++, stmt->task_name(),
+                  suffix);
+  if (prog->config.kernel_profiler) {
+    prog->profiler->register_task_type(
+        task_kernel_name, offloaded_task_type_name(stmt->task_type));
+  }
   func = llvm::Function::Create(task_function_type,
                                 llvm::Function::ExternalLinkage,
                                 task_kernel_name, module.get());
@@ -1330,6 +1392,20 @@ void CodeGenLLVM::create_offload_struct_for(OffloadedStmt *stmt, bool spmd) {
 
   llvm::Function *body = nullptr;
   auto leaf_block = stmt->snode;
+
+  // On CPUs the TLS xlogues run once per worker thread in
+  // parallel_struct_for, instead of once per block in the loop body.
+  llvm::Value *tls_prologue = nullptr, *tls_epilogue = nullptr;
+  if (!spmd) {
+    tls_prologue = create_xlogue(stmt->tls_prologue);
+    tls_epilogue = create_xlogue(stmt->tls_epilogue);
+  } else {
+    auto xlogue_ptr_type =
+        llvm::PointerType::get(get_xlogue_function_type(), 0);
+    tls_prologue = llvm::ConstantPointerNull::get(xlogue_ptr_type);
+    tls_epilogue = llvm::ConstantPointerNull::get(xlogue_ptr_type);
+  }
+
   {
     // Create the loop body function
     auto guard = get_function_creation_guard({
@@ -1346,7 +1422,7 @@ void CodeGenLLVM::create_offload_struct_for(OffloadedStmt *stmt, bool spmd) {
      *
      * function_body (entry):
      *   loop_index = lower_bound;
-     *   tls_prologue()
+     *   tls_prologue() (GPUs only)
      *   bls_prologue()
      *   goto loop_test
      *
@@ -1373,7 +1449,7 @@ void CodeGenLLVM::create_offload_struct_for(OffloadedStmt *stmt, bool spmd) {
      *
      * func_exit:
      *   bls_epilogue()
-     *   tls_epilogue()
+     *   tls_epilogue() (GPUs only)
      *   return
      */
 
@@ -1388,7 +1464,16 @@ void CodeGenLLVM::create_offload_struct_for(OffloadedStmt *stmt, bool spmd) {
 
     parent_coordinates = element.get_ptr("pcoord");
 
-    if (stmt->tls_prologue) {
+    if (!spmd && stmt->bls_size > 0) {
+      // On CPUs the BLS buffer lives on the stack of the block task, so that
+      // it stays in the cache of the worker thread processing the block.
+      bls_buffer = create_entry_block_alloca(
+          llvm::ArrayType::get(llvm::Type::getInt8Ty(*llvm_context),
+                               stmt->bls_size),
+          8);
+    }
+
+    if (spmd && stmt->tls_prologue) {
       stmt->tls_prologue->accept(this);
     }
 
@@ -1511,7 +1596,7 @@ void CodeGenLLVM::create_offload_struct_for(OffloadedStmt *stmt, bool spmd) {
       call("block_barrier");  // "__syncthreads()"
     }
 
-    if (stmt->tls_epilogue) {
+    if (spmd && stmt->tls_epilogue) {
       stmt->tls_epilogue->accept(this);
     }
   }
@@ -1519,6 +1604,11 @@ void CodeGenLLVM::create_offload_struct_for(OffloadedStmt *stmt, bool spmd) {
   int list_element_size =
       std::min(leaf_block->max_num_elements(), taichi_listgen_max_element_size);
   int num_splits = std::max(1, list_element_size / stmt->block_dim);
+  if (!spmd && stmt->bls_prologue) {
+    // Do not split blocks with BLS on CPUs. Otherwise every part would fetch
+    // the whole BLS buffer.
+    num_splits = 1;
+  }
 
   auto struct_for_func = get_runtime_function("parallel_struct_for");
 
@@ -1565,7 +1655,7 @@ void CodeGenLLVM::create_offload_struct_for(OffloadedStmt *stmt, bool spmd) {
       struct_for_func,
       {get_context(), tlctx->get_constant(leaf_block->id),
        tlctx->get_constant(list_element_size), tlctx->get_constant(num_splits),
-       body, tlctx->get_constant(stmt->tls_size),
+       body, tls_prologue, tls_epilogue, tlctx->get_constant(stmt->tls_size),
        tlctx->get_constant(stmt->num_cpu_threads)});
   // TODO: why do we need num_cpu_threads on GPUs?
 }
@@ -1671,8 +1761,14 @@ void CodeGenLLVM::visit(StackPopStmt *stmt) {
 
 void CodeGenLLVM::visit(StackPushStmt *stmt) {
   auto stack = stmt->stack->as<StackAllocaStmt>();
-  call("stack_push", llvm_val[stack], tlctx->get_constant(stack->max_size),
-       tlctx->get_constant(stack->element_size_in_bytes()));
+  if (prog->config.debug) {
+    call("stack_push_with_check", get_runtime(), llvm_val[stack],
+         tlctx->get_constant(stack->max_size),
+         tlctx->get_constant(stack->element_size_in_bytes()));
+  } else {
+    call("stack_push", llvm_val[stack], tlctx->get_constant(stack->max_size),
+         tlctx->get_constant(stack->element_size_in_bytes()));
+  }
   auto primal_ptr = call("stack_top_primal", llvm_val[stack],
                          tlctx->get_constant(stack->element_size_in_bytes()));
   primal_ptr = builder->CreateBitCast(
@@ -1730,16 +1826,33 @@ void CodeGenLLVM::eliminate_unused_functions() {
 
 FunctionType CodeGenLLVM::compile_module_to_executable() {
   TI_AUTO_PROF
+  if (arch_is_cpu(kernel->arch)) {
+    // Link large runtime functions against the shared runtime module instead
+    // of optimizing and emitting a copy for every kernel
+    for (auto &f : *module) {
+      if (!f.isDeclaration() &&
+          !f.hasFnAttribute(llvm::Attribute::AlwaysInline) &&
+          tlctx->is_shared_runtime_function(f.getName().str())) {
+        f.deleteBody();
+      }
+    }
+  }
   eliminate_unused_functions();
 
-  tlctx->add_module(std::move(module));
+  auto jit_module = tlctx->add_module(std::move(module), fast_compile);
+  // Removes the module once the last copy of the returned function is gone,
+  // e.g. when the kernel is deleted or replaced by an optimized version
+  auto tlctx_ = tlctx;
+  std::shared_ptr<JITModule> module_guard(
+      jit_module, [tlctx_](JITModule *m) { tlctx_->jit->remove_module(m); });
 
   for (auto &task : offloaded_tasks) {
     task.compile();
   }
   auto offloaded_tasks_local = offloaded_tasks;
   auto kernel_name_ = kernel_name;
-  return [=](Context &context) {
+  return [offloaded_tasks_local, kernel_name_,
+          module_guard](Context &context) {
     TI_TRACE("Launching kernel {}", kernel_name_);
     for (auto task : offloaded_tasks_local) {
       task(&context);
@@ -1792,8 +1905,9 @@ llvm::Type *CodeGenLLVM::get_xlogue_function_type() {
                                  get_xlogue_argument_types(), false);
 }
 
-llvm::Value *CodeGenLLVM::get_root() {
-  return create_call("LLVMRuntime_get_root", {get_runtime()});
+llvm::Value *CodeGenLLVM::get_root(int snode_tree_id) {
+  return create_call("LLVMRuntime_get_roots",
+                     {get_runtime(), tlctx->get_constant(snode_tree_id)});
 }
 
 llvm::Value *CodeGenLLVM::get_runtime() {
@@ -1818,6 +1932,17 @@ FunctionType CodeGenLLVM::gen() {
   return compile_module_to_executable();
 }
 
+LLVMCompiledKernel CodeGenLLVM::gen_module() {
+  emit_to_module();
+  eliminate_unused_functions();
+  LLVMCompiledKernel ret;
+  for (auto &task : offloaded_tasks) {
+    ret.task_names.push_back(task.name);
+  }
+  ret.module = std::move(module);
+  return ret;
+}
+
 llvm::Value *CodeGenLLVM::create_xlogue(std::unique_ptr<Block> &block) {
   llvm::Value *xlogue;
 
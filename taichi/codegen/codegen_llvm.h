@@ -1,6 +1,7 @@
 // The LLVM backend for CPUs/NVPTX/AMDGPU
 #pragma once
 
+#include <atomic>
 #include <set>
 #include <unordered_map>
 
@@ -34,6 +35,12 @@ class OffloadedTask {
   void operator()(Context *context);
 };
 
+// A kernel emitted to LLVM IR but not yet handed to the JIT
+struct LLVMCompiledKernel {
+  std::unique_ptr<llvm::Module> module;
+  std::vector<std::string> task_names;
+};
+
 class FunctionCreationGuard {
  public:
   CodeGenLLVM *mb;
@@ -49,20 +56,26 @@ class FunctionCreationGuard {
 
 class CodeGenLLVM : public IRVisitor, public LLVMModuleBuilder {
  public:
-  static uint64 task_counter;
+  // Kernels may be compiled on several threads
+  static std::atomic<uint64> task_counter;
 
   Kernel *kernel;
   IRNode *ir;
   Program *prog;
+  // See KernelCodeGen::fast_compile
+  bool fast_compile{false};
   std::string kernel_name;
   std::vector<llvm::Value *> kernel_args;
   llvm::Type *context_ty;
   llvm::Type *physical_coordinate_ty;
   llvm::Value *current_coordinates;
   llvm::Value *parent_coordinates{nullptr};
-  llvm::GlobalVariable *bls_buffer{nullptr};
+  llvm::Value *bls_buffer{nullptr};
   // Mainly for supporting continue stmt
   llvm::BasicBlock *current_loop_reentry;
+  // Where a continue at the top level of an offloaded task goes, when the
+  // task body runs a block of iterations itself. Otherwise it returns.
+  llvm::BasicBlock *current_offload_reentry{nullptr};
   // Mainly for supporting break stmt
   llvm::BasicBlock *current_while_after_loop;
   llvm::FunctionType *task_function_type;
@@ -98,7 +111,7 @@ class CodeGenLLVM : public IRVisitor, public LLVMModuleBuilder {
 
   llvm::Type *get_xlogue_function_type();
 
-  llvm::Value *get_root();
+  llvm::Value *get_root(int snode_tree_id);
 
   llvm::Value *get_runtime();
 
@@ -118,6 +131,9 @@ class CodeGenLLVM : public IRVisitor, public LLVMModuleBuilder {
 
   virtual FunctionType gen();
 
+  // Emits the kernel without JIT compiling it, e.g. for AOT export
+  LLVMCompiledKernel gen_module();
+
   // only for debugging on CPU
   llvm::Value *create_print(std::string tag, DataType dt, llvm::Value *value);
 
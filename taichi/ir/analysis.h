@@ -57,6 +57,9 @@ struct TaskMeta;
 namespace irpass::analysis {
 
 AliasResult alias_analysis(Stmt *var1, Stmt *var2);
+// Returns the maximum number of pushes of each adstack (StackAllocaStmt) whose
+// bound is known at compile time.
+std::unordered_map<Stmt *, std::size_t> bound_stack_pushes(IRNode *root);
 std::unique_ptr<ControlFlowGraph> build_cfg(IRNode *root);
 void check_fields_registered(IRNode *root);
 std::unique_ptr<IRNode> clone(IRNode *root, Kernel *kernel = nullptr);
@@ -67,6 +70,8 @@ std::unordered_set<Stmt *> detect_loops_with_continue(IRNode *root);
 std::unordered_set<SNode *> gather_deactivations(IRNode *root);
 std::vector<Stmt *> gather_statements(IRNode *root,
                                       const std::function<bool(Stmt *)> &test);
+// The place SNodes stored to (or atomically updated) in |root|
+std::unordered_set<SNode *> gather_written_snodes(IRNode *root);
 std::unique_ptr<std::unordered_set<AtomicOpStmt *>> gather_used_atomics(
     IRNode *root);
 std::vector<Stmt *> get_load_pointers(Stmt *load_stmt);
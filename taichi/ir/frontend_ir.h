@@ -125,6 +125,9 @@ class FrontendForStmt : public Stmt {
   bool strictly_serialized;
   ScratchPadOptions scratch_opt;
   int block_dim;
+  // For struct-fors restricted to a bounding box: the lower (inclusive) and
+  // upper (exclusive) bounds of each loop index
+  std::vector<Expr> bbox_lower, bbox_upper;
 
   bool is_ranged() const {
     if (global_var.expr == nullptr) {
@@ -1,5 +1,7 @@
 #include "taichi/ir/snode.h"
 
+#include <algorithm>
+
 #include "taichi/ir/ir.h"
 #include "taichi/ir/frontend.h"
 #include "taichi/ir/statements.h"
@@ -27,6 +29,7 @@ SNode &SNode::insert_children(SNodeType t) {
   auto new_ch = std::make_unique<SNode>(depth + 1, t);
   new_ch->is_path_all_dense = (is_path_all_dense && ((t == SNodeType::dense) ||
                                                      (t == SNodeType::place)));
+  new_ch->snode_tree_id = snode_tree_id;
   ch.push_back(std::move(new_ch));
   // Note: |new_ch->parent| will not be set until structural nodes are compiled!
   // (But why..?)
@@ -88,12 +91,23 @@ SNode &SNode::create_node(std::vector<Index> indices,
   return new_node;
 }
 
-SNode &SNode::dynamic(const Index &expr, int n, int chunk_size) {
+SNode &SNode::dynamic(const Index &expr,
+                      int n,
+                      int chunk_size,
+                      bool chunk_directory) {
   auto &snode = create_node({expr}, {n}, SNodeType::dynamic);
   snode.chunk_size = chunk_size;
+  snode.chunk_directory = chunk_directory;
   return snode;
 }
 
+SNode &SNode::set_list_chunk_size(int n) {
+  TI_ERROR_IF(n <= 0 || !bit::is_power_of_two(n),
+              "List chunk size must be a positive power of two, got {}.", n);
+  list_chunk_size = n;
+  return *this;
+}
+
 void SNode::lazy_grad() {
   if (this->type == SNodeType::place)
     return;
@@ -235,6 +249,88 @@ std::string SNode::get_node_type_name_hinted() const {
   return fmt::format("S{}{}{}", id, snode_type_name(type), suffix);
 }
 
+SNode &SNode::morton(bool val) {
+  TI_ERROR_IF(type != SNodeType::dense && type != SNodeType::bitmasked,
+              "Only dense and bitmasked SNodes support the Morton layout");
+  _morton = val;
+  return *this;
+}
+
+SNode &SNode::tile(std::vector<int> sizes) {
+  TI_ERROR_IF(type != SNodeType::dense && type != SNodeType::bitmasked,
+              "Only dense and bitmasked SNodes support tiled layouts");
+  int num_indices = 0;
+  for (int i = 0; i < taichi_max_num_indices; i++) {
+    num_indices += extractors[i].active;
+  }
+  if (sizes.size() == 1) {
+    sizes = std::vector<int>(num_indices, sizes[0]);
+  }
+  TI_ERROR_IF((int)sizes.size() != num_indices,
+              "Expected {} tile sizes, got {}", num_indices, sizes.size());
+  int k = 0;
+  for (int i = 0; i < taichi_max_num_indices; i++) {
+    if (!extractors[i].active)
+      continue;
+    auto s = sizes[k++];
+    TI_ERROR_IF(s <= 0 || !bit::is_power_of_two(s),
+                "Tile size must be a positive power of two, got {}", s);
+    TI_ERROR_IF(bit::log2int(s) > extractors[i].num_bits,
+                "Tile size {} exceeds the node size {}", s,
+                1 << extractors[i].num_bits);
+    tile_num_bits[i] = bit::log2int(s);
+  }
+  return *this;
+}
+
+bool SNode::has_custom_layout() const {
+  if (_morton)
+    return true;
+  for (int i = 0; i < taichi_max_num_indices; i++) {
+    if (tile_num_bits[i])
+      return true;
+  }
+  return false;
+}
+
+std::vector<uint32> SNode::get_index_bit_masks() const {
+  if (!has_custom_layout())
+    return {};
+  TI_ERROR_IF(_morton && std::any_of(std::begin(tile_num_bits),
+                                     std::end(tile_num_bits),
+                                     [](int b) { return b != 0; }),
+              "An SNode cannot be both Morton-ordered and tiled");
+  std::vector<uint32> masks(taichi_max_num_indices, 0);
+  int pos = 0;
+  int num_bits[taichi_max_num_indices];
+  for (int i = 0; i < taichi_max_num_indices; i++) {
+    num_bits[i] = extractors[i].num_bits;
+  }
+  if (_morton) {
+    // Interleave one bit of each index at a time
+    int max_bits = *std::max_element(std::begin(num_bits), std::end(num_bits));
+    for (int b = 0; b < max_bits; b++) {
+      for (int i = taichi_max_num_indices - 1; i >= 0; i--) {
+        if (b < num_bits[i])
+          masks[i] |= 1u << (pos++);
+      }
+    }
+  } else {
+    // The position within the tile, then the tile, both row-major, i.e. the
+    // last index takes the lowest bits
+    for (int i = taichi_max_num_indices - 1; i >= 0; i--) {
+      for (int b = 0; b < tile_num_bits[i]; b++)
+        masks[i] |= 1u << (pos++);
+    }
+    for (int i = taichi_max_num_indices - 1; i >= 0; i--) {
+      for (int b = tile_num_bits[i]; b < num_bits[i]; b++)
+        masks[i] |= 1u << (pos++);
+    }
+  }
+  TI_ASSERT(pos == total_num_bits);
+  return masks;
+}
+
 int SNode::get_num_bits(int physical_index) const {
   int result = 0;
   const SNode *snode = this;
@@ -76,6 +76,12 @@ class SNode {
   int64 n{};
   int total_num_bits{}, total_bit_start{};
   int chunk_size{};
+  // Dynamic SNodes only: index the chunks through an inline directory instead
+  // of a linked list, so that element access takes O(1).
+  bool chunk_directory{};
+  // Number of elements per chunk in the runtime lists (the element list and
+  // the node allocator) of this SNode. Zero means the default.
+  int list_chunk_size{};
   DataType dt;
   bool has_ambient{};
   TypedConstant ambient_val;
@@ -88,6 +94,10 @@ class SNode {
   // Whether the path from root to |this| contains only `dense` SNodes.
   bool is_path_all_dense{false};
 
+  // The SNode tree this node belongs to, see Program::add_snode_tree(). Zero
+  // for the tree under ti.root.
+  int snode_tree_id{0};
+
   SNode();
 
   SNode(int depth, SNodeType t);
@@ -98,7 +108,10 @@ class SNode {
 
   std::string node_type_name;
   SNodeType type;
+  // Z-order layout of the elements, see get_index_bit_masks()
   bool _morton{};
+  // log2 of the tile size along each physical index for tiled layouts
+  int tile_num_bits[taichi_max_num_indices]{};
 
   std::string get_node_type_name() const;
 
@@ -175,12 +188,26 @@ class SNode {
 
   void place(Expr &expr, const std::vector<int> &offset);
 
-  SNode &dynamic(const Index &expr, int n, int chunk_size);
+  SNode &dynamic(const Index &expr,
+                 int n,
+                 int chunk_size,
+                 bool chunk_directory = false);
 
-  SNode &morton(bool val = true) {
-    _morton = val;
-    return *this;
-  }
+  SNode &morton(bool val = true);
+
+  // Stores the elements in tiles of |sizes|, row-major within each tile. A
+  // single size applies to all indices.
+  SNode &tile(std::vector<int> sizes);
+
+  bool has_custom_layout() const;
+
+  // Bits of the linearized element index taken by each physical index, for
+  // Morton and tiled layouts. The i-th lowest bit of an index goes to the i-th
+  // lowest set bit of its mask, so linearization is a parallel bit deposit and
+  // its inverse a parallel bit extract. Empty for row-major layouts.
+  std::vector<uint32> get_index_bit_masks() const;
+
+  SNode &set_list_chunk_size(int n);
 
   // for float and double
   void write_float(const std::vector<int> &I, float64);
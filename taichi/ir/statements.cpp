@@ -225,19 +225,25 @@ StructForStmt::StructForStmt(SNode *snode,
                              std::unique_ptr<Block> &&body,
                              int vectorize,
                              int parallelize,
-                             int block_dim)
+                             int block_dim,
+                             const std::vector<Stmt *> &bbox_lower,
+                             const std::vector<Stmt *> &bbox_upper)
     : snode(snode),
       body(std::move(body)),
       vectorize(vectorize),
       parallelize(parallelize),
-      block_dim(block_dim) {
+      block_dim(block_dim),
+      bbox_lower(bbox_lower),
+      bbox_upper(bbox_upper) {
   this->body->parent_stmt = this;
   TI_STMT_REG_FIELDS;
 }
 
 std::unique_ptr<Stmt> StructForStmt::clone() const {
-  auto new_stmt = std::make_unique<StructForStmt>(
-      snode, body->clone(), vectorize, parallelize, block_dim);
+  auto new_stmt =
+      std::make_unique<StructForStmt>(snode, body->clone(), vectorize,
+                                      parallelize, block_dim, bbox_lower,
+                                      bbox_upper);
   new_stmt->scratch_opt = scratch_opt;
   return new_stmt;
 }
@@ -332,6 +338,9 @@ std::unique_ptr<Stmt> OffloadedStmt::clone() const {
   new_stmt->reversed = reversed;
   new_stmt->num_cpu_threads = num_cpu_threads;
   new_stmt->device = device;
+  new_stmt->bbox_indices = bbox_indices;
+  new_stmt->bbox_lower_offsets = bbox_lower_offsets;
+  new_stmt->bbox_upper_offsets = bbox_upper_offsets;
   if (body) {
     new_stmt->body = body->clone();
     new_stmt->body->parent_stmt = new_stmt.get();
@@ -559,12 +559,21 @@ class StructForStmt : public Stmt {
   int parallelize;
   int block_dim;
   ScratchPadOptions scratch_opt;
+  // If not empty, the loop only needs to visit the elements whose coordinates
+  // lie in this bounding box: bbox_lower[i] <= j < bbox_upper[i], where j is
+  // the physical coordinate (i.e. without index_offsets) of the i-th loop
+  // index. The body must still skip the elements outside the box, which
+  // listgen only prunes at the granularity of the parent cells.
+  std::vector<Stmt *> bbox_lower;
+  std::vector<Stmt *> bbox_upper;
 
   StructForStmt(SNode *snode,
                 std::unique_ptr<Block> &&body,
                 int vectorize,
                 int parallelize,
-                int block_dim);
+                int block_dim,
+                const std::vector<Stmt *> &bbox_lower = {},
+                const std::vector<Stmt *> &bbox_upper = {});
 
   bool is_container_statement() const override {
     return true;
@@ -577,7 +586,9 @@ class StructForStmt : public Stmt {
                      vectorize,
                      parallelize,
                      block_dim,
-                     scratch_opt);
+                     scratch_opt,
+                     bbox_lower,
+                     bbox_upper);
   TI_DEFINE_ACCEPT
 };
 
@@ -694,11 +705,16 @@ class LinearizeStmt : public Stmt {
  public:
   std::vector<Stmt *> inputs;
   std::vector<int> strides;
+  // For Morton and tiled layouts, the bits of the result taken by each input,
+  // see SNode::get_index_bit_masks(). Empty for row-major layouts.
+  std::vector<int> bit_masks;
 
   LinearizeStmt(const std::vector<Stmt *> &inputs,
-                const std::vector<int> &strides)
-      : inputs(inputs), strides(strides) {
+                const std::vector<int> &strides,
+                const std::vector<int> &bit_masks = {})
+      : inputs(inputs), strides(strides), bit_masks(bit_masks) {
     TI_ASSERT(inputs.size() == strides.size());
+    TI_ASSERT(bit_masks.empty() || inputs.size() == bit_masks.size());
     TI_STMT_REG_FIELDS;
   }
 
@@ -706,7 +722,7 @@ class LinearizeStmt : public Stmt {
     return false;
   }
 
-  TI_STMT_DEF_FIELDS(ret_type, inputs, strides);
+  TI_STMT_DEF_FIELDS(ret_type, inputs, strides, bit_masks);
   TI_DEFINE_ACCEPT_AND_CLONE
 };
 
@@ -731,7 +747,10 @@ class BitExtractStmt : public Stmt {
 
 class GetRootStmt : public Stmt {
  public:
-  GetRootStmt() {
+  // The root of the SNode tree
+  SNode *root;
+
+  explicit GetRootStmt(SNode *root) : root(root) {
     TI_STMT_REG_FIELDS;
   }
 
@@ -739,7 +758,7 @@ class GetRootStmt : public Stmt {
     return false;
   }
 
-  TI_STMT_DEF_FIELDS(ret_type);
+  TI_STMT_DEF_FIELDS(ret_type, root);
   TI_DEFINE_ACCEPT_AND_CLONE
 };
 
@@ -808,6 +827,13 @@ class OffloadedStmt : public Stmt {
 
   std::vector<int> index_offsets;
 
+  // For listgens of struct-fors restricted to a bounding box (see
+  // StructForStmt::bbox_lower): the physical index of each bound, and the
+  // offsets of the lower and upper bounds in the global temporaries
+  std::vector<int> bbox_indices;
+  std::vector<std::size_t> bbox_lower_offsets;
+  std::vector<std::size_t> bbox_upper_offsets;
+
   std::unique_ptr<Block> tls_prologue;
   std::unique_ptr<Block> bls_prologue;
   std::unique_ptr<Block> body;
@@ -853,6 +879,9 @@ class OffloadedStmt : public Stmt {
                      num_cpu_threads,
                      device,
                      index_offsets,
+                     bbox_indices,
+                     bbox_lower_offsets,
+                     bbox_upper_offsets,
                      scratch_opt);
   TI_DEFINE_ACCEPT
 };
@@ -31,6 +31,8 @@ bool alg_simp(IRNode *root);
 bool demote_operations(IRNode *root);
 bool binary_op_simplify(IRNode *root);
 bool whole_kernel_cse(IRNode *root);
+bool loop_invariant_code_motion(IRNode *root);
+bool strength_reduce_indices(IRNode *root);
 void variable_optimization(IRNode *root, bool after_lower_access);
 void extract_constant(IRNode *root);
 bool unreachable_code_elimination(IRNode *root);
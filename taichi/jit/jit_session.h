@@ -19,9 +19,28 @@ class JITSession {
   JITSession() {
   }
 
-  virtual JITModule *add_module(std::unique_ptr<llvm::Module> M) = 0;
+  // With |fast_compile|, the backend may trade code quality for compile time
+  virtual JITModule *add_module(std::unique_ptr<llvm::Module> M,
+                                bool fast_compile) = 0;
 
-  // virtual void remove_module(JITModule *module) = 0;
+  // Frees the code of |module|. Its functions must no longer be called.
+  virtual void remove_module(JITModule *module) {
+    TI_NOT_IMPLEMENTED
+  }
+
+  virtual std::size_t get_num_modules() {
+    return modules.size();
+  }
+
+  // Host memory allocated for the code and data of the modules, in bytes
+  virtual std::size_t get_memory_usage() {
+    return 0;
+  }
+
+  // Modules added afterwards resolve their undefined symbols in |module|
+  virtual void set_shared_module(JITModule *module) {
+    TI_NOT_IMPLEMENTED
+  }
 
   virtual void *lookup(const std::string Name) {
     TI_NOT_IMPLEMENTED
@@ -1,7 +1,43 @@
 #include "llvm_codegen_utils.h"
 
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/IntrinsicsX86.h"
+#include "llvm/Support/Host.h"
+
 TLANG_NAMESPACE_BEGIN
 
+namespace {
+
+// pdep and pext are microcoded and slow on AMD CPUs before Zen 3, where the
+// shift-and-mask sequence below is faster.
+bool host_has_fast_pdep() {
+  static bool result = [] {
+    llvm::StringMap<bool> features;
+    if (!llvm::sys::getHostCPUFeatures(features))
+      return false;
+    auto cpu = llvm::sys::getHostCPUName();
+    return features.lookup("bmi2") && !cpu.startswith("znver1") &&
+           !cpu.startswith("znver2");
+  }();
+  return result;
+}
+
+// The bits moved by a deposit into |mask|, grouped by how far they move: maps
+// each shift to the bits of the source that move by it.
+std::map<int, uint32> group_bit_moves(uint32 mask) {
+  std::map<int, uint32> moves;
+  int src = 0;
+  for (int dst = 0; dst < 32; dst++) {
+    if (mask & (1u << dst)) {
+      moves[dst - src] |= 1u << src;
+      src++;
+    }
+  }
+  return moves;
+}
+
+}  // namespace
+
 std::string type_name(llvm::Type *type) {
   std::string type_name_str;
   llvm::raw_string_ostream rso(type_name_str);
@@ -41,4 +77,38 @@ void check_func_call_signature(llvm::Value *func,
   }
 }
 
+llvm::Value *LLVMModuleBuilder::create_bit_deposit(llvm::IRBuilder<> *builder,
+                                                   llvm::Value *x,
+                                                   uint32 mask) {
+  if (tlctx->get_arch() == Arch::x64 && host_has_fast_pdep()) {
+    auto pdep = llvm::Intrinsic::getDeclaration(
+        module.get(), llvm::Intrinsic::x86_bmi_pdep_32);
+    return builder->CreateCall(pdep, {x, tlctx->get_constant(mask)});
+  }
+  llvm::Value *ret = tlctx->get_constant(0);
+  for (auto &move : group_bit_moves(mask)) {
+    auto bits = builder->CreateAnd(x, tlctx->get_constant(move.second));
+    ret = builder->CreateOr(
+        ret, builder->CreateShl(bits, tlctx->get_constant(move.first)));
+  }
+  return ret;
+}
+
+llvm::Value *LLVMModuleBuilder::create_bit_gather(llvm::IRBuilder<> *builder,
+                                                  llvm::Value *x,
+                                                  uint32 mask) {
+  if (tlctx->get_arch() == Arch::x64 && host_has_fast_pdep()) {
+    auto pext = llvm::Intrinsic::getDeclaration(
+        module.get(), llvm::Intrinsic::x86_bmi_pext_32);
+    return builder->CreateCall(pext, {x, tlctx->get_constant(mask)});
+  }
+  llvm::Value *ret = tlctx->get_constant(0);
+  for (auto &move : group_bit_moves(mask)) {
+    auto bits = builder->CreateLShr(x, tlctx->get_constant(move.first));
+    ret = builder->CreateOr(
+        ret, builder->CreateAnd(bits, tlctx->get_constant(move.second)));
+  }
+  return ret;
+}
+
 TLANG_NAMESPACE_END
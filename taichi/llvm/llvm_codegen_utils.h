@@ -125,6 +125,18 @@ class LLVMModuleBuilder {
   llvm::Value *call(const std::string &func_name, Args &&... args) {
     return call(this->builder.get(), func_name, std::forward<Args>(args)...);
   }
+
+  // Parallel bit deposit of an i32: scatters the low bits of |x| to the set
+  // bits of |mask|, like the BMI2 pdep instruction.
+  llvm::Value *create_bit_deposit(llvm::IRBuilder<> *builder,
+                                  llvm::Value *x,
+                                  uint32 mask);
+
+  // Parallel bit extract of an i32: gathers the bits of |x| at the set bits of
+  // |mask| into the low bits, like the BMI2 pext instruction.
+  llvm::Value *create_bit_gather(llvm::IRBuilder<> *builder,
+                                 llvm::Value *x,
+                                 uint32 mask);
 };
 
 class RuntimeObject {
@@ -530,13 +530,25 @@ void TaichiLLVMContext::set_struct_module(
     TI_ERROR("module broken");
   }
   data->struct_module = llvm::CloneModule(*module);
+  {
+    // The other threads clone the new struct module when they need it
+    std::lock_guard<std::mutex> _(thread_map_mut);
+    for (auto &it : per_thread_data) {
+      if (it.second.get() != data)
+        it.second->struct_module.reset();
+    }
+  }
+  // Modules of SNode trees added later are based on the current struct
+  // module, whose runtime functions are already processed below
+  const bool first_tree = runtime_jit_module == nullptr;
   if (!arch_is_cpu(arch)) {
     for (auto &f : *data->struct_module) {
       bool is_kernel = false;
       if (arch == Arch::cuda) {
         std::string func_name = f.getName();
         if (starts_with(func_name, "runtime_")) {
-          mark_function_as_cuda_kernel(&f);
+          if (first_tree)
+            mark_function_as_cuda_kernel(&f);
           is_kernel = true;
         }
       }
@@ -549,12 +561,38 @@ void TaichiLLVMContext::set_struct_module(
     }
   }
 
+  // The runtime does not depend on the SNode trees, so that kernels compiled
+  // before a tree is added keep linking against the same runtime. The
+  // accessors of the new tree are compiled into the kernels using them.
+  if (!first_tree)
+    return;
+
   auto runtime_module = clone_struct_module();
-  eliminate_unused_functions(runtime_module.get(), [](std::string func_name) {
-    return starts_with(func_name, "runtime_") ||
-           starts_with(func_name, "LLVMRuntime_");
-  });
-  runtime_jit_module = add_module(std::move(runtime_module));
+  if (arch_is_cpu(arch)) {
+    // Compile the runtime and the struct accessors once with all their
+    // functions exported. Kernels call the large ones here instead of carrying
+    // their own copies, see is_shared_runtime_function.
+    shared_runtime_functions.clear();
+    for (auto &f : *runtime_module) {
+      if (!f.isDeclaration() && f.hasExternalLinkage() &&
+          num_instructions(&f) > max_inlined_runtime_function_size) {
+        shared_runtime_functions.insert(f.getName().str());
+      }
+    }
+    runtime_jit_module = add_module(std::move(runtime_module));
+    jit->set_shared_module(runtime_jit_module);
+  } else {
+    eliminate_unused_functions(runtime_module.get(), [](std::string func_name) {
+      return starts_with(func_name, "runtime_") ||
+             starts_with(func_name, "LLVMRuntime_");
+    });
+    runtime_jit_module = add_module(std::move(runtime_module));
+  }
+}
+
+bool TaichiLLVMContext::is_shared_runtime_function(
+    const std::string &name) const {
+  return shared_runtime_functions.find(name) != shared_runtime_functions.end();
 }
 
 template <typename T>
@@ -653,8 +691,9 @@ llvm::DataLayout TaichiLLVMContext::get_data_layout() {
   return jit->get_data_layout();
 }
 
-JITModule *TaichiLLVMContext::add_module(std::unique_ptr<llvm::Module> module) {
-  return jit->add_module(std::move(module));
+JITModule *TaichiLLVMContext::add_module(std::unique_ptr<llvm::Module> module,
+                                         bool fast_compile) {
+  return jit->add_module(std::move(module), fast_compile);
 }
 
 void TaichiLLVMContext::insert_nvvm_annotation(llvm::Function *func,
@@ -8,6 +8,7 @@
 #include <mutex>
 #include <functional>
 #include <thread>
+#include <unordered_set>
 
 #include "taichi/lang_util.h"
 #include "taichi/llvm/llvm_fwd.h"
@@ -35,10 +36,15 @@ class TaichiLLVMContext {
   std::mutex mut;
   std::mutex thread_map_mut;
 
+  // Runtime functions with more instructions are not copied into kernels
+  static constexpr int max_inlined_runtime_function_size = 64;
+  std::unordered_set<std::string> shared_runtime_functions;
+
  public:
   std::unique_ptr<JITSession> jit;
   // main_thread is defined to be the thread that runs the initializer
-  JITModule *runtime_jit_module;
+  // Compiled with the first SNode tree, see set_struct_module()
+  JITModule *runtime_jit_module{nullptr};
 
   std::unique_ptr<llvm::Module> clone_module_to_context(
       llvm::Module *module,
@@ -50,11 +56,21 @@ class TaichiLLVMContext {
 
   TaichiLLVMContext(Arch arch);
 
+  Arch get_arch() const {
+    return arch;
+  }
+
   std::unique_ptr<llvm::Module> clone_struct_module();
 
   void set_struct_module(const std::unique_ptr<llvm::Module> &module);
 
-  JITModule *add_module(std::unique_ptr<llvm::Module> module);
+  // On CPUs, whether kernels should call |name| in the shared runtime module
+  // instead of inlining it. True for large runtime functions with external
+  // linkage; those marked always-inline are kept in the kernel anyway.
+  bool is_shared_runtime_function(const std::string &name) const;
+
+  JITModule *add_module(std::unique_ptr<llvm::Module> module,
+                        bool fast_compile = false);
 
   virtual void *lookup_function_pointer(const std::string &name) {
     return jit->lookup(name);
@@ -144,6 +144,7 @@ void ExecutionQueue::enqueue(const TaskLaunchRecord &ker) {
             is_extension_supported(config.arch, Extension::bls) &&
                 config.make_block_local);
       }
+      TI_TRACE_SCOPE("compile offloaded task");
       auto func = this->compile_to_backend_(*kernel, stmt);
       async_func->set(func);
     });
@@ -152,6 +153,7 @@ void ExecutionQueue::enqueue(const TaskLaunchRecord &ker) {
 
   launch_worker.enqueue([async_func, context = ker.context]() mutable {
     auto func = async_func->get();
+    TI_TRACE_SCOPE("launch offloaded task");
     func(context);
   });
 }
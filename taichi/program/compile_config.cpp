@@ -27,6 +27,7 @@ CompileConfig::CompileConfig() {
   default_ip = PrimitiveType::i32;
   verbose_kernel_launches = false;
   kernel_profiler = false;
+  kernel_profiler_counters = false;
   default_cpu_block_dim = 32;
   default_gpu_block_dim = 128;
   verbose = true;
@@ -35,10 +36,19 @@ CompileConfig::CompileConfig() {
   flatten_if = false;
   make_thread_local = true;
   make_block_local = true;
+  reuse_neighbor_lookups = true;
+  strength_reduce_indices = true;
+  tiered_compilation = false;
+  tiered_compilation_threshold = 8;
+  max_num_kernels = 0;
+  layout_advisor = false;
 
   saturating_grid_dim = 0;
   max_block_dim = 0;
   cpu_max_num_threads = std::thread::hardware_concurrency();
+  cpu_parallel_gc = true;
+  gc_lazy_zero_fill = false;
+  compact_sparse_memory = false;
 
   ad_stack_size = 16;
 
@@ -26,12 +26,31 @@ struct CompileConfig {
   bool use_llvm;
   bool verbose_kernel_launches;
   bool kernel_profiler;
+  bool kernel_profiler_counters;
   bool verbose;
   bool fast_math;
   bool async_mode;
   bool flatten_if;
   bool make_thread_local;
   bool make_block_local;
+  bool reuse_neighbor_lookups;
+  // Replace the index arithmetic that reproduces the bits of a loop index with
+  // the loop index itself (see irpass::strength_reduce_indices)
+  bool strength_reduce_indices;
+  // On CPUs, compile kernels quickly at first, and recompile them with full
+  // optimization in the background after |tiered_compilation_threshold|
+  // launches
+  bool tiered_compilation;
+  int tiered_compilation_threshold;
+  // Maximum number of kernel instances kept by the Python frontend, which
+  // deletes the least recently launched ones beyond it. 0 for no limit.
+  int max_num_kernels;
+  // Record which fields each kernel accesses together and time each launch,
+  // to propose an AoS/SoA grouping of the fields (see LayoutAdvisor)
+  bool layout_advisor;
+  // A grouping saved by the layout advisor, applied when ti.root is
+  // materialized
+  std::string layout_advice_file;
   DataType default_fp;
   DataType default_ip;
   std::string extra_flags;
@@ -42,6 +61,9 @@ struct CompileConfig {
   int saturating_grid_dim;
   int max_block_dim;
   int cpu_max_num_threads;
+  bool cpu_parallel_gc;
+  bool gc_lazy_zero_fill;
+  bool compact_sparse_memory;
 
   // LLVM backend options:
   bool print_struct_llvm_ir;
@@ -10,10 +10,11 @@ bool is_extension_supported(Arch arch, Extension ext) {
   static std::unordered_map<Arch, std::unordered_set<Extension>> arch2ext = {
       {Arch::x64,
        {Extension::sparse, Extension::async_mode, Extension::data64,
-        Extension::adstack, Extension::assertion, Extension::extfunc}},
+        Extension::adstack, Extension::bls, Extension::assertion,
+        Extension::extfunc}},
       {Arch::arm64,
        {Extension::sparse, Extension::async_mode, Extension::data64,
-        Extension::adstack, Extension::assertion}},
+        Extension::adstack, Extension::bls, Extension::assertion}},
       {Arch::cuda,
        {Extension::sparse, Extension::async_mode, Extension::data64,
         Extension::adstack, Extension::bls, Extension::assertion}},
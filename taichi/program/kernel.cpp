@@ -6,10 +6,13 @@
 #include "taichi/program/async_engine.h"
 #include "taichi/codegen/codegen.h"
 #include "taichi/backends/cuda/cuda_driver.h"
+#include "taichi/ir/analysis.h"
 #include "taichi/ir/statements.h"
 #include "taichi/ir/transforms.h"
 #include "taichi/util/action_recorder.h"
 #include "taichi/program/extension.h"
+#include "taichi/system/timer.h"
+#include "taichi/system/tracer.h"
 
 TLANG_NAMESPACE_BEGIN
 
@@ -62,9 +65,33 @@ Kernel::Kernel(Program &program,
     compile();
 }
 
-void Kernel::compile() {
+void Kernel::compile(bool allow_fast_compile) {
   CurrentKernelGuard _(program, this);
-  compiled = program.compile(*this);
+  // Async mode compiles offloaded tasks on its own
+  bool fast_compile = allow_fast_compile &&
+                      program.config.tiered_compilation && arch_is_cpu(arch) &&
+                      !program.config.async_mode;
+  compiled = program.compile(*this, fast_compile);
+  fully_optimized = !fast_compile;
+}
+
+void Kernel::set_optimized(FunctionType func,
+                           std::unique_ptr<IRNode> func_ir) {
+  std::lock_guard<std::mutex> _(optimized_mut);
+  optimized = std::move(func);
+  optimized_ir = std::move(func_ir);
+  optimized_ready.store(true, std::memory_order_release);
+}
+
+void Kernel::update_tier() {
+  if (optimized_ready.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> _(optimized_mut);
+    compiled = std::move(optimized);
+    ir = std::move(optimized_ir);
+    fully_optimized = true;
+  } else if (++num_launches == program.config.tiered_compilation_threshold) {
+    program.optimize_in_background(this);
+  }
 }
 
 void Kernel::lower(bool to_executable) {  // TODO: is a "Lowerer" class
@@ -79,9 +106,15 @@ void Kernel::lower(bool to_executable) {  // TODO: is a "Lowerer" class
       verbose = false;
 
     if (to_executable) {
-      irpass::compile_to_executable(
-          ir.get(), config, /*vectorize*/ arch_is_cpu(arch), grad,
-          /*ad_use_stack=*/true, verbose, /*lower_global_access=*/to_executable,
+      irpass::compile_to_offloads(ir.get(), config, verbose,
+                                  /*vectorize=*/arch_is_cpu(arch), grad,
+                                  /*ad_use_stack=*/true);
+      // The layout advisor needs the global accesses before they are lowered
+      if (config.layout_advisor && !is_accessor && !is_evaluator) {
+        program.layout_advisor.record_kernel(this, ir.get());
+      }
+      irpass::offload_to_executable(
+          ir.get(), config, verbose, /*lower_global_access=*/true,
           /*make_thread_local=*/config.make_thread_local,
           /*make_block_local=*/
           is_extension_supported(config.arch, Extension::bls) &&
@@ -95,6 +128,41 @@ void Kernel::lower(bool to_executable) {  // TODO: is a "Lowerer" class
     TI_NOT_IMPLEMENTED
   }
   lowered = true;
+
+  std::unordered_set<SNode *> roots;
+  auto record = [&](SNode *snode) {
+    if (snode == nullptr)
+      return;
+    while (snode->parent != nullptr)
+      snode = snode->parent;
+    if (snode->snode_tree_id != 0)
+      roots.insert(snode);
+  };
+  irpass::analysis::gather_statements(ir.get(), [&](Stmt *stmt) {
+    if (auto ptr = stmt->cast<GlobalPtrStmt>()) {
+      for (auto snode : ptr->snodes.data)
+        record(snode);
+    } else if (auto get_root = stmt->cast<GetRootStmt>()) {
+      record(get_root->root);
+    } else if (auto snode_op = stmt->cast<SNodeOpStmt>()) {
+      record(snode_op->snode);
+    } else if (auto offloaded = stmt->cast<OffloadedStmt>()) {
+      record(offloaded->snode);
+    }
+    return false;
+  });
+  snode_tree_roots.assign(roots.begin(), roots.end());
+
+  written_snode_ids.clear();
+  for (auto snode : irpass::analysis::gather_written_snodes(ir.get()))
+    written_snode_ids.push_back(snode->id);
+}
+
+void Kernel::check_snode_trees_alive() const {
+  for (auto root : snode_tree_roots) {
+    TI_ERROR_IF(!program.is_snode_tree_alive(root),
+                "Kernel {} accesses fields of a destroyed SNode tree", name);
+  }
 }
 
 void Kernel::operator()(LaunchContextBuilder &ctx_builder) {
@@ -102,12 +170,30 @@ void Kernel::operator()(LaunchContextBuilder &ctx_builder) {
     if (!compiled) {
       compile();
     }
+    check_snode_trees_alive();
+    if (!fully_optimized) {
+      update_tier();
+    }
 
     for (auto &offloaded : ir->as<Block>()->statements) {
       account_for_offloaded(offloaded->as<OffloadedStmt>());
     }
 
-    compiled(ctx_builder.get_context());
+    {
+      if (trace_name_id < 0 && Tracer::is_enabled())
+        trace_name_id = Tracer::intern(name);
+      ScopedTrace _(trace_name_id);
+      if (program.config.layout_advisor && !is_accessor && !is_evaluator) {
+        // Time the launch on its own, for the bandwidth it achieves
+        program.synchronize();
+        auto t = Time::get_time();
+        compiled(ctx_builder.get_context());
+        program.synchronize();
+        program.layout_advisor.record_launch(this, Time::get_time() - t);
+      } else {
+        compiled(ctx_builder.get_context());
+      }
+    }
 
     program.sync = (program.sync && arch_is_cpu(arch));
     // Note that Kernel::arch may be different from program.config.arch
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+
 #include "taichi/lang_util.h"
 #include "taichi/ir/snode.h"
 #include "taichi/ir/ir.h"
@@ -47,6 +50,20 @@ class Kernel {
   bool is_accessor;
   bool is_evaluator;
   bool grad;
+  // Interned name for kernel launch events, see Tracer
+  int trace_name_id{-1};
+  // Tiered compilation, see CompileConfig::tiered_compilation. False while
+  // |compiled| comes from a fast compile.
+  bool fully_optimized{true};
+  int num_launches{0};
+  // Roots of the SNode trees other than ti.root accessed by the kernel, known
+  // once it is lowered. See Program::destroy_snode_tree.
+  std::vector<SNode *> snode_tree_roots;
+  // Ids of the SNodes written by the kernel, known once it is lowered. Kept
+  // apart from |ir| so that they outlive it, see ti.Tape.
+  std::vector<int> written_snode_ids;
+
+  void check_snode_trees_alive() const;
 
   // TODO: Give "Context" a more specific name.
   class LaunchContextBuilder {
@@ -88,7 +105,9 @@ class Kernel {
          std::string name = "",
          bool grad = false);
 
-  void compile();
+  // Compiles with only cheap optimizations first if tiered compilation is
+  // enabled and |allow_fast_compile|
+  void compile(bool allow_fast_compile = true);
 
   void lower(bool to_executable = true);
 
@@ -107,6 +126,21 @@ class Kernel {
   void set_arch(Arch arch);
 
   void account_for_offloaded(OffloadedStmt *stmt);
+
+  // Thread-safe. Hands over the fully optimized version of a kernel compiled
+  // with fast_compile, along with the copy of |ir| it was compiled from. They
+  // replace |compiled| and |ir| at the next launch.
+  void set_optimized(FunctionType func, std::unique_ptr<IRNode> func_ir);
+
+ private:
+  // Adopts the fully optimized version once ready, or requests it once the
+  // kernel has been launched often enough.
+  void update_tier();
+
+  std::atomic<bool> optimized_ready{false};
+  std::mutex optimized_mut;
+  FunctionType optimized;
+  std::unique_ptr<IRNode> optimized_ir;
 };
 
 TLANG_NAMESPACE_END
@@ -1,10 +1,72 @@
 #include "kernel_profiler.h"
 
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
 #include "taichi/system/timer.h"
 #include "taichi/backends/cuda/cuda_driver.h"
+#include "taichi/util/bit.h"
+
+#if defined(TI_PLATFORM_LINUX)
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 TLANG_NAMESPACE_BEGIN
 
+void DurationHistogram::insert(double ms) {
+  auto index = bucket_index((uint64)std::max(ms * 1e6, 0.0));
+  if (index >= (int)buckets_.size())
+    buckets_.resize(index + 1, 0);
+  buckets_[index]++;
+  count_++;
+}
+
+double DurationHistogram::percentile(double p) const {
+  if (count_ == 0)
+    return 0;
+  // The rank of the sample we are looking for, starting from 1
+  auto rank = std::max((uint64)std::ceil(p / 100.0 * count_), (uint64)1);
+  uint64 seen = 0;
+  int i = 0;
+  while (seen + buckets_[i] < rank) {
+    seen += buckets_[i];
+    i++;
+  }
+  return (bucket_begin(i) + bucket_width(i) * 0.5) * 1e-6;
+}
+
+int DurationHistogram::bucket_index(uint64 ns) {
+  constexpr uint64 num_sub_buckets = 1 << precision_bits;
+  if (ns < num_sub_buckets)
+    return (int)ns;
+  // Keep the leading |precision_bits| bits. The top bit is always 1, so each
+  // power of two above |num_sub_buckets| takes |num_sub_buckets / 2| buckets.
+  int shift = bit::log2int(ns) - (precision_bits - 1);
+  return shift * (num_sub_buckets / 2) + (int)(ns >> shift);
+}
+
+uint64 DurationHistogram::bucket_begin(int index) {
+  constexpr int num_sub_buckets = 1 << precision_bits;
+  if (index < num_sub_buckets)
+    return index;
+  int shift = index / (num_sub_buckets / 2) - 1;
+  return (uint64)(index - shift * (num_sub_buckets / 2)) << shift;
+}
+
+uint64 DurationHistogram::bucket_width(int index) {
+  constexpr int num_sub_buckets = 1 << precision_bits;
+  if (index < num_sub_buckets)
+    return 1;
+  return (uint64)1 << (index / (num_sub_buckets / 2) - 1);
+}
+
 void KernelProfileRecord::insert_sample(double t) {
   if (counter == 0) {
     min = t;
@@ -14,6 +76,7 @@ void KernelProfileRecord::insert_sample(double t) {
   min = std::min(min, t);
   max = std::max(max, t);
   total += t;
+  histogram.insert(t);
 }
 
 bool KernelProfileRecord::operator<(const KernelProfileRecord &o) const {
@@ -31,25 +94,106 @@ void KernelProfilerBase::profiler_stop(KernelProfilerBase *profiler) {
   profiler->stop();
 }
 
+KernelProfileRecord &KernelProfilerBase::get_record(const std::string &name) {
+  auto it =
+      std::find_if(records.begin(), records.end(),
+                   [&](KernelProfileRecord &r) { return r.name == name; });
+  if (it != records.end())
+    return *it;
+  std::string task_type;
+  {
+    std::lock_guard<std::mutex> _(task_types_mut_);
+    auto type_it = task_types_.find(name);
+    if (type_it != task_types_.end())
+      task_type = type_it->second;
+  }
+  records.emplace_back(name, task_type);
+  return records.back();
+}
+
+void KernelProfilerBase::register_task_type(const std::string &task_name,
+                                            const std::string &task_type) {
+  std::lock_guard<std::mutex> _(task_types_mut_);
+  task_types_[task_name] = task_type;
+}
+
+namespace {
+
+struct TaskTypeSummary {
+  std::string task_type;
+  int counter{0};
+  double total{0};
+};
+
+std::vector<TaskTypeSummary> summarize_task_types(
+    const std::vector<KernelProfileRecord> &records) {
+  std::vector<TaskTypeSummary> summaries;
+  for (auto &rec : records) {
+    auto task_type = rec.task_type.empty() ? "other" : rec.task_type;
+    auto it = std::find_if(
+        summaries.begin(), summaries.end(),
+        [&](TaskTypeSummary &s) { return s.task_type == task_type; });
+    if (it == summaries.end()) {
+      summaries.push_back(TaskTypeSummary{task_type});
+      it = std::prev(summaries.end());
+    }
+    it->counter += rec.counter;
+    it->total += rec.total;
+  }
+  std::sort(summaries.begin(), summaries.end(),
+            [](const TaskTypeSummary &a, const TaskTypeSummary &b) {
+              return a.total > b.total;
+            });
+  return summaries;
+}
+
+}  // namespace
+
 void KernelProfilerBase::print() {
   sync();
   fmt::print("{}\n", title());
   fmt::print(
       "========================================================================"
-      "=\n");
+      "=============================\n");
   fmt::print(
-      "[      %     total   count |      min       avg       max   ] Kernel "
-      "name\n");
+      "[      %     total   count |      min       avg       p50       p99     "
+      "  max   ] Kernel name\n");
   std::sort(records.begin(), records.end());
   for (auto &rec : records) {
     auto fraction = rec.total / total_time_ms * 100.0f;
-    fmt::print("[{:6.2f}% {:7.3f} s {:6d}x |{:9.3f} {:9.3f} {:9.3f} ms] {}\n",
-               fraction, rec.total / 1000.0f, rec.counter, rec.min,
-               rec.total / rec.counter, rec.max, rec.name);
+    fmt::print(
+        "[{:6.2f}% {:7.3f} s {:6d}x |{:9.3f} {:9.3f} {:9.3f} {:9.3f} {:9.3f} "
+        "ms] {}\n",
+        fraction, rec.total / 1000.0f, rec.counter, rec.min,
+        rec.total / rec.counter, rec.histogram.percentile(50),
+        rec.histogram.percentile(99), rec.max, rec.name);
   }
   fmt::print(
       "------------------------------------------------------------------------"
-      "-\n");
+      "-----------------------------\n");
+  for (auto &summary : summarize_task_types(records)) {
+    fmt::print("[{:6.2f}% {:7.3f} s {:6d}x] {} tasks\n",
+               summary.total / total_time_ms * 100.0f, summary.total / 1000.0f,
+               summary.counter, summary.task_type);
+  }
+  if (counters_enabled) {
+    fmt::print(
+        "----------------------------------------------------------------------"
+        "-------------------------------\n");
+    fmt::print(
+        "[    Gcycles      IPC  LLC misses   LLC MB/s ] Kernel name\n");
+    for (auto &rec : records) {
+      auto &c = rec.counters;
+      fmt::print("[{:11.3f} {:8.2f} {:11d} {:10.1f} ] {}\n", c.cycles * 1e-9,
+                 c.cycles ? (double)c.instructions / c.cycles : 0.0,
+                 c.llc_misses,
+                 rec.total > 0 ? c.llc_bytes() / 1e6 / (rec.total * 1e-3) : 0.0,
+                 rec.name);
+    }
+  }
+  fmt::print(
+      "------------------------------------------------------------------------"
+      "-----------------------------\n");
   fmt::print(
       "[100.00%] Total kernel execution time: {:7.3f} s   number of records: "
       "{}\n",
@@ -57,7 +201,45 @@ void KernelProfilerBase::print() {
 
   fmt::print(
       "========================================================================"
-      "=\n");
+      "=============================\n");
+}
+
+void KernelProfilerBase::dump_json(const std::string &filename) {
+  sync();
+  std::sort(records.begin(), records.end());
+  std::ofstream os(filename);
+  TI_ERROR_UNLESS(os, "Cannot open {}", filename);
+  os << fmt::format("{{\n  \"title\": \"{}\",\n  \"total_time_ms\": {},\n",
+                    title(), total_time_ms);
+  os << "  \"records\": [";
+  for (int i = 0; i < (int)records.size(); i++) {
+    auto &rec = records[i];
+    os << (i ? ",\n    " : "\n    ");
+    os << fmt::format(
+        "{{\"name\": \"{}\", \"task_type\": \"{}\", \"count\": {}, "
+        "\"total_ms\": {}, \"min_ms\": {}, \"avg_ms\": {}, \"max_ms\": {}, "
+        "\"p50_ms\": {}, \"p90_ms\": {}, \"p99_ms\": {}",
+        rec.name, rec.task_type, rec.counter, rec.total, rec.min,
+        rec.total / rec.counter, rec.max, rec.histogram.percentile(50),
+        rec.histogram.percentile(90), rec.histogram.percentile(99));
+    if (counters_enabled) {
+      os << fmt::format(
+          ", \"cycles\": {}, \"instructions\": {}, \"llc_misses\": {}, "
+          "\"llc_bytes\": {}",
+          rec.counters.cycles, rec.counters.instructions,
+          rec.counters.llc_misses, rec.counters.llc_bytes());
+    }
+    os << "}";
+  }
+  os << "\n  ],\n  \"task_types\": [";
+  auto summaries = summarize_task_types(records);
+  for (int i = 0; i < (int)summaries.size(); i++) {
+    os << (i ? ",\n    " : "\n    ");
+    os << fmt::format(
+        "{{\"task_type\": \"{}\", \"count\": {}, \"total_ms\": {}}}",
+        summaries[i].task_type, summaries[i].counter, summaries[i].total);
+  }
+  os << "\n  ]\n}\n";
 }
 
 double KernelProfilerBase::get_total_time() const {
@@ -65,11 +247,95 @@ double KernelProfilerBase::get_total_time() const {
 }
 
 namespace {
+
+// Samples HardwareCounters with perf_event_open(2), summed over the threads
+// that exist when the counters are opened, so that the CPU thread pool is
+// covered. Only user-space events are counted.
+class PerfCounters {
+ public:
+  static constexpr int num_counters = 3;
+  using Values = std::array<uint64, num_counters>;
+
+  PerfCounters() {
+#if defined(TI_PLATFORM_LINUX)
+    const uint64 configs[num_counters] = {PERF_COUNT_HW_CPU_CYCLES,
+                                          PERF_COUNT_HW_INSTRUCTIONS,
+                                          PERF_COUNT_HW_CACHE_MISSES};
+    auto dir = opendir("/proc/self/task");
+    if (!dir) {
+      TI_WARN("Cannot list threads, hardware counters are disabled");
+      return;
+    }
+    while (auto entry = readdir(dir)) {
+      if (entry->d_name[0] == '.')
+        continue;
+      auto tid = (pid_t)std::atoi(entry->d_name);
+      for (auto config : configs) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        auto fd = (int)syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+        if (fd < 0) {
+          TI_WARN(
+              "perf_event_open failed ({}), hardware counters are disabled. "
+              "Check /proc/sys/kernel/perf_event_paranoid.",
+              std::strerror(errno));
+          close_all();
+          closedir(dir);
+          return;
+        }
+        fds_.push_back(fd);
+      }
+    }
+    closedir(dir);
+#else
+    TI_WARN("Hardware counters are only supported on Linux");
+#endif
+  }
+
+  bool available() const {
+    return !fds_.empty();
+  }
+
+  Values read() const {
+    Values values{};
+#if defined(TI_PLATFORM_LINUX)
+    for (int i = 0; i < (int)fds_.size(); i++) {
+      uint64 value = 0;
+      if (::read(fds_[i], &value, sizeof(value)) == sizeof(value))
+        values[i % num_counters] += value;
+    }
+#endif
+    return values;
+  }
+
+  ~PerfCounters() {
+    close_all();
+  }
+
+ private:
+  void close_all() {
+#if defined(TI_PLATFORM_LINUX)
+    for (auto fd : fds_)
+      close(fd);
+#endif
+    fds_.clear();
+  }
+
+  // |num_counters| consecutive descriptors per thread
+  std::vector<int> fds_;
+};
+
 // A simple profiler that uses Time::get_time()
 class DefaultProfiler : public KernelProfilerBase {
  public:
-  explicit DefaultProfiler(Arch arch)
-      : title_(fmt::format("{} Profiler", arch_name(arch))) {
+  DefaultProfiler(Arch arch, bool hardware_counters)
+      : title_(fmt::format("{} Profiler", arch_name(arch))),
+        hardware_counters_(hardware_counters && arch_is_cpu(arch)) {
   }
 
   void sync() override {
@@ -80,6 +346,13 @@ class DefaultProfiler : public KernelProfilerBase {
   }
 
   void start(const std::string &kernel_name) override {
+    if (hardware_counters_ && !perf_) {
+      // Opened lazily so that the thread pool already exists
+      perf_ = std::make_unique<PerfCounters>();
+      counters_enabled = perf_->available();
+    }
+    if (counters_enabled)
+      counters_begin_ = perf_->read();
     start_t_ = Time::get_time();
     event_name_ = kernel_name;
   }
@@ -87,21 +360,24 @@ class DefaultProfiler : public KernelProfilerBase {
   void stop() override {
     auto t = Time::get_time() - start_t_;
     auto ms = t * 1000.0;
-    auto it = std::find_if(
-        records.begin(), records.end(),
-        [&](KernelProfileRecord &r) { return r.name == event_name_; });
-    if (it == records.end()) {
-      records.emplace_back(event_name_);
-      it = std::prev(records.end());
-    }
-    it->insert_sample(ms);
+    auto &rec = get_record(event_name_);
+    rec.insert_sample(ms);
     total_time_ms += ms;
+    if (counters_enabled) {
+      auto counters_end = perf_->read();
+      rec.counters.cycles += counters_end[0] - counters_begin_[0];
+      rec.counters.instructions += counters_end[1] - counters_begin_[1];
+      rec.counters.llc_misses += counters_end[2] - counters_begin_[2];
+    }
   }
 
  private:
   double start_t_;
   std::string event_name_;
   std::string title_;
+  bool hardware_counters_;
+  std::unique_ptr<PerfCounters> perf_;
+  PerfCounters::Values counters_begin_;
 };
 
 // A CUDA kernel profiler that uses CUDA timing events
@@ -147,14 +423,7 @@ class KernelProfilerCUDA : public KernelProfilerBase {
         auto start = item.first, stop = item.second;
         float ms;
         CUDADriver::get_instance().event_elapsed_time(&ms, start, stop);
-        auto it = std::find_if(
-            records.begin(), records.end(),
-            [&](KernelProfileRecord &r) { return r.name == map_elem.first; });
-        if (it == records.end()) {
-          records.emplace_back(map_elem.first);
-          it = std::prev(records.end());
-        }
-        it->insert_sample(ms);
+        get_record(map_elem.first).insert_sample(ms);
         total_time_ms += ms;
       }
     }
@@ -171,11 +440,12 @@ class KernelProfilerCUDA : public KernelProfilerBase {
 };
 }  // namespace
 
-std::unique_ptr<KernelProfilerBase> make_profiler(Arch arch) {
+std::unique_ptr<KernelProfilerBase> make_profiler(Arch arch,
+                                                  bool hardware_counters) {
   if (arch == Arch::cuda) {
     return std::make_unique<KernelProfilerCUDA>();
   } else {
-    return std::make_unique<DefaultProfiler>(arch);
+    return std::make_unique<DefaultProfiler>(arch, hardware_counters);
   }
 }
 
@@ -5,21 +5,65 @@
 
 #include <algorithm>
 #include <map>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 
 TLANG_NAMESPACE_BEGIN
 
+// A log-linear histogram of durations in the spirit of HdrHistogram. Samples
+// are bucketed by their leading |precision_bits| bits in nanoseconds, so
+// percentiles have a relative error below 2^(1 - precision_bits) at any scale,
+// while the memory stays logarithmic in the largest sample.
+class DurationHistogram {
+ public:
+  void insert(double ms);
+
+  // |p| is in [0, 100]. Returns the midpoint of the bucket in ms.
+  double percentile(double p) const;
+
+ private:
+  static constexpr int precision_bits = 6;
+
+  static int bucket_index(uint64 ns);
+
+  static uint64 bucket_begin(int index);
+
+  static uint64 bucket_width(int index);
+
+  std::vector<uint64> buckets_;
+  uint64 count_{0};
+};
+
+// Totals of the hardware counters over all samples of a record
+struct HardwareCounters {
+  uint64 cycles{0};
+  uint64 instructions{0};
+  uint64 llc_misses{0};
+
+  // Each last-level cache miss moves one cache line from memory
+  static constexpr int cache_line_bytes = 64;
+
+  uint64 llc_bytes() const {
+    return llc_misses * cache_line_bytes;
+  }
+};
+
 struct KernelProfileRecord {
   std::string name;
+  // The offloaded task type, e.g. "struct_for", or "" if unknown
+  std::string task_type;
   int counter;
   double min;
   double max;
   double total;
+  DurationHistogram histogram;
+  HardwareCounters counters;
 
-  KernelProfileRecord(const std::string &name)
-      : name(name), counter(0), min(0), max(0), total(0) {
+  KernelProfileRecord(const std::string &name, const std::string &task_type)
+      : name(name), task_type(task_type), counter(0), min(0), max(0), total(0) {
   }
 
   void insert_sample(double t);
@@ -30,7 +74,11 @@ struct KernelProfileRecord {
 class KernelProfilerBase {
  protected:
   std::vector<KernelProfileRecord> records;
-  double total_time_ms;
+  double total_time_ms{0};
+  // Set by profilers that sample HardwareCounters
+  bool counters_enabled{false};
+
+  KernelProfileRecord &get_record(const std::string &name);
 
  public:
   // Needed for the CUDA backend since we need to know which task to "stop"
@@ -60,14 +108,28 @@ class KernelProfilerBase {
 
   static void profiler_stop(KernelProfilerBase *profiler);
 
+  // Called by the code generators so that records can be grouped by the type
+  // of their offloaded task. Thread-safe.
+  void register_task_type(const std::string &task_name,
+                          const std::string &task_type);
+
   void print();
 
+  // Writes the records, including percentiles and hardware counters, as JSON
+  void dump_json(const std::string &filename);
+
   double get_total_time() const;
 
   virtual ~KernelProfilerBase() {
   }
+
+ private:
+  std::mutex task_types_mut_;
+  std::unordered_map<std::string, std::string> task_types_;
 };
 
-std::unique_ptr<KernelProfilerBase> make_profiler(Arch arch);
+// |hardware_counters| samples HardwareCounters for CPU tasks on Linux
+std::unique_ptr<KernelProfilerBase> make_profiler(Arch arch,
+                                                  bool hardware_counters);
 
 TLANG_NAMESPACE_END
@@ -0,0 +1,493 @@
+#include "taichi/program/layout_advisor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include "taichi/ir/analysis.h"
+#include "taichi/ir/snode.h"
+#include "taichi/ir/statements.h"
+#include "taichi/program/kernel.h"
+
+TLANG_NAMESPACE_BEGIN
+
+namespace {
+
+// A dense node directly under the root that only holds places. Its fields can
+// move to another such node of the same shape without changing how they are
+// indexed.
+bool is_regroupable(const SNode *node) {
+  if (node->type != SNodeType::dense || node->has_custom_layout() ||
+      node->ch.empty()) {
+    return false;
+  }
+  for (auto &c : node->ch) {
+    if (c->type != SNodeType::place || !c->dt->is<PrimitiveType>())
+      return false;
+  }
+  return true;
+}
+
+bool is_regroupable_field(const SNode *snode) {
+  return snode->type == SNodeType::place && snode->snode_tree_id == 0 &&
+         snode->parent && snode->parent->parent &&
+         snode->parent->parent->type == SNodeType::root &&
+         is_regroupable(snode->parent);
+}
+
+// Fields of nodes with the same key can be placed together
+std::string layout_key(const SNode *dense) {
+  std::string key;
+  for (int i = 0; i < taichi_max_num_indices; i++) {
+    if (dense->extractors[i].active) {
+      key += fmt::format("{}:{} ", i, dense->extractors[i].num_elements);
+    }
+  }
+  return key;
+}
+
+std::string shape_str(const SNode *dense) {
+  std::vector<std::string> sizes;
+  for (int i = 0; i < taichi_max_num_indices; i++) {
+    if (dense->extractors[i].active)
+      sizes.push_back(std::to_string(dense->extractors[i].num_elements));
+  }
+  return fmt::format("({})", fmt::join(sizes, ", "));
+}
+
+int64 num_elements(const SNode *snode) {
+  int64 n = 1;
+  for (int i = 0; i < snode->num_active_indices; i++) {
+    n *= snode->shape_along_axis(i);
+  }
+  return n;
+}
+
+float64 group_cell_bytes(const std::vector<SNode *> &group) {
+  float64 bytes = 0;
+  for (auto *snode : group)
+    bytes += data_type_size(snode->dt);
+  return bytes;
+}
+
+std::string field_name(const SNode *snode) {
+  if (snode->name.empty())
+    return snode->get_node_type_name_hinted();
+  return fmt::format("{}({})", snode->get_node_type_name_hinted(),
+                     snode->name);
+}
+
+std::string group_str(const std::vector<SNode *> &group) {
+  std::vector<std::string> names;
+  for (auto *snode : group)
+    names.push_back(field_name(snode));
+  return fmt::format("dense {}: {}", shape_str(group[0]->parent),
+                     fmt::join(names, ", "));
+}
+
+std::string bytes_str(float64 bytes) {
+  if (bytes >= 1e9)
+    return fmt::format("{:.2f} GB", bytes * 1e-9);
+  if (bytes >= 1e6)
+    return fmt::format("{:.2f} MB", bytes * 1e-6);
+  if (bytes >= 1e3)
+    return fmt::format("{:.2f} KB", bytes * 1e-3);
+  return fmt::format("{:.0f} B", bytes);
+}
+
+}  // namespace
+
+void LayoutAdvisor::record_kernel(Kernel *kernel, IRNode *ir) {
+  KernelRecord record;
+  for (auto &s : ir->as<Block>()->statements) {
+    auto offloaded = s->cast<OffloadedStmt>();
+    if (!offloaded || !offloaded->has_body())
+      continue;
+    TaskRecord task;
+    auto access = [&](Stmt *ptr_stmt, bool written) {
+      auto ptr = ptr_stmt->cast<GlobalPtrStmt>();
+      if (!ptr)
+        return;
+      for (auto snode : ptr->snodes.data) {
+        if (!is_regroupable_field(snode))
+          continue;
+        auto it = std::find_if(
+            task.fields.begin(), task.fields.end(),
+            [&](const FieldAccess &f) { return f.snode == snode; });
+        if (it == task.fields.end()) {
+          task.fields.emplace_back();
+          it = task.fields.end() - 1;
+          it->snode = snode;
+        }
+        it->written |= written;
+        if (ptr->is_element_wise(snode)) {
+          it->sequential = true;
+        } else {
+          it->random = true;
+        }
+      }
+    };
+    irpass::analysis::gather_statements(offloaded, [&](Stmt *stmt) {
+      if (auto load = stmt->cast<GlobalLoadStmt>()) {
+        access(load->src, /*written=*/false);
+      } else if (auto store = stmt->cast<GlobalStoreStmt>()) {
+        access(store->ptr, /*written=*/true);
+      } else if (auto atomic = stmt->cast<AtomicOpStmt>()) {
+        access(atomic->dest, /*written=*/true);
+      }
+      return false;
+    });
+    if (task.fields.empty())
+      continue;
+
+    if (offloaded->task_type == OffloadedTaskType::struct_for) {
+      task.num_iterations = num_elements(offloaded->snode);
+    } else if (offloaded->task_type == OffloadedTaskType::range_for) {
+      if (offloaded->const_begin && offloaded->const_end) {
+        task.num_iterations =
+            std::max(0, offloaded->end_value - offloaded->begin_value);
+      } else {
+        // Assume that a dynamic range covers the largest field accessed
+        task.num_iterations = 0;
+        for (auto &f : task.fields) {
+          task.num_iterations =
+              std::max(task.num_iterations, num_elements(f.snode));
+        }
+      }
+    }
+    record.tasks.push_back(std::move(task));
+  }
+
+  std::lock_guard<std::mutex> _(mut_);
+  auto &rec = kernels_[kernel->name];
+  rec.tasks = std::move(record.tasks);
+}
+
+void LayoutAdvisor::record_launch(Kernel *kernel, float64 seconds) {
+  std::lock_guard<std::mutex> _(mut_);
+  auto &rec = kernels_[kernel->name];
+  rec.num_launches++;
+  rec.total_time += seconds;
+}
+
+float64 LayoutAdvisor::task_bytes(const TaskRecord &task,
+                                  const std::vector<SNode *> &group) {
+  bool sequential = false, sequential_written = false;
+  bool random_written = false;
+  float64 random_bytes = 0;
+  for (auto &f : task.fields) {
+    if (std::find(group.begin(), group.end(), f.snode) == group.end())
+      continue;
+    if (f.sequential) {
+      sequential = true;
+      sequential_written |= f.written;
+    }
+    if (f.random) {
+      random_bytes += data_type_size(f.snode->dt);
+      random_written |= f.written;
+    }
+  }
+  float64 bytes = 0;
+  if (sequential) {
+    bytes += task.num_iterations * group_cell_bytes(group) *
+             (sequential_written ? 2 : 1);
+  }
+  if (random_bytes > 0) {
+    auto lines = std::ceil(random_bytes / cache_line_bytes);
+    bytes += task.num_iterations * lines * cache_line_bytes *
+             (random_written ? 2 : 1);
+  }
+  return bytes;
+}
+
+float64 LayoutAdvisor::total_bytes(const std::vector<SNode *> &group) const {
+  float64 bytes = 0;
+  for (auto &k : kernels_) {
+    for (auto &task : k.second.tasks) {
+      bytes += k.second.num_launches * task_bytes(task, group);
+    }
+  }
+  return bytes;
+}
+
+float64 LayoutAdvisor::launch_bytes(
+    const KernelRecord &kernel,
+    const std::vector<std::vector<SNode *>> &groups) const {
+  float64 bytes = 0;
+  for (auto &task : kernel.tasks) {
+    for (auto &group : groups) {
+      bytes += task_bytes(task, group);
+    }
+  }
+  return bytes;
+}
+
+bool LayoutAdvisor::accessed_together(const std::vector<SNode *> &a,
+                                      const std::vector<SNode *> &b) const {
+  auto touches = [](const TaskRecord &task, const std::vector<SNode *> &g) {
+    for (auto &f : task.fields) {
+      if (std::find(g.begin(), g.end(), f.snode) != g.end())
+        return true;
+    }
+    return false;
+  };
+  for (auto &k : kernels_) {
+    if (k.second.num_launches == 0)
+      continue;
+    for (auto &task : k.second.tasks) {
+      if (touches(task, a) && touches(task, b))
+        return true;
+    }
+  }
+  return false;
+}
+
+LayoutAdvice LayoutAdvisor::get_advice(SNode *root) const {
+  std::lock_guard<std::mutex> _(mut_);
+  LayoutAdvice advice;
+
+  std::set<SNode *> accessed;
+  for (auto &k : kernels_) {
+    if (k.second.num_launches == 0)
+      continue;
+    for (auto &task : k.second.tasks) {
+      for (auto &f : task.fields)
+        accessed.insert(f.snode);
+    }
+  }
+
+  // Nodes of the same shape, by key
+  std::map<std::string, std::vector<SNode *>> classes;
+  for (auto &c : root->ch) {
+    if (!is_regroupable(c.get()))
+      continue;
+    std::vector<SNode *> group;
+    for (auto &p : c->ch)
+      group.push_back(p.get());
+    advice.current.push_back(group);
+    classes[layout_key(c.get())].push_back(c.get());
+  }
+
+  for (auto &cls : classes) {
+    // Fields not accessed by any launched kernel stay as they are. The others
+    // start as SoA and are merged greedily while the traffic goes down, or
+    // stays the same for fields accessed by the same task.
+    std::vector<std::vector<SNode *>> groups;
+    for (auto *node : cls.second) {
+      std::vector<SNode *> untouched;
+      for (auto &p : node->ch) {
+        if (accessed.count(p.get())) {
+          groups.push_back({p.get()});
+        } else {
+          untouched.push_back(p.get());
+        }
+      }
+      if (!untouched.empty())
+        advice.proposed.push_back(untouched);
+    }
+    std::vector<float64> bytes;
+    for (auto &g : groups)
+      bytes.push_back(total_bytes(g));
+    while (true) {
+      int best_a = -1, best_b = -1;
+      float64 best_saving = -1;
+      std::vector<SNode *> best_merged;
+      for (int a = 0; a < (int)groups.size(); a++) {
+        for (int b = a + 1; b < (int)groups.size(); b++) {
+          auto merged = groups[a];
+          merged.insert(merged.end(), groups[b].begin(), groups[b].end());
+          auto saving = bytes[a] + bytes[b] - total_bytes(merged);
+          if (saving < 0.5 &&
+              (saving < -0.5 || !accessed_together(groups[a], groups[b]))) {
+            continue;
+          }
+          if (saving > best_saving) {
+            best_a = a;
+            best_b = b;
+            best_saving = saving;
+            best_merged = std::move(merged);
+          }
+        }
+      }
+      if (best_a == -1)
+        break;
+      groups[best_a] = std::move(best_merged);
+      bytes[best_a] = total_bytes(groups[best_a]);
+      groups.erase(groups.begin() + best_b);
+      bytes.erase(bytes.begin() + best_b);
+    }
+    advice.proposed.insert(advice.proposed.end(), groups.begin(),
+                           groups.end());
+  }
+
+  for (auto &g : advice.current)
+    advice.current_bytes += total_bytes(g);
+  for (auto &g : advice.proposed)
+    advice.proposed_bytes += total_bytes(g);
+  if (advice.proposed_bytes >= advice.current_bytes - 0.5) {
+    // Not worth changing the layout
+    advice.proposed = advice.current;
+    advice.proposed_bytes = advice.current_bytes;
+  }
+  return advice;
+}
+
+void LayoutAdvisor::print_report(SNode *root) const {
+  auto advice = get_advice(root);
+  std::lock_guard<std::mutex> _(mut_);
+
+  fmt::print("\n[Layout Advisor]\n");
+  fmt::print("Estimated memory traffic per launch:\n");
+  fmt::print("{:>40} {:>9} {:>12} {:>11} {:>11} {:>11}\n", "kernel",
+             "launches", "time/launch", "current", "proposed", "achieved");
+  for (auto &k : kernels_) {
+    auto &rec = k.second;
+    if (rec.num_launches == 0 || rec.tasks.empty())
+      continue;
+    auto current = launch_bytes(rec, advice.current);
+    auto proposed = launch_bytes(rec, advice.proposed);
+    auto time = rec.total_time / rec.num_launches;
+    fmt::print("{:>40} {:>9} {:>9.3f} ms {:>11} {:>11} {:>6.2f} GB/s\n",
+               k.first, rec.num_launches, time * 1e3, bytes_str(current),
+               bytes_str(proposed), time > 0 ? current / time * 1e-9 : 0.0);
+  }
+  fmt::print("Current grouping:\n");
+  for (auto &g : advice.current)
+    fmt::print("  {}\n", group_str(g));
+  if (advice.proposed_bytes < advice.current_bytes) {
+    fmt::print("Proposed grouping:\n");
+    for (auto &g : advice.proposed)
+      fmt::print("  {}\n", group_str(g));
+    fmt::print(
+        "Expected traffic of the recorded launches: {} -> {} ({:.1f}% less)\n",
+        bytes_str(advice.current_bytes), bytes_str(advice.proposed_bytes),
+        100 * (1 - advice.proposed_bytes / advice.current_bytes));
+  } else {
+    fmt::print("The current grouping is kept ({} moved by the recorded "
+               "launches)\n",
+               bytes_str(advice.current_bytes));
+  }
+}
+
+void LayoutAdvisor::save(SNode *root, const std::string &filename) const {
+  auto advice = get_advice(root);
+  std::ofstream fout(filename);
+  TI_ERROR_IF(!fout, "Cannot write the layout advice to {}", filename);
+  fout << "# Taichi layout advice: one group of fields per dense node, as\n"
+       << "# <place SNode id>:<data type>\n";
+  for (auto &g : advice.proposed) {
+    std::vector<std::string> names, fields;
+    for (auto *snode : g) {
+      names.push_back(field_name(snode));
+      fields.push_back(
+          fmt::format("{}:{}", snode->id, data_type_name(snode->dt)));
+    }
+    fout << fmt::format("# {}\n", fmt::join(names, ", "));
+    fout << fmt::format("group {}\n", fmt::join(fields, " "));
+  }
+}
+
+void LayoutAdvisor::clear() {
+  std::lock_guard<std::mutex> _(mut_);
+  kernels_.clear();
+}
+
+bool LayoutAdvisor::apply(SNode *root, const std::string &filename) {
+  std::ifstream fin(filename);
+  TI_ERROR_IF(!fin, "Cannot open the layout advice file {}", filename);
+
+  // Place id -> (place, dense node holding it)
+  std::map<int, std::pair<SNode *, SNode *>> fields;
+  for (auto &c : root->ch) {
+    if (!is_regroupable(c.get()))
+      continue;
+    for (auto &p : c->ch)
+      fields[p->id] = {p.get(), c.get()};
+  }
+
+  auto mismatch = [&](const std::string &reason) {
+    TI_WARN("Layout advice {} ignored: {}", filename, reason);
+    return false;
+  };
+
+  std::vector<std::vector<SNode *>> groups;
+  std::set<int> seen;
+  std::string line;
+  while (std::getline(fin, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream words(line);
+    std::string word;
+    words >> word;
+    if (word != "group")
+      return mismatch(fmt::format("unexpected line \"{}\"", line));
+    std::vector<SNode *> group;
+    while (words >> word) {
+      auto colon = word.find(':');
+      if (colon == std::string::npos || colon == 0 ||
+          !std::all_of(word.begin(), word.begin() + colon, ::isdigit)) {
+        return mismatch(fmt::format("unexpected field \"{}\"", word));
+      }
+      int id = std::stoi(word.substr(0, colon));
+      auto it = fields.find(id);
+      if (it == fields.end() ||
+          data_type_name(it->second.first->dt) != word.substr(colon + 1)) {
+        return mismatch(fmt::format("no {} field S{} in a dense node under "
+                                    "ti.root",
+                                    word.substr(colon + 1), id));
+      }
+      if (!seen.insert(id).second)
+        return mismatch(fmt::format("field S{} is in more than one group", id));
+      if (!group.empty() && layout_key(fields[group[0]->id].second) !=
+                                layout_key(it->second.second)) {
+        return mismatch(fmt::format("fields S{} and S{} have different shapes",
+                                    group[0]->id, id));
+      }
+      group.push_back(it->second.first);
+    }
+    if (!group.empty())
+      groups.push_back(group);
+  }
+
+  std::set<SNode *> emptied;
+  int num_regrouped = 0;
+  for (auto &group : groups) {
+    auto *node = fields[group[0]->id].second;
+    bool unchanged = node->ch.size() == group.size();
+    for (auto *place : group)
+      unchanged &= fields[place->id].second == node;
+    if (unchanged)
+      continue;
+
+    auto &new_node = root->insert_children(SNodeType::dense);
+    new_node.n = node->n;
+    for (int i = 0; i < taichi_max_num_indices; i++)
+      new_node.extractors[i] = node->extractors[i];
+    new_node.list_chunk_size = node->list_chunk_size;
+    for (auto *place : group) {
+      auto *old = fields[place->id].second;
+      auto it = std::find_if(
+          old->ch.begin(), old->ch.end(),
+          [&](const std::unique_ptr<SNode> &c) { return c.get() == place; });
+      new_node.ch.push_back(std::move(*it));
+      old->ch.erase(it);
+      fields[place->id].second = &new_node;
+      emptied.insert(old);
+    }
+    num_regrouped++;
+  }
+  root->ch.erase(std::remove_if(root->ch.begin(), root->ch.end(),
+                                [&](const std::unique_ptr<SNode> &c) {
+                                  return emptied.count(c.get()) &&
+                                         c->ch.empty();
+                                }),
+                 root->ch.end());
+  TI_INFO("Layout advice {} applied, {} dense nodes regrouped", filename,
+          num_regrouped);
+  return true;
+}
+
+TLANG_NAMESPACE_END
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "taichi/lang_util.h"
+
+TLANG_NAMESPACE_BEGIN
+
+class IRNode;
+class Kernel;
+class SNode;
+
+// Groupings of the fields placed in dense nodes directly under ti.root, one
+// dense node (i.e. one AoS) per group, and the estimated bytes moved by the
+// recorded kernel launches under each of them.
+struct LayoutAdvice {
+  std::vector<std::vector<SNode *>> current;
+  std::vector<std::vector<SNode *>> proposed;
+  float64 current_bytes{0};
+  float64 proposed_bytes{0};
+};
+
+// Records which fields the offloaded tasks of each kernel access together, and
+// how often and how fast each kernel runs, and proposes an AoS/SoA grouping of
+// the fields from them. See CompileConfig::layout_advisor.
+//
+// The memory traffic of a task is modeled per group of fields. Accesses at the
+// loop index stream the whole group once (twice if written), so fields that are
+// not accessed make AoS groups more expensive. Other accesses, e.g. x[i + 1] or
+// x[p[i]], fetch a cache line of the group per iteration, so fields accessed
+// together this way are cheaper in AoS groups.
+class LayoutAdvisor {
+ public:
+  // |ir| is the offloaded IR of |kernel|, before global accesses are lowered
+  void record_kernel(Kernel *kernel, IRNode *ir);
+
+  void record_launch(Kernel *kernel, float64 seconds);
+
+  LayoutAdvice get_advice(SNode *root) const;
+
+  void print_report(SNode *root) const;
+
+  // Saves the proposed grouping in a file for CompileConfig::layout_advice_file
+  void save(SNode *root, const std::string &filename) const;
+
+  void clear();
+
+  // Regroups the fields under |root| as saved in |filename|, before the layout
+  // is materialized. Fields not in the file are left in place. Returns false,
+  // leaving |root| unchanged, if the file does not match the fields.
+  static bool apply(SNode *root, const std::string &filename);
+
+  static constexpr int cache_line_bytes = 64;
+
+ private:
+  struct FieldAccess {
+    SNode *snode{nullptr};
+    bool written{false};
+    // Accessed at the loop index
+    bool sequential{false};
+    // Accessed at other indices
+    bool random{false};
+  };
+
+  struct TaskRecord {
+    int64 num_iterations{1};
+    std::vector<FieldAccess> fields;
+  };
+
+  struct KernelRecord {
+    std::vector<TaskRecord> tasks;
+    int64 num_launches{0};
+    float64 total_time{0};
+  };
+
+  static float64 task_bytes(const TaskRecord &task,
+                            const std::vector<SNode *> &group);
+
+  // Over all recorded launches
+  float64 total_bytes(const std::vector<SNode *> &group) const;
+
+  float64 launch_bytes(const KernelRecord &kernel,
+                       const std::vector<std::vector<SNode *>> &groups) const;
+
+  bool accessed_together(const std::vector<SNode *> &a,
+                         const std::vector<SNode *> &b) const;
+
+  std::map<std::string, KernelRecord> kernels_;
+  mutable std::mutex mut_;
+};
+
+TLANG_NAMESPACE_END
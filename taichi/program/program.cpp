@@ -2,6 +2,7 @@
 
 #include "program.h"
 
+#include "taichi/ir/analysis.h"
 #include "taichi/ir/statements.h"
 #include "taichi/program/extension.h"
 #include "taichi/backends/metal/api.h"
@@ -24,6 +25,7 @@
 #include "taichi/program/async_engine.h"
 #include "taichi/util/statistics.h"
 #include "taichi/util/str.h"
+#include "taichi/system/tracer.h"
 #if defined(TI_WITH_CC)
 #include "taichi/backends/cc/struct_cc.h"
 #include "taichi/backends/cc/cc_layout.h"
@@ -51,6 +53,10 @@ void *taichi_allocate_aligned(Program *prog,
   return prog->memory_pool->allocate(size, alignment);
 }
 
+std::size_t taichi_release_memory(Program *prog, void *ptr, std::size_t size) {
+  return prog->memory_pool->release(ptr, size);
+}
+
 inline uint64 *allocate_result_buffer_default(Program *prog) {
   return (uint64 *)taichi_allocate_aligned(
       prog, sizeof(uint64) * taichi_result_buffer_entries, 8);
@@ -120,7 +126,7 @@ Program::Program(Arch desired_arch) {
   config.arch = arch;
 
   llvm_context_host = std::make_unique<TaichiLLVMContext>(host_arch());
-  profiler = make_profiler(arch);
+  profiler = make_profiler(arch, config.kernel_profiler_counters);
 
   preallocated_device_buffer = nullptr;
 
@@ -203,14 +209,19 @@ TypeFactory &Program::get_type_factory() {
   return TypeFactory::get_instance();
 }
 
-FunctionType Program::compile(Kernel &kernel) {
+thread_local Program::Kernel *Program::current_kernel = nullptr;
+
+FunctionType Program::compile(Kernel &kernel, bool fast_compile) {
   auto start_t = Time::get_time();
   TI_AUTO_PROF;
   FunctionType ret = nullptr;
   if (arch_is_cpu(kernel.arch) || kernel.arch == Arch::cuda ||
       kernel.arch == Arch::metal) {
-    kernel.lower();
-    ret = compile_to_backend_executable(kernel, /*offloaded=*/nullptr);
+    // AOT export may have lowered the kernel already
+    if (!kernel.lowered)
+      kernel.lower();
+    ret = compile_to_backend_executable(kernel, /*offloaded=*/nullptr,
+                                        fast_compile);
   } else if (kernel.arch == Arch::opengl) {
     opengl::OpenglCodeGen codegen(kernel.name, &opengl_struct_compiled_.value(),
                                   opengl_kernel_launcher_.get());
@@ -223,14 +234,50 @@ FunctionType Program::compile(Kernel &kernel) {
     TI_NOT_IMPLEMENTED;
   }
   TI_ASSERT(ret);
-  total_compilation_time += Time::get_time() - start_t;
+  {
+    std::lock_guard<std::mutex> _(total_compilation_time_mut);
+    total_compilation_time += Time::get_time() - start_t;
+  }
   return ret;
 }
 
+std::vector<float64> Program::compile_kernels(
+    const std::vector<Kernel *> &kernels,
+    int num_threads) {
+  TI_AUTO_PROF
+  std::vector<float64> compile_times(kernels.size(), 0);
+  // Codegen uses per-thread LLVM contexts, so only the LLVM backends compile
+  // in parallel, as in async mode.
+  bool parallel = arch_is_cpu(config.arch) || config.arch == Arch::cuda;
+  if (num_threads <= 0)
+    num_threads = std::thread::hardware_concurrency();
+  auto compile_kernel = [&](int i) {
+    auto t = Time::get_time();
+    kernels[i]->compile(/*allow_fast_compile=*/false);
+    compile_times[i] = Time::get_time() - t;
+  };
+  if (!parallel || num_threads == 1) {
+    for (int i = 0; i < (int)kernels.size(); i++) {
+      if (!kernels[i]->compiled)
+        compile_kernel(i);
+    }
+    return compile_times;
+  }
+  ParallelExecutor workers(num_threads);
+  for (int i = 0; i < (int)kernels.size(); i++) {
+    if (!kernels[i]->compiled)
+      workers.enqueue([&compile_kernel, i]() { compile_kernel(i); });
+  }
+  workers.flush();
+  return compile_times;
+}
+
 FunctionType Program::compile_to_backend_executable(Kernel &kernel,
-                                                    OffloadedStmt *offloaded) {
+                                                    OffloadedStmt *offloaded,
+                                                    bool fast_compile) {
   if (arch_is_cpu(kernel.arch) || kernel.arch == Arch::cuda) {
     auto codegen = KernelCodeGen::create(kernel.arch, &kernel, offloaded);
+    codegen->fast_compile = fast_compile;
     return codegen->compile();
   } else if (kernel.arch == Arch::metal) {
     return metal::compile_to_metal_executable(&kernel, metal_kernel_mgr_.get(),
@@ -241,6 +288,143 @@ FunctionType Program::compile_to_backend_executable(Kernel &kernel,
   return nullptr;
 }
 
+void Program::delete_kernel(Kernel *kernel) {
+  TI_ERROR_IF(config.async_mode, "Kernels cannot be deleted in async mode");
+  // The kernel may still be running or being optimized
+  synchronize();
+  if (background_compilation_workers)
+    background_compilation_workers->flush();
+  auto it = std::find_if(
+      kernels.begin(), kernels.end(),
+      [&](const std::unique_ptr<Kernel> &k) { return k.get() == kernel; });
+  TI_ASSERT(it != kernels.end());
+  if (current_kernel == kernel)
+    current_kernel = nullptr;
+  kernels.erase(it);
+}
+
+void Program::optimize_in_background(Kernel *kernel) {
+  TI_ASSERT(kernel->lowered);
+  if (!background_compilation_workers) {
+    // Leave most of the threads to the kernels being launched meanwhile
+    background_compilation_workers = std::make_unique<ParallelExecutor>(
+        std::max(1, (int)std::thread::hardware_concurrency() / 4));
+  }
+  // Launches keep updating kernel->ir, e.g. the block_dim of struct-fors, so
+  // the background thread compiles a copy of its own. Owned by the task,
+  // which std::function requires to be copyable.
+  auto ir = irpass::analysis::clone(kernel->ir.get(), kernel).release();
+  background_compilation_workers->enqueue([kernel, ir]() {
+    TI_TRACE_SCOPE("optimize kernel");
+    std::unique_ptr<IRNode> func_ir(ir);
+    auto codegen = KernelCodeGen::create(kernel->arch, kernel, ir);
+    auto func = codegen->compile();
+    kernel->set_optimized(std::move(func), std::move(func_ir));
+  });
+}
+
+SNode *Program::add_snode_tree() {
+  TI_ERROR_IF(!arch_uses_llvm(config.arch),
+              "SNode trees other than ti.root are only supported on LLVM "
+              "backends");
+  // Kernels compiled with a destroyed tree would access the tree that takes
+  // its slot
+  std::unordered_set<int> referenced_slots;
+  for (auto &kernel : kernels) {
+    for (auto root : kernel->snode_tree_roots) {
+      if (!is_snode_tree_alive(root))
+        referenced_slots.insert(root->snode_tree_id);
+    }
+  }
+  // Slot 0 is ti.root
+  int snode_tree_id = 1;
+  while (snode_tree_id < (int)snode_trees.size() &&
+         (snode_trees[snode_tree_id] != nullptr ||
+          referenced_slots.count(snode_tree_id))) {
+    snode_tree_id++;
+  }
+  TI_ERROR_IF(snode_tree_id >= taichi_max_num_snode_trees,
+              "Too many SNode trees (at most {})", taichi_max_num_snode_trees);
+  if (snode_tree_id >= (int)snode_trees.size())
+    snode_trees.resize(snode_tree_id + 1);
+  auto root = std::make_unique<SNode>(0, SNodeType::root);
+  root->is_path_all_dense = true;
+  root->snode_tree_id = snode_tree_id;
+  snode_trees[snode_tree_id] = std::move(root);
+  return snode_trees[snode_tree_id].get();
+}
+
+void Program::materialize_snode_tree(SNode *root) {
+  TI_ERROR_IF(config.async_mode, "SNode trees cannot be added in async mode");
+  TI_ERROR_IF(llvm_runtime == nullptr,
+              "ti.root must be materialized before other SNode trees");
+  const int snode_tree_id = root->snode_tree_id;
+  TI_ASSERT(snode_tree_id > 0 && snode_tree_id < (int)snode_trees.size() &&
+            snode_trees[snode_tree_id].get() == root);
+  // Kernels may still be running, or being compiled with the current struct
+  // module
+  synchronize();
+  if (background_compilation_workers)
+    background_compilation_workers->flush();
+
+  // always use host_arch() this is for host accessors
+  std::unique_ptr<StructCompiler> scomp =
+      StructCompiler::make(this, host_arch());
+  scomp->run(*root, true);
+  for (auto snode : scomp->snodes) {
+    TI_ERROR_IF(snode->id >= taichi_max_num_snodes,
+                "Too many SNodes (at most {} over all SNode trees)",
+                taichi_max_num_snodes);
+    snodes[snode->id] = snode;
+  }
+
+  if (arch_is_cpu(config.arch)) {
+    initialize_snode_tree(scomp.get(), snode_tree_id);
+  } else {
+    TI_ASSERT(config.arch == Arch::cuda);
+    std::unique_ptr<StructCompiler> scomp_gpu =
+        StructCompiler::make(this, Arch::cuda);
+    scomp_gpu->run(*root, false);
+    initialize_snode_tree(scomp_gpu.get(), snode_tree_id);
+  }
+}
+
+void Program::destroy_snode_tree(SNode *root) {
+  const int snode_tree_id = root->snode_tree_id;
+  TI_ASSERT(snode_tree_id > 0 && snode_tree_id < (int)snode_trees.size() &&
+            snode_trees[snode_tree_id].get() == root);
+  synchronize();
+  if (background_compilation_workers)
+    background_compilation_workers->flush();
+
+  if (snodes.find(root->id) != snodes.end()) {
+    auto runtime = get_runtime_llvm_context()->runtime_jit_module;
+    std::function<void(SNode *)> release = [&](SNode *snode) {
+      for (auto &ch : snode->ch)
+        release(ch.get());
+      for (auto kernel : {snode->reader_kernel, snode->writer_kernel}) {
+        if (kernel != nullptr)
+          delete_kernel(kernel);
+      }
+      snode->reader_kernel = nullptr;
+      snode->writer_kernel = nullptr;
+      runtime->call<void *, int>("runtime_release_snode", llvm_runtime,
+                                 snode->id);
+      snodes.erase(snode->id);
+    };
+    release(root);
+    runtime->call<void *, int>("runtime_release_snode_tree", llvm_runtime,
+                               snode_tree_id);
+  }
+  destroyed_snode_trees.push_back(std::move(snode_trees[snode_tree_id]));
+}
+
+bool Program::is_snode_tree_alive(SNode *root) const {
+  const int snode_tree_id = root->snode_tree_id;
+  return snode_tree_id < (int)snode_trees.size() &&
+         snode_trees[snode_tree_id].get() == root;
+}
+
 // For CPU and CUDA archs only
 void Program::initialize_runtime_system(StructCompiler *scomp) {
   // auto tlctx = llvm_context_host.get();
@@ -278,11 +462,6 @@ void Program::initialize_runtime_system(StructCompiler *scomp) {
   }
   auto runtime = tlctx->runtime_jit_module;
 
-  // By the time this creator is called, "this" is already destroyed.
-  // Therefore it is necessary to capture members by values.
-  auto snodes = scomp->snodes;
-  int root_id = snode_root->id;
-
   // A buffer of random states, one per CUDA thread
   int num_rand_states = 0;
 
@@ -296,15 +475,13 @@ void Program::initialize_runtime_system(StructCompiler *scomp) {
 #endif
   }
 
-  TI_TRACE("Allocating data structure of size {} B", scomp->root_size);
   TI_TRACE("Allocating {} random states (used by CUDA only)", num_rand_states);
 
-  runtime->call<void *, void *, std::size_t, std::size_t, void *, int, void *,
-                void *, void *>("runtime_initialize", result_buffer, this,
-                                (std::size_t)scomp->root_size, prealloc_size,
-                                preallocated_device_buffer, num_rand_states,
-                                (void *)&taichi_allocate_aligned,
-                                (void *)std::printf, (void *)std::vsnprintf);
+  runtime->call<void *, void *, std::size_t, void *, int, void *, void *,
+                void *>("runtime_initialize", result_buffer, this,
+                        prealloc_size, preallocated_device_buffer,
+                        num_rand_states, (void *)&taichi_allocate_aligned,
+                        (void *)std::printf, (void *)std::vsnprintf);
 
   TI_TRACE("LLVMRuntime initialized");
   llvm_runtime = fetch_result<void *>(taichi_result_buffer_ret_value_id);
@@ -317,32 +494,7 @@ void Program::initialize_runtime_system(StructCompiler *scomp) {
     memory_pool->set_queue((MemRequestQueue *)mem_req_queue);
   }
 
-  runtime->call<void *, int, int>("runtime_initialize2", llvm_runtime, root_id,
-                                  (int)snodes.size());
-
-  for (int i = 0; i < (int)snodes.size(); i++) {
-    if (is_gc_able(snodes[i]->type)) {
-      std::size_t node_size;
-      auto element_size =
-          tlctx->get_type_size(StructCompilerLLVM::get_llvm_element_type(
-              tlctx->get_this_thread_struct_module(), snodes[i]));
-      if (snodes[i]->type == SNodeType::pointer) {
-        // pointer. Allocators are for single elements
-        node_size = element_size;
-      } else {
-        // dynamic. Allocators are for the chunks
-        node_size = sizeof(void *) + element_size * snodes[i]->chunk_size;
-      }
-      TI_TRACE("Initializing allocator for snode {} (node size {})",
-               snodes[i]->id, node_size);
-      auto rt = llvm_runtime;
-      runtime->call<void *, int, std::size_t>(
-          "runtime_NodeAllocator_initialize", rt, i, node_size);
-      TI_TRACE("Allocating ambient element for snode {} (node size {})",
-               snodes[i]->id, node_size);
-      runtime->call<void *, int>("runtime_allocate_ambient", rt, i, node_size);
-    }
-  }
+  llvm_runtime_layout = initialize_snode_tree(scomp, /*snode_tree_id=*/0);
 
   if (arch_use_host_memory(config.arch)) {
     runtime->call<void *, void *, void *>("LLVMRuntime_initialize_thread_pool",
@@ -351,8 +503,13 @@ void Program::initialize_runtime_system(StructCompiler *scomp) {
 
     runtime->call<void *, void *>("LLVMRuntime_set_assert_failed", llvm_runtime,
                                   (void *)assert_failed_host);
+
+    runtime->call<void *, void *>("LLVMRuntime_set_memory_release",
+                                  llvm_runtime, (void *)&taichi_release_memory);
   }
   if (arch_is_cpu(config.arch)) {
+    runtime->call<void *, void *>("LLVMRuntime_set_cpu_thread_id", llvm_runtime,
+                                  (void *)&ThreadPool::get_current_worker_id);
     // Profiler functions can only be called on CPU kernels
     runtime->call<void *, void *>("LLVMRuntime_set_profiler", llvm_runtime,
                                   profiler.get());
@@ -364,7 +521,89 @@ void Program::initialize_runtime_system(StructCompiler *scomp) {
   }
 }
 
+TaichiLLVMContext *Program::get_runtime_llvm_context() {
+  // Without unified memory, the runtime lives in the device memory. Otherwise
+  // it is initialized by the host, which provides the memory allocator.
+  if (config.arch == Arch::cuda && !config.use_unified_memory) {
+    return llvm_context_device.get();
+  } else {
+    return llvm_context_host.get();
+  }
+}
+
+LLVMRuntimeSNodeLayout Program::initialize_snode_tree(StructCompiler *scomp,
+                                                      int snode_tree_id) {
+  auto tlctx = get_runtime_llvm_context();
+  auto runtime = tlctx->runtime_jit_module;
+  const auto &snodes = scomp->snodes;
+
+  LLVMRuntimeSNodeLayout layout;
+  layout.root_size = scomp->root_size;
+  layout.root_id = snodes[0]->id;
+
+  for (auto snode : snodes) {
+    // TODO: some SNodes do not actually need an element list.
+    layout.element_lists.push_back(
+        {snode->id,
+         snode->list_chunk_size != 0 ? snode->list_chunk_size : 1024 * 64});
+  }
+
+  for (auto snode : snodes) {
+    if (is_gc_able(snode->type)) {
+      std::size_t node_size;
+      auto element_size =
+          tlctx->get_type_size(StructCompilerLLVM::get_llvm_element_type(
+              tlctx->get_this_thread_struct_module(), snode));
+      if (snode->type == SNodeType::pointer) {
+        // pointer. Allocators are for single elements
+        node_size = element_size;
+      } else if (snode->chunk_directory) {
+        // dynamic with a chunk directory. Chunks carry no next pointer
+        node_size = element_size * snode->chunk_size;
+      } else {
+        // dynamic. Allocators are for the chunks
+        node_size = sizeof(void *) + element_size * snode->chunk_size;
+      }
+      // 16K elements per chunk, by default
+      int chunk_num_elements =
+          snode->list_chunk_size != 0 ? snode->list_chunk_size : 1024 * 16;
+      layout.node_allocators.push_back(
+          {snode->id, node_size, chunk_num_elements});
+    }
+  }
+
+  TI_TRACE("Allocating data structure of size {} B", layout.root_size);
+  for (auto &list : layout.element_lists) {
+    runtime->call<void *, int, int>("runtime_initialize_element_list",
+                                    llvm_runtime, list.snode_id,
+                                    list.chunk_size);
+  }
+
+  runtime->call<void *, std::size_t, int, int>(
+      "runtime_initialize_snode_tree", llvm_runtime, layout.root_size,
+      layout.root_id, snode_tree_id);
+
+  for (auto &allocator : layout.node_allocators) {
+    TI_TRACE("Initializing allocator for snode {} (node size {})",
+             allocator.snode_id, allocator.node_size);
+    auto rt = llvm_runtime;
+    runtime->call<void *, int, std::size_t, int, int>(
+        "runtime_NodeAllocator_initialize", rt, allocator.snode_id,
+        allocator.node_size, allocator.chunk_num_elements,
+        (int)config.gc_lazy_zero_fill);
+    TI_TRACE("Allocating ambient element for snode {} (node size {})",
+             allocator.snode_id, allocator.node_size);
+    runtime->call<void *, int>("runtime_allocate_ambient", rt,
+                               allocator.snode_id, allocator.node_size);
+  }
+  return layout;
+}
+
 void Program::materialize_layout() {
+  if (!config.layout_advice_file.empty()) {
+    LayoutAdvisor::apply(snode_root.get(), config.layout_advice_file);
+  }
+
   // always use host_arch() this is for host accessors
   std::unique_ptr<StructCompiler> scomp =
       StructCompiler::make(this, host_arch());
@@ -372,6 +611,9 @@ void Program::materialize_layout() {
 
   for (auto snode : scomp->snodes) {
     snodes[snode->id] = snode;
+    TI_ERROR_IF(snode->has_custom_layout() && !arch_uses_llvm(config.arch),
+                "Morton and tiled layouts are only supported on LLVM "
+                "backends");
   }
 
   if (arch_is_cpu(config.arch)) {
@@ -664,6 +906,8 @@ void Program::finalize() {
   if (async_engine)
     async_engine = nullptr;  // Finalize the async engine threads before
                              // anything else gets destoried.
+  // Wait for the kernels being optimized, which use the LLVM contexts
+  background_compilation_workers = nullptr;
   TI_TRACE("Program finalizing...");
   if (config.print_benchmark_stat) {
     const char *current_test = std::getenv("PYTEST_CURRENT_TEST");
@@ -789,6 +1033,13 @@ void Program::print_memory_profiler_info() {
               "  Allocated elements={:n}; free list length={:n}; recycled list "
               "length={:n}\n",
               free_list_used, free_list_len, recycled_list_len);
+
+          auto released_bytes = runtime_query<int64>(
+              "NodeManager_get_released_bytes", node_allocator);
+          if (released_bytes) {
+            fmt::print("  Released to OS at last compaction={:n} B\n",
+                       released_bytes);
+          }
         }
       }
     }
@@ -798,6 +1049,11 @@ void Program::print_memory_profiler_info() {
   };
 
   visit(snode_root.get(), 0);
+  for (auto &tree : snode_trees) {
+    // Skip the trees that are not materialized yet
+    if (tree && snodes.find(tree->id) != snodes.end())
+      visit(tree.get(), 0);
+  }
 
   auto total_requested_memory = runtime_query<std::size_t>(
       "LLVMRuntime_get_total_requested_memory", llvm_runtime);
@@ -805,16 +1061,24 @@ void Program::print_memory_profiler_info() {
   fmt::print(
       "Total requested dynamic memory (excluding alignment padding): {:n} B\n",
       total_requested_memory);
+
+  auto jit = get_llvm_context(config.arch)->jit.get();
+  fmt::print("JIT modules: {:n}; host memory for code and data: {:n} B\n",
+             jit->get_num_modules(), jit->get_memory_usage());
 }
 
 std::size_t Program::get_snode_num_dynamically_allocated(SNode *snode) {
   auto node_allocator = runtime_query<void *>("LLVMRuntime_get_node_allocators",
                                               llvm_runtime, snode->id);
-  auto data_list =
-      runtime_query<void *>("NodeManager_get_data_list", node_allocator);
+  return (std::size_t)runtime_query<int32>("NodeManager_get_max_num_in_use",
+                                           node_allocator);
+}
 
-  return (std::size_t)runtime_query<int32>("ListManager_get_num_elements",
-                                           data_list);
+std::size_t Program::get_snode_num_bytes_released(SNode *snode) {
+  auto node_allocator = runtime_query<void *>("LLVMRuntime_get_node_allocators",
+                                              llvm_runtime, snode->id);
+  return (std::size_t)runtime_query<int64>("NodeManager_get_released_bytes",
+                                           node_allocator);
 }
 
 Program::~Program() {
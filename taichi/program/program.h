@@ -18,6 +18,7 @@
 #include "taichi/backends/cc/cc_program.h"
 #include "taichi/program/kernel.h"
 #include "taichi/program/kernel_profiler.h"
+#include "taichi/program/layout_advisor.h"
 #include "taichi/program/context.h"
 #include "taichi/runtime/runtime.h"
 #include "taichi/backends/metal/struct_metal.h"
@@ -76,18 +77,48 @@ TI_FORCE_INLINE Program &get_current_program() {
 class StructCompiler;
 
 class AsyncEngine;
+class ParallelExecutor;
+
+// What the LLVM runtime needs to know about the materialized SNode tree.
+// Recorded so that AOT modules can replay the same initialization.
+struct LLVMRuntimeSNodeLayout {
+  struct ElementList {
+    int snode_id;
+    int chunk_size;
+  };
+
+  struct NodeAllocator {
+    int snode_id;
+    std::size_t node_size;
+    int chunk_num_elements;
+  };
+
+  std::size_t root_size{0};
+  int root_id{0};
+  std::vector<ElementList> element_lists;
+  std::vector<NodeAllocator> node_allocators;
+};
 
 class Program {
  public:
   using Kernel = taichi::lang::Kernel;
-  Kernel *current_kernel;
+  // The kernel being defined or lowered. Per thread, since kernels may be
+  // lowered on several threads at once (see compile_kernels).
+  static thread_local Kernel *current_kernel;
   std::unique_ptr<SNode> snode_root;  // pointer to the data structure.
+  // Roots of the SNode trees added by add_snode_tree(), indexed by tree id.
+  // Tree 0 is |snode_root|. Slots of destroyed trees are reused.
+  std::vector<std::unique_ptr<SNode>> snode_trees;
+  // Destroyed trees, still referenced by Python fields and kernel IR
+  std::vector<std::unique_ptr<SNode>> destroyed_snode_trees;
   void *llvm_runtime;
+  LLVMRuntimeSNodeLayout llvm_runtime_layout;
   CompileConfig config;
   std::unique_ptr<TaichiLLVMContext> llvm_context_host, llvm_context_device;
   bool sync;  // device/host synchronized?
   bool finalized;
   float64 total_compilation_time;
+  std::mutex total_compilation_time_mut;
   static std::atomic<int> num_instances;
   ThreadPool thread_pool;
   std::unique_ptr<MemoryPool> memory_pool;
@@ -97,11 +128,17 @@ class Program {
 
   std::unique_ptr<Runtime> runtime;
   std::unique_ptr<AsyncEngine> async_engine;
+  // Recompiles hot kernels with full optimization, see
+  // CompileConfig::tiered_compilation
+  std::unique_ptr<ParallelExecutor> background_compilation_workers;
 
   std::vector<std::unique_ptr<Kernel>> kernels;
 
   std::unique_ptr<KernelProfilerBase> profiler;
 
+  // See CompileConfig::layout_advisor
+  LayoutAdvisor layout_advisor;
+
   std::unordered_map<JITEvaluatorId, std::unique_ptr<Kernel>>
       jit_evaluator_cache;
   std::mutex jit_evaluator_cache_mut;
@@ -178,6 +215,10 @@ class Program {
     return *kernels.back();
   }
 
+  // Frees the IR and the compiled code of |kernel|, which must not be used
+  // afterwards
+  void delete_kernel(Kernel *kernel);
+
   void start_function_definition(Kernel *func) {
     current_kernel = func;
   }
@@ -187,16 +228,43 @@ class Program {
 
   // TODO: This function is doing two things: 1) compiling CHI IR, and 2)
   // offloading them to each backend. We should probably separate the logic?
-  FunctionType compile(Kernel &kernel);
+  FunctionType compile(Kernel &kernel, bool fast_compile = false);
 
   // Just does the per-backend executable compilation without kernel lowering.
   FunctionType compile_to_backend_executable(Kernel &kernel,
-                                             OffloadedStmt *stmt);
+                                             OffloadedStmt *stmt,
+                                             bool fast_compile = false);
+
+  // Compiles the lowered |kernel| with full optimization on a background
+  // thread, and hands the result over with Kernel::set_optimized.
+  void optimize_in_background(Kernel *kernel);
+
+  // Lowers and compiles |kernels| ahead of their first launch, on
+  // |num_threads| threads (0 for all hardware threads) when the arch supports
+  // it. Kernels already compiled are skipped. Returns the compile time of each
+  // kernel in seconds.
+  std::vector<float64> compile_kernels(const std::vector<Kernel *> &kernels,
+                                       int num_threads);
 
   void initialize_runtime_system(StructCompiler *scomp);
 
   void materialize_layout();
 
+  // Creates the root of a new SNode tree. Unlike ti.root, its fields can be
+  // placed after the layout has been materialized. LLVM backends only.
+  SNode *add_snode_tree();
+
+  // Compiles the tree of |root| and allocates its memory. Kernels compiled
+  // before remain valid.
+  void materialize_snode_tree(SNode *root);
+
+  // Frees the memory of the tree of |root|. Launching kernels that access its
+  // fields raises an error afterwards. The SNodes themselves are kept, and the
+  // slot of the tree is not reused while such kernels exist.
+  void destroy_snode_tree(SNode *root);
+
+  bool is_snode_tree_alive(SNode *root) const;
+
   void check_runtime_error();
 
   inline Kernel &get_current_kernel() {
@@ -230,6 +298,7 @@ class Program {
   Arch get_snode_accessor_arch();
 
   float64 get_total_compilation_time() {
+    std::lock_guard<std::mutex> _(total_compilation_time_mut);
     return total_compilation_time;
   }
 
@@ -271,9 +340,20 @@ class Program {
   // Returns zero if the SNode is statically allocated
   std::size_t get_snode_num_dynamically_allocated(SNode *snode);
 
+  // Bytes of fully free node chunks returned to the OS by the last compaction
+  // (see CompileConfig::compact_sparse_memory)
+  std::size_t get_snode_num_bytes_released(SNode *snode);
+
   ~Program();
 
  private:
+  // Allocates the root buffer of the tree compiled by |scomp|, and initializes
+  // the runtime lists of its SNodes
+  LLVMRuntimeSNodeLayout initialize_snode_tree(StructCompiler *scomp,
+                                               int snode_tree_id);
+
+  TaichiLLVMContext *get_runtime_llvm_context();
+
   // Metal related data structures
   std::optional<metal::CompiledStructs> metal_compiled_structs_;
   std::unique_ptr<metal::KernelManager> metal_kernel_mgr_;
@@ -245,6 +245,12 @@ bool StateFlowGraph::optimize_listgen() {
         auto node_b = listgens[j];
         TI_ASSERT(!node_b->executed());
 
+        // Lists restricted to a bounding box (see ti.bounded) differ from the
+        // full list even with the same mask and parent list
+        if (!node_a->rec.stmt()->bbox_indices.empty() ||
+            !node_b->rec.stmt()->bbox_indices.empty())
+          break;
+
         // Test if two list generations share the same mask and parent list
         auto snode = node_a->meta->snode;
 
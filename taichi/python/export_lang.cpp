@@ -4,10 +4,12 @@
 #include <string>
 
 #include "pybind11/functional.h"
+#include "pybind11/numpy.h"
 #include "pybind11/pybind11.h"
 
 #include "taichi/ir/frontend.h"
 #include "taichi/ir/frontend_ir.h"
+#include "taichi/ir/analysis.h"
 #include "taichi/ir/statements.h"
 #include "taichi/program/extension.h"
 #include "taichi/program/async_engine.h"
@@ -17,6 +19,7 @@
 #include "taichi/math/svd.h"
 #include "taichi/util/statistics.h"
 #include "taichi/util/action_recorder.h"
+#include "taichi/backends/cpu/aot_module_builder_cpu.h"
 
 #if defined(TI_WITH_CUDA)
 #include "taichi/backends/cuda/cuda_context.h"
@@ -132,6 +135,10 @@ void export_lang(py::module &m) {
       .def_readwrite("saturating_grid_dim", &CompileConfig::saturating_grid_dim)
       .def_readwrite("max_block_dim", &CompileConfig::max_block_dim)
       .def_readwrite("cpu_max_num_threads", &CompileConfig::cpu_max_num_threads)
+      .def_readwrite("cpu_parallel_gc", &CompileConfig::cpu_parallel_gc)
+      .def_readwrite("gc_lazy_zero_fill", &CompileConfig::gc_lazy_zero_fill)
+      .def_readwrite("compact_sparse_memory",
+                     &CompileConfig::compact_sparse_memory)
       .def_readwrite("verbose_kernel_launches",
                      &CompileConfig::verbose_kernel_launches)
       .def_readwrite("verbose", &CompileConfig::verbose)
@@ -139,6 +146,8 @@ void export_lang(py::module &m) {
                      &CompileConfig::demote_dense_struct_fors)
       .def_readwrite("use_unified_memory", &CompileConfig::use_unified_memory)
       .def_readwrite("kernel_profiler", &CompileConfig::kernel_profiler)
+      .def_readwrite("kernel_profiler_counters",
+                     &CompileConfig::kernel_profiler_counters)
       .def_readwrite("default_fp", &CompileConfig::default_fp)
       .def_readwrite("default_ip", &CompileConfig::default_ip)
       .def_readwrite("device_memory_GB", &CompileConfig::device_memory_GB)
@@ -150,8 +159,18 @@ void export_lang(py::module &m) {
       .def_readwrite("ad_stack_size", &CompileConfig::ad_stack_size)
       .def_readwrite("async_mode", &CompileConfig::async_mode)
       .def_readwrite("flatten_if", &CompileConfig::flatten_if)
+      .def_readwrite("tiered_compilation", &CompileConfig::tiered_compilation)
+      .def_readwrite("tiered_compilation_threshold",
+                     &CompileConfig::tiered_compilation_threshold)
+      .def_readwrite("max_num_kernels", &CompileConfig::max_num_kernels)
+      .def_readwrite("layout_advisor", &CompileConfig::layout_advisor)
+      .def_readwrite("layout_advice_file", &CompileConfig::layout_advice_file)
       .def_readwrite("make_thread_local", &CompileConfig::make_thread_local)
       .def_readwrite("make_block_local", &CompileConfig::make_block_local)
+      .def_readwrite("reuse_neighbor_lookups",
+                     &CompileConfig::reuse_neighbor_lookups)
+      .def_readwrite("strength_reduce_indices",
+                     &CompileConfig::strength_reduce_indices)
       .def_readwrite("cc_compile_cmd", &CompileConfig::cc_compile_cmd)
       .def_readwrite("cc_link_cmd", &CompileConfig::cc_link_cmd)
       .def_readwrite("async_opt_fusion", &CompileConfig::async_opt_fusion)
@@ -176,18 +195,70 @@ void export_lang(py::module &m) {
       .def("kernel_profiler_total_time",
            [](Program *program) { return program->profiler->get_total_time(); })
       .def("kernel_profiler_clear", &Program::kernel_profiler_clear)
+      .def("kernel_profiler_dump",
+           [](Program *program, const std::string &filename) {
+             program->profiler->dump_json(filename);
+           })
       .def("print_memory_profiler_info", &Program::print_memory_profiler_info)
+      .def("print_layout_advice",
+           [](Program *program) {
+             program->layout_advisor.print_report(program->snode_root.get());
+           })
+      .def("save_layout_advice",
+           [](Program *program, const std::string &filename) {
+             program->layout_advisor.save(program->snode_root.get(), filename);
+           })
+      // Returns the current and the proposed groups of place SNodes, and the
+      // estimated bytes moved by the recorded launches under each
+      .def("get_layout_advice",
+           [](Program *program) {
+             auto advice =
+                 program->layout_advisor.get_advice(program->snode_root.get());
+             return std::make_tuple(advice.current, advice.proposed,
+                                    advice.current_bytes,
+                                    advice.proposed_bytes);
+           },
+           py::return_value_policy::reference)
+      .def("clear_layout_advisor",
+           [](Program *program) { program->layout_advisor.clear(); })
+      .def("delete_kernel", &Program::delete_kernel)
       .def("finalize", &Program::finalize)
       .def("get_root",
            [&](Program *program) -> SNode * {
              return program->snode_root.get();
            },
            py::return_value_policy::reference)
+      .def("add_snode_tree", &Program::add_snode_tree,
+           py::return_value_policy::reference)
+      .def("materialize_snode_tree", &Program::materialize_snode_tree)
+      .def("destroy_snode_tree", &Program::destroy_snode_tree)
       .def("get_total_compilation_time", &Program::get_total_compilation_time)
       .def("print_snode_tree", &Program::print_snode_tree)
       .def("get_snode_num_dynamically_allocated",
            &Program::get_snode_num_dynamically_allocated)
-      .def("synchronize", &Program::synchronize);
+      .def("get_snode_num_bytes_released",
+           &Program::get_snode_num_bytes_released)
+      .def("synchronize", &Program::synchronize)
+      // Compiles |kernels|, or all kernels registered in the program if it is
+      // empty. Returns (kernel name, compile time in seconds) pairs.
+      .def("compile_kernels",
+           [](Program *program, std::vector<Kernel *> kernels,
+              int num_threads) {
+             if (kernels.empty()) {
+               for (auto &kernel : program->kernels)
+                 kernels.push_back(kernel.get());
+             }
+             std::vector<float64> compile_times;
+             {
+               py::gil_scoped_release release;
+               compile_times = program->compile_kernels(kernels, num_threads);
+             }
+             std::vector<std::pair<std::string, float64>> ret;
+             for (int i = 0; i < (int)kernels.size(); i++) {
+               ret.emplace_back(kernels[i]->name, compile_times[i]);
+             }
+             return ret;
+           });
 
   m.def("get_current_program", get_current_program,
         py::return_value_policy::reference);
@@ -200,7 +271,9 @@ void export_lang(py::module &m) {
   py::class_<SNode>(m, "SNode")
       .def(py::init<>())
       .def_readwrite("parent", &SNode::parent)
+      .def_readonly("id", &SNode::id)
       .def_readonly("type", &SNode::type)
+      .def_readonly("snode_tree_id", &SNode::snode_tree_id)
       .def("dense",
            (SNode & (SNode::*)(const std::vector<Index> &,
                                const std::vector<int> &))(&SNode::dense),
@@ -228,6 +301,10 @@ void export_lang(py::module &m) {
            [](SNode *snode, int i) -> SNode * { return snode->ch[i].get(); },
            py::return_value_policy::reference)
       .def("lazy_grad", &SNode::lazy_grad)
+      .def("set_list_chunk_size", &SNode::set_list_chunk_size,
+           py::return_value_policy::reference)
+      .def("morton", &SNode::morton, py::return_value_policy::reference)
+      .def("tile", &SNode::tile, py::return_value_policy::reference)
       .def("read_int", &SNode::read_int)
       .def("read_uint", &SNode::read_uint)
       .def("read_float", &SNode::read_float)
@@ -250,11 +327,51 @@ void export_lang(py::module &m) {
   py::class_<Kernel>(m, "Kernel")
       .def("get_ret_int", &Kernel::get_ret_int)
       .def("get_ret_float", &Kernel::get_ret_float)
+      .def_readonly("written_snode_ids", &Kernel::written_snode_ids)
+      .def_readonly("fully_optimized", &Kernel::fully_optimized)
       .def("make_launch_context", &Kernel::make_launch_context)
       .def("__call__",
            [](Kernel *kernel, Kernel::LaunchContextBuilder &launch_ctx) {
              py::gil_scoped_release release;
              kernel->operator()(launch_ctx);
+           })
+      // Fast launch path: packs all (non-template) arguments in a single call
+      // and launches the kernel. Returns false without launching if some
+      // argument needs the slower Python path, e.g. torch tensors or
+      // non-contiguous arrays.
+      .def("launch",
+           [](Kernel *kernel, const py::tuple &args) {
+             TI_ASSERT(args.size() == kernel->args.size());
+             auto launch_ctx = kernel->make_launch_context();
+             for (int i = 0; i < (int)args.size(); i++) {
+               const auto &arg = kernel->args[i];
+               py::handle v = args[i];
+               if (arg.is_nparray) {
+                 if (!py::isinstance<py::array>(v))
+                   return false;
+                 auto array = py::reinterpret_borrow<py::array>(v);
+                 if (!(array.flags() & py::array::c_style) ||
+                     array.ndim() > taichi_max_num_indices)
+                   return false;
+                 launch_ctx.set_arg_nparray(i, (uint64)array.data(),
+                                            (uint64)array.nbytes());
+                 for (int j = 0; j < (int)array.ndim(); j++) {
+                   launch_ctx.set_extra_arg_int(i, j, (int32)array.shape(j));
+                 }
+               } else if (is_real(arg.dt)) {
+                 if (!py::isinstance<py::float_>(v) &&
+                     !py::isinstance<py::int_>(v))
+                   return false;
+                 launch_ctx.set_arg_float(i, v.cast<float64>());
+               } else {
+                 if (!py::isinstance<py::int_>(v))
+                   return false;
+                 launch_ctx.set_arg_int(i, v.cast<int64>());
+               }
+             }
+             py::gil_scoped_release release;
+             kernel->operator()(launch_ctx);
+             return true;
            });
 
   py::class_<Kernel::LaunchContextBuilder>(m, "KernelLaunchContext")
@@ -264,6 +381,14 @@ void export_lang(py::module &m) {
       .def("set_extra_arg_int",
            &Kernel::LaunchContextBuilder::set_extra_arg_int);
 
+  py::class_<AotModuleBuilderCPU>(m, "AotModuleBuilderCPU")
+      .def("add", &AotModuleBuilderCPU::add)
+      .def("dump", &AotModuleBuilderCPU::dump);
+
+  m.def("make_aot_module_builder_cpu", []() {
+    return std::make_unique<AotModuleBuilderCPU>(&get_current_program());
+  });
+
   py::class_<Expr> expr(m, "Expr");
   expr.def("serialize", &Expr::serialize)
       .def("snode", &Expr::snode, py::return_value_policy::reference)
@@ -360,6 +485,17 @@ void export_lang(py::module &m) {
           scope_stack.push_back(current_ast_builder().create_scope(stmt->body));
         });
 
+  m.def("begin_frontend_bounded_struct_for",
+        [&](const ExprGroup &indices, const Expr &global,
+            const ExprGroup &lower, const ExprGroup &upper) {
+          auto stmt_unique = std::make_unique<FrontendForStmt>(indices, global);
+          auto stmt = stmt_unique.get();
+          stmt->bbox_lower = lower.exprs;
+          stmt->bbox_upper = upper.exprs;
+          current_ast_builder().insert(std::move(stmt_unique));
+          scope_stack.push_back(current_ast_builder().create_scope(stmt->body));
+        });
+
   m.def("end_frontend_range_for", [&]() { scope_stack.pop_back(); });
   m.def("pop_scope", [&]() { scope_stack.pop_back(); });
 
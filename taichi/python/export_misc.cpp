@@ -15,6 +15,7 @@
 #include "taichi/system/dynamic_loader.h"
 #include "taichi/system/memory_usage_monitor.h"
 #include "taichi/system/profiler.h"
+#include "taichi/system/tracer.h"
 #include "taichi/util/statistics.h"
 #if defined(TI_WITH_CUDA)
 #include "taichi/backends/cuda/cuda_driver.h"
@@ -149,6 +150,10 @@ void export_misc(py::module &m) {
   });
   m.def("print_profile_info",
         [&]() { Profiling::get_instance().print_profile_info(); });
+  m.def("enable_tracer", Tracer::enable);
+  m.def("disable_tracer", Tracer::disable);
+  m.def("clear_tracer", Tracer::clear);
+  m.def("export_chrome_trace", Tracer::export_chrome_trace);
   m.def("start_memory_monitoring", start_memory_monitoring);
   m.def("absolute_path", absolute_path);
   m.def("get_repo_dir", get_repo_dir);
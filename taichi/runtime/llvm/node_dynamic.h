@@ -116,3 +116,103 @@ i32 Dynamic_get_num_elements(Ptr meta_, Ptr node_) {
   auto node = (DynamicNode *)(node_);
   return node->n;
 }
+
+// A dynamic node with an inline chunk directory. Chunk k holds elements
+// [k * chunk_size, (k + 1) * chunk_size), so that lookup and append take O(1)
+// instead of walking a linked list of chunks. Chunks are allocated from the
+// same NodeManager as the plain dynamic nodes, without the next pointer.
+struct DynamicDirectoryNode {
+  i32 lock;
+  i32 n;
+  // Chunks [0, num_chunks) are allocated. Only grows while holding |lock|.
+  i32 num_chunks;
+  Ptr chunks[1];  // The actual length is ceil(max_num_elements / chunk_size)
+};
+
+Ptr *DynamicDirectory_get_chunk_slot(DynamicMeta *meta,
+                                     DynamicDirectoryNode *node,
+                                     int i) {
+  return &node->chunks[i / meta->chunk_size];
+}
+
+// As in Dynamic_activate, every chunk up to the one containing element i is
+// allocated, since all elements below n are active. Chunks below
+// |num_chunks| are skipped, so that growing a node by one element takes
+// amortized constant time.
+void DynamicDirectory_allocate_chunks(DynamicMeta *meta,
+                                      DynamicDirectoryNode *node,
+                                      int i) {
+  auto num_chunks = i / meta->chunk_size + 1;
+  if (node->num_chunks >= num_chunks)
+    return;
+  locked_task(
+      Ptr(&node->lock),
+      [&] {
+        auto rt = meta->context->runtime;
+        auto alloc = rt->node_allocators[meta->snode_id];
+        for (int k = node->num_chunks; k < num_chunks; k++) {
+          auto chunk_ptr = alloc->allocate();
+          grid_memfence();
+          atomic_exchange_u64((u64 *)&node->chunks[k], (u64)chunk_ptr);
+        }
+        grid_memfence();
+        atomic_max_i32(&node->num_chunks, num_chunks);
+      },
+      [&]() { return node->num_chunks < num_chunks; });
+}
+
+void DynamicDirectory_activate(Ptr meta_, Ptr node_, int i) {
+  auto meta = (DynamicMeta *)(meta_);
+  auto node = (DynamicDirectoryNode *)(node_);
+  atomic_max_i32(&node->n, i + 1);
+  DynamicDirectory_allocate_chunks(meta, node, i);
+}
+
+void DynamicDirectory_deactivate(Ptr meta_, Ptr node_) {
+  auto meta = (DynamicMeta *)(meta_);
+  auto node = (DynamicDirectoryNode *)(node_);
+  if (node->n > 0) {
+    locked_task(Ptr(&node->lock), [&] {
+      auto rt = meta->context->runtime;
+      auto alloc = rt->node_allocators[meta->snode_id];
+      for (int k = 0; k < node->num_chunks; k++) {
+        alloc->recycle(node->chunks[k]);
+        node->chunks[k] = nullptr;
+      }
+      node->num_chunks = 0;
+      node->n = 0;
+    });
+  }
+}
+
+i32 DynamicDirectory_append(Ptr meta_, Ptr node_, i32 data) {
+  auto meta = (DynamicMeta *)(meta_);
+  auto node = (DynamicDirectoryNode *)(node_);
+  auto i = atomic_add_i32(&node->n, 1);
+  DynamicDirectory_allocate_chunks(meta, node, i);
+  auto chunk_ptr = *DynamicDirectory_get_chunk_slot(meta, node, i);
+  *(i32 *)(chunk_ptr + (i % meta->chunk_size) * meta->element_size) = data;
+  return i;
+}
+
+i32 DynamicDirectory_is_active(Ptr meta_, Ptr node_, int i) {
+  auto node = (DynamicDirectoryNode *)(node_);
+  return i32(i < node->n);
+}
+
+Ptr DynamicDirectory_lookup_element(Ptr meta_, Ptr node_, int i) {
+  auto meta = (DynamicMeta *)(meta_);
+  auto node = (DynamicDirectoryNode *)(node_);
+  if (DynamicDirectory_is_active(meta_, node_, i)) {
+    auto chunk_ptr = *DynamicDirectory_get_chunk_slot(meta, node, i);
+    if (chunk_ptr != nullptr) {
+      return chunk_ptr + (i % meta->chunk_size) * meta->element_size;
+    }
+  }
+  return (meta->context->runtime)->ambient_elements[meta->snode_id];
+}
+
+i32 DynamicDirectory_get_num_elements(Ptr meta_, Ptr node_) {
+  auto node = (DynamicDirectoryNode *)(node_);
+  return node->n;
+}
@@ -44,6 +44,7 @@ void Pointer_activate(Ptr meta_, Ptr node, int i) {
   volatile Ptr lock = node + 8 * i;
   volatile Ptr *data_ptr = (Ptr *)(node + 8 * (num_elements + i));
 
+#if defined(ARCH_cuda)
   if (*data_ptr == nullptr) {
     // The cuda_ calls will return 0 or do noop on CPUs
     u32 mask = cuda_active_mask();
@@ -61,6 +62,36 @@ void Pointer_activate(Ptr meta_, Ptr node, int i) {
     }
     warp_barrier(mask);
   }
+#else
+  // On CPUs, optimistically allocate the child and publish it with a CAS, so
+  // that threads activating the same cell do not spin on its lock. The loser
+  // keeps its node as a spare for its next activation. Threads outside the
+  // pool have no spare slot and take the lock instead, still publishing with
+  // a CAS since they may race with threads of the pool.
+  if (*data_ptr == nullptr) {
+    auto rt = meta->context->runtime;
+    auto alloc = rt->node_allocators[meta->snode_id];
+    auto slot = alloc->get_thread_slot();
+    if (slot == -1) {
+      locked_task(lock,
+                  [&] {
+                    auto allocated = alloc->allocate();
+                    if (!atomic_compare_exchange_u64((u64 *)data_ptr, 0,
+                                                     (u64)allocated)) {
+                      alloc->recycle(allocated);
+                    }
+                  },
+                  [&]() { return *data_ptr == nullptr; });
+      return;
+    }
+    auto allocated = alloc->allocate_cached(slot);
+    if (atomic_compare_exchange_u64((u64 *)data_ptr, 0, (u64)allocated)) {
+      alloc->mark_in_use();
+    } else {
+      alloc->release_cached(slot, allocated);
+    }
+  }
+#endif
 }
 
 void Pointer_deactivate(Ptr meta, Ptr node, int i) {
@@ -23,7 +23,14 @@ using host_vsnprintf_type = int (*)(char *,
                                     const char *,
                                     std::va_list);
 using vm_allocator_type = void *(*)(void *, std::size_t, std::size_t);
+using memory_release_type = std::size_t (*)(void *, void *, std::size_t);
+using cpu_thread_id_type = int (*)();
 using RangeForTaskFunc = void(Context *, const char *tls, int i);
+// Runs the iterations in [begin, end) of a CPU range-for
+using RangeForBlockTaskFunc = void(Context *,
+                                   const char *tls,
+                                   int begin,
+                                   int end);
 using parallel_for_type = void (*)(void *thread_pool,
                                    int splits,
                                    int num_desired_threads,
@@ -369,6 +376,7 @@ constexpr bool enable_assert = true;
 
 void taichi_assert(Context *context, i32 test, const char *msg);
 void taichi_assert_runtime(LLVMRuntime *runtime, i32 test, const char *msg);
+void grid_memfence();
 #define TI_ASSERT_INFO(x, msg) taichi_assert(context, (int)(x), msg)
 #define TI_ASSERT(x) TI_ASSERT_INFO(x, #x)
 
@@ -387,17 +395,70 @@ bool is_power_of_two(uint32 x) {
 /*
 A simple list data structure that is infinitely long.
 Data are organized in chunks, where each chunk is allocated on demand.
+
+The first max_num_chunks chunk pointers are stored inline, so that the common
+case of get_element_ptr takes a single load. Chunks beyond that are indexed
+through a two-level directory, whose blocks are also allocated on demand.
+*/
+
+/*
+Maps addresses back to the chunks of a ListManager, for ptr2index.
+Addresses are grouped into buckets of at least the size of a chunk, so that
+each chunk overlaps at most two buckets. The buckets of all chunks are kept in
+an open-addressing hash table, which is only written while the list holds its
+lock. Once half full, it is replaced by a table twice as large. Replaced
+tables are never freed, so that readers never need the lock.
 */
+struct ListChunkIndex {
+  i32 log2capacity;
+  i32 num_entries;
+  // Bucket id + 1 of each entry, or 0 for empty entries
+  u64 *buckets;
+  i32 *chunk_ids;
+  // The index replaced by this one. Readers may still be using it, so it is
+  // only released with the list.
+  ListChunkIndex *previous;
+
+  i32 capacity() const {
+    return 1 << log2capacity;
+  }
+
+  i32 hash(u64 bucket) const {
+    return i32((bucket * 0x9E3779B97F4A7C15ULL) >> (64 - log2capacity));
+  }
+
+  void insert(u64 bucket, i32 chunk_id) {
+    auto i = hash(bucket);
+    while (buckets[i] != 0) {
+      i = (i + 1) & (capacity() - 1);
+    }
+    chunk_ids[i] = chunk_id;
+    grid_memfence();
+    buckets[i] = bucket + 1;
+    num_entries++;
+  }
+};
 
 struct ListManager {
   static constexpr std::size_t max_num_chunks = 1024;
+  static constexpr std::size_t log2directory_size = 10;
+  static constexpr std::size_t directory_size = 1 << log2directory_size;
+  static constexpr std::size_t max_num_directories = 1024;
+  static constexpr std::size_t max_num_total_chunks =
+      max_num_chunks + directory_size * max_num_directories;
   Ptr chunks[max_num_chunks];
+  Ptr *directories[max_num_directories];
   std::size_t element_size{0};
   std::size_t max_num_elements_per_chunk;
   i32 log2chunk_num_elements;
   i32 lock;
   i32 num_elements;
   LLVMRuntime *runtime;
+  // Only maintained with |use_chunk_index|, which is set on the lists that
+  // need ptr2index(). Allocated with the first chunk.
+  i32 use_chunk_index;
+  ListChunkIndex *chunk_index;
+  i32 log2index_bucket_size;
 
   ListManager(LLVMRuntime *runtime,
               std::size_t element_size,
@@ -410,6 +471,16 @@ struct ListManager {
     lock = 0;
     num_elements = 0;
     log2chunk_num_elements = taichi::log2int(num_elements_per_chunk);
+    use_chunk_index = 0;
+    chunk_index = nullptr;
+    log2index_bucket_size = 0;
+    while (((std::size_t)1 << log2index_bucket_size) < get_chunk_size()) {
+      log2index_bucket_size++;
+    }
+  }
+
+  std::size_t get_chunk_size() const {
+    return max_num_elements_per_chunk * element_size;
   }
 
   void append(void *data_ptr);
@@ -430,11 +501,37 @@ struct ListManager {
 
   void touch_chunk(int chunk_id);
 
+  // Must be called with |lock| held, before |chunk| is published.
+  void add_to_chunk_index(i32 chunk_id, Ptr chunk);
+
+  // Returns the address of the pointer to the chunk, allocating the
+  // corresponding directory block if necessary.
+  Ptr *get_chunk_slot(i32 chunk_id);
+
+  Ptr get_chunk(i32 chunk_id) {
+    if (chunk_id < (i32)max_num_chunks) {
+      return chunks[chunk_id];
+    }
+    auto overflow_id = chunk_id - (i32)max_num_chunks;
+    auto directory = directories[overflow_id >> log2directory_size];
+    if (directory == nullptr) {
+      return nullptr;
+    }
+    return directory[overflow_id & (directory_size - 1)];
+  }
+
   i32 get_num_active_chunks() {
     i32 counter = 0;
-    for (int i = 0; i < max_num_chunks; i++) {
+    for (std::size_t i = 0; i < max_num_chunks; i++) {
       counter += (chunks[i] != nullptr);
     }
+    for (std::size_t d = 0; d < max_num_directories; d++) {
+      if (directories[d] == nullptr)
+        break;
+      for (std::size_t i = 0; i < directory_size; i++) {
+        counter += (directories[d][i] != nullptr);
+      }
+    }
     return counter;
   }
 
@@ -442,13 +539,21 @@ struct ListManager {
     num_elements = 0;
   }
 
+  // Returns the pages of all chunks, of the chunk indices and of the list
+  // itself to the OS. The list must not be used afterwards.
+  void release();
+
   void resize(i32 n) {
     num_elements = n;
   }
 
   Ptr get_element_ptr(i32 i) {
-    return chunks[i >> log2chunk_num_elements] +
-           element_size * (i & ((1 << log2chunk_num_elements) - 1));
+    auto chunk_id = i >> log2chunk_num_elements;
+    auto offset = element_size * (i & ((1 << log2chunk_num_elements) - 1));
+    if (chunk_id < (i32)max_num_chunks) {
+      return chunks[chunk_id] + offset;
+    }
+    return get_chunk(chunk_id) + offset;
   }
 
   template <typename T>
@@ -466,14 +571,24 @@ struct ListManager {
   }
 
   i32 ptr2index(Ptr ptr) {
-    auto chunk_size = max_num_elements_per_chunk * element_size;
-    for (int i = 0; i < max_num_chunks; i++) {
-      taichi_assert_runtime(runtime, chunks[i] != nullptr, "ptr not found.");
-      if (chunks[i] <= ptr && ptr < chunks[i] + chunk_size) {
-        return (i << log2chunk_num_elements) +
-               i32((ptr - chunks[i]) / element_size);
+    auto index = chunk_index;
+    auto bucket = (u64)ptr >> log2index_bucket_size;
+    if (index != nullptr) {
+      for (auto i = index->hash(bucket); index->buckets[i] != 0;
+           i = (i + 1) & (index->capacity() - 1)) {
+        if (index->buckets[i] != bucket + 1)
+          continue;
+        auto chunk_id = index->chunk_ids[i];
+        // Null if the chunk is being allocated
+        auto chunk = get_chunk(chunk_id);
+        if (chunk != nullptr && chunk <= ptr &&
+            ptr < chunk + get_chunk_size()) {
+          return (chunk_id << log2chunk_num_elements) +
+                 i32((ptr - chunk) / element_size);
+        }
       }
     }
+    taichi_assert_runtime(runtime, false, "ptr not found.");
     return -1;
   }
 };
@@ -517,12 +632,19 @@ struct LLVMRuntime {
   Ptr preallocated_tail;
 
   vm_allocator_type vm_allocator;
+  // Returns pages back to the OS. Only available when the runtime memory
+  // lives on the host.
+  memory_release_type memory_release;
+  // Returns the index of the calling CPU worker thread, or -1 outside of the
+  // thread pool. Only available on CPUs.
+  cpu_thread_id_type cpu_thread_id;
   assert_failed_type assert_failed;
   host_printf_type host_printf;
   host_vsnprintf_type host_vsnprintf;
   Ptr prog;
-  Ptr root;
-  size_t root_mem_size;
+  // Root buffers of the SNode trees, indexed by tree id
+  Ptr roots[taichi_max_num_snode_trees];
+  size_t root_mem_sizes[taichi_max_num_snode_trees];
   Ptr thread_pool;
   parallel_for_type parallel_for;
   ListManager *element_lists[taichi_max_num_snodes];
@@ -569,10 +691,12 @@ struct LLVMRuntime {
 // TODO: are these necessary?
 STRUCT_FIELD_ARRAY(LLVMRuntime, element_lists);
 STRUCT_FIELD_ARRAY(LLVMRuntime, node_allocators);
-STRUCT_FIELD(LLVMRuntime, root);
-STRUCT_FIELD(LLVMRuntime, root_mem_size);
+STRUCT_FIELD_ARRAY(LLVMRuntime, roots);
+STRUCT_FIELD_ARRAY(LLVMRuntime, root_mem_sizes);
 STRUCT_FIELD(LLVMRuntime, temporaries);
 STRUCT_FIELD(LLVMRuntime, assert_failed);
+STRUCT_FIELD(LLVMRuntime, memory_release);
+STRUCT_FIELD(LLVMRuntime, cpu_thread_id);
 STRUCT_FIELD(LLVMRuntime, host_printf);
 STRUCT_FIELD(LLVMRuntime, host_vsnprintf);
 STRUCT_FIELD(LLVMRuntime, profiler);
@@ -592,12 +716,36 @@ struct NodeManager {
   ListManager *free_list, *recycled_list, *data_list;
   i32 recycle_list_size_backup;
 
+  // When set, recycled nodes are zero-filled upon reallocation instead of
+  // during GC, which spreads the memset cost over subsequent activations.
+  i32 lazy_zero_fill;
+
+  // Scratch space of compact(): number of free elements in each data chunk
+  ListManager *chunk_free_counts;
+  // Bytes of fully free data chunks returned to the OS by the last compact()
+  i64 released_bytes;
+
+  // One spare node per CPU thread of the pool, holding nodes allocated by
+  // activations that lost the race to publish them.
+  static constexpr int max_num_thread_slots = 256;
+  Ptr thread_cache[max_num_thread_slots];
+
+  // Number of nodes handed out and not yet returned to the free list by GC,
+  // and its high watermark, which is reported as the number of allocated
+  // nodes. Spare nodes are not counted, so that the watermark does not depend
+  // on the races lost by activations.
+  i32 num_in_use;
+  i32 max_num_in_use;
+
   using list_data_type = i32;
 
   NodeManager(LLVMRuntime *runtime,
               i32 element_size,
-              i32 chunk_num_elements = -1)
-      : runtime(runtime), element_size(element_size) {
+              i32 chunk_num_elements = -1,
+              i32 lazy_zero_fill = 0)
+      : runtime(runtime),
+        element_size(element_size),
+        lazy_zero_fill(lazy_zero_fill) {
     // 16K elements per chunk, by default
     if (chunk_num_elements == -1) {
       chunk_num_elements = 16 * 1024;
@@ -615,9 +763,76 @@ struct NodeManager {
         runtime, sizeof(list_data_type), chunk_num_elements);
     data_list =
         runtime->create<ListManager>(runtime, element_size, chunk_num_elements);
+    // Recycled nodes are located by address
+    data_list->use_chunk_index = 1;
+    chunk_free_counts =
+        runtime->create<ListManager>(runtime, sizeof(i32), 1024);
+    released_bytes = 0;
+    for (int i = 0; i < max_num_thread_slots; i++) {
+      thread_cache[i] = nullptr;
+    }
+    num_in_use = 0;
+    max_num_in_use = 0;
+  }
+
+  // Returns the cache slot of the calling CPU thread, or -1 if it is not a
+  // thread of the pool. Slots are never shared between threads.
+  i32 get_thread_slot() {
+    if (runtime->cpu_thread_id == nullptr)
+      return -1;
+    auto slot = runtime->cpu_thread_id();
+    return 0 <= slot && slot < max_num_thread_slots ? slot : -1;
+  }
+
+  // Allocates a node that is not counted as in use until mark_in_use() is
+  // called, preferring the spare node of the thread owning |slot|.
+  Ptr allocate_cached(i32 slot) {
+    if (thread_cache[slot] != nullptr) {
+      auto ptr = thread_cache[slot];
+      thread_cache[slot] = nullptr;
+      return ptr;
+    }
+    return allocate_node();
+  }
+
+  // Gives back a node from allocate_cached() that was never used. The node
+  // must still be zero-filled.
+  void release_cached(i32 slot, Ptr ptr) {
+    if (thread_cache[slot] == nullptr) {
+      thread_cache[slot] = ptr;
+    } else {
+      mark_in_use();
+      recycle(ptr);
+    }
+  }
+
+  // Returns the spare nodes to the free list, so that they do not keep
+  // compact() from releasing their chunks. Called by GC before the recycled
+  // nodes are processed.
+  void drain_thread_cache() {
+    for (int i = 0; i < max_num_thread_slots; i++) {
+      if (thread_cache[i] != nullptr) {
+        // GC takes all recycled nodes off |num_in_use|
+        num_in_use += 1;
+        recycle(thread_cache[i]);
+        thread_cache[i] = nullptr;
+      }
+    }
+  }
+
+  void mark_in_use() {
+    auto n = atomic_add_i32(&num_in_use, 1) + 1;
+    if (n > max_num_in_use) {
+      atomic_max_i32(&max_num_in_use, n);
+    }
   }
 
   Ptr allocate() {
+    mark_in_use();
+    return allocate_node();
+  }
+
+  Ptr allocate_node() {
     int old_cursor = atomic_add_i32(&free_list_used, 1);
     i32 l;
     if (old_cursor >= free_list->size()) {
@@ -626,6 +841,11 @@ struct NodeManager {
     } else {
       // reuse
       l = free_list->get<list_data_type>(old_cursor);
+      if (lazy_zero_fill) {
+        auto ptr = data_list->get_element_ptr(l);
+        std::memset(ptr, 0, element_size);
+        return ptr;
+      }
     }
     return data_list->get_element_ptr(l);
   }
@@ -640,6 +860,9 @@ struct NodeManager {
   }
 
   void gc_serial() {
+    drain_thread_cache();
+    num_in_use -= recycled_list->size();
+
     // compact free list
     for (int i = free_list_used; i < free_list->size(); i++) {
       free_list->get<list_data_type>(i - free_list_used) =
@@ -652,12 +875,88 @@ struct NodeManager {
     // zero-fill recycled and push to free list
     for (int i = 0; i < recycled_list->size(); i++) {
       auto idx = recycled_list->get<list_data_type>(i);
-      auto ptr = data_list->get_element_ptr(idx);
-      std::memset(ptr, 0, element_size);
+      if (!lazy_zero_fill) {
+        auto ptr = data_list->get_element_ptr(idx);
+        std::memset(ptr, 0, element_size);
+      }
       free_list->push_back(idx);
     }
     recycled_list->clear();
   }
+
+  // Should be called right after GC, when the free list is compact.
+  // Returns the pages of data chunks whose elements are all free to the OS.
+  // Live nodes cannot be moved since their parents hold raw pointers to them.
+  // Instead, the free list is sorted by chunk so that subsequent allocations
+  // are packed into the lowest chunks, leaving the high ones free to be
+  // released at the next compaction.
+  void compact() {
+    if (runtime->memory_release == nullptr)
+      return;
+    using T = list_data_type;
+    const auto log2chunk = data_list->log2chunk_num_elements;
+    const i32 num_chunks =
+        (data_list->size() + chunk_num_elements - 1) >> log2chunk;
+    const i32 num_free = free_list->size() - free_list_used;
+
+    chunk_free_counts->clear();
+    for (int c = 0; c < num_chunks; c++) {
+      chunk_free_counts->push_back(0);
+    }
+    for (int i = free_list_used; i < free_list->size(); i++) {
+      chunk_free_counts->get<i32>(free_list->get<T>(i) >> log2chunk) += 1;
+    }
+
+    released_bytes = 0;
+    for (int c = 0; c < num_chunks; c++) {
+      // The tail of the last chunk has never been handed out
+      auto num_reserved =
+          min_i32(chunk_num_elements, data_list->size() - (c << log2chunk));
+      if (chunk_free_counts->get<i32>(c) == num_reserved) {
+        // Released pages are zero-filled when touched again, so the free
+        // nodes in this chunk remain valid.
+        released_bytes += runtime->memory_release(
+            runtime->prog, data_list->get_chunk(c),
+            (std::size_t)chunk_num_elements * element_size);
+      }
+    }
+
+    // Counting sort of the free list by chunk, using recycled_list (which is
+    // empty after GC) as the output buffer.
+    if (recycled_list->size() != 0)
+      return;
+    i32 offset = 0;
+    for (int c = 0; c < num_chunks; c++) {
+      auto count = chunk_free_counts->get<i32>(c);
+      chunk_free_counts->get<i32>(c) = offset;
+      offset += count;
+    }
+    for (int i = 0; i < num_free; i++) {
+      recycled_list->touch_and_get(i);
+    }
+    for (int i = free_list_used; i < free_list->size(); i++) {
+      auto idx = free_list->get<T>(i);
+      auto &dest = chunk_free_counts->get<i32>(idx >> log2chunk);
+      recycled_list->get<T>(dest) = idx;
+      dest += 1;
+    }
+    for (int i = 0; i < num_free; i++) {
+      free_list->get<T>(i) = recycled_list->get<T>(i);
+    }
+    free_list_used = 0;
+    free_list->resize(num_free);
+  }
+
+  // Returns all the memory of the nodes and of the node manager itself to the
+  // OS, when the SNode tree is destroyed.
+  void release() {
+    data_list->release();
+    free_list->release();
+    recycled_list->release();
+    chunk_free_counts->release();
+    if (runtime->memory_release != nullptr)
+      runtime->memory_release(runtime->prog, (Ptr)this, sizeof(NodeManager));
+  }
 };
 
 extern "C" {
@@ -708,6 +1007,8 @@ RUNTIME_STRUCT_FIELD(NodeManager, free_list);
 RUNTIME_STRUCT_FIELD(NodeManager, recycled_list);
 RUNTIME_STRUCT_FIELD(NodeManager, data_list);
 RUNTIME_STRUCT_FIELD(NodeManager, free_list_used);
+RUNTIME_STRUCT_FIELD(NodeManager, released_bytes);
+RUNTIME_STRUCT_FIELD(NodeManager, max_num_in_use);
 
 RUNTIME_STRUCT_FIELD(ListManager, num_elements);
 RUNTIME_STRUCT_FIELD(ListManager, max_num_elements_per_chunk);
@@ -822,7 +1123,6 @@ void runtime_get_mem_req_queue(LLVMRuntime *runtime) {
 void runtime_initialize(
     Ptr result_buffer,
     Ptr prog,
-    std::size_t root_size,
     std::size_t
         preallocated_size,  // Non-zero means use the preallocated buffer
     Ptr preallocated_buffer,
@@ -844,9 +1144,6 @@ void runtime_initialize(
     runtime = (LLVMRuntime *)vm_allocator(prog, sizeof(LLVMRuntime), 128);
   }
 
-  runtime->root_mem_size =
-      taichi::iroundup((size_t)root_size, taichi_page_size);
-
   runtime->preallocated = preallocated_size > 0;
   runtime->preallocated_head = preallocated_buffer;
   runtime->preallocated_tail = preallocated_tail;
@@ -864,13 +1161,6 @@ void runtime_initialize(
   runtime->mem_req_queue = (MemRequestQueue *)runtime->allocate_aligned(
       sizeof(MemRequestQueue), taichi_page_size);
 
-  // For Metal runtime, we have to make sure that both the beginning address
-  // and the size of the root buffer memory are aligned to page size.
-  runtime->root_mem_size =
-      taichi::iroundup((size_t)root_size, taichi_page_size);
-  runtime->root =
-      runtime->allocate_aligned(runtime->root_mem_size, taichi_page_size);
-
   runtime->temporaries = (Ptr)runtime->allocate_aligned(
       taichi_global_tmp_buffer_size, taichi_page_size);
 
@@ -881,19 +1171,31 @@ void runtime_initialize(
     initialize_rand_state(&runtime->rand_states[i], i);
 }
 
-void runtime_initialize2(LLVMRuntime *runtime, int root_id, int num_snodes) {
-  // runtime->request_allocate_aligned ready to use
+void runtime_initialize_element_list(LLVMRuntime *runtime,
+                                     int snode_id,
+                                     int num_elements_per_chunk) {
+  runtime->element_lists[snode_id] = runtime->create<ListManager>(
+      runtime, sizeof(Element), num_elements_per_chunk);
+}
+
+// Allocates the root buffer of an SNode tree, whose element lists have been
+// initialized by runtime_initialize_element_list.
+void runtime_initialize_snode_tree(LLVMRuntime *runtime,
+                                   std::size_t root_size,
+                                   int root_id,
+                                   int snode_tree_id) {
+  // For Metal runtime, we have to make sure that both the beginning address
+  // and the size of the root buffer memory are aligned to page size.
+  auto root_mem_size = taichi::iroundup(root_size, taichi_page_size);
+  auto root = runtime->allocate_aligned(root_mem_size, taichi_page_size);
+  runtime->root_mem_sizes[snode_tree_id] = root_mem_size;
+  runtime->roots[snode_tree_id] = root;
 
   // initialize the root node element list
-  for (int i = 0; i < num_snodes; i++) {
-    // TODO: some SNodes do not actually need an element list.
-    runtime->element_lists[i] =
-        runtime->create<ListManager>(runtime, sizeof(Element), 1024 * 64);
-  }
   Element elem;
   elem.loop_bounds[0] = 0;
   elem.loop_bounds[1] = 1;
-  elem.element = runtime->root;
+  elem.element = root;
   for (int i = 0; i < taichi_max_num_indices; i++) {
     elem.pcoord.val[i] = 0;
   }
@@ -910,9 +1212,33 @@ void LLVMRuntime_initialize_thread_pool(LLVMRuntime *runtime,
 
 void runtime_NodeAllocator_initialize(LLVMRuntime *runtime,
                                       int snode_id,
-                                      std::size_t node_size) {
-  runtime->node_allocators[snode_id] =
-      runtime->create<NodeManager>(runtime, node_size, 1024 * 16);
+                                      std::size_t node_size,
+                                      i32 chunk_num_elements,
+                                      i32 lazy_zero_fill) {
+  runtime->node_allocators[snode_id] = runtime->create<NodeManager>(
+      runtime, node_size, chunk_num_elements, lazy_zero_fill);
+}
+
+// Returns the memory of an SNode of a destroyed tree to the OS. Only possible
+// when the runtime memory lives on the host.
+void runtime_release_snode(LLVMRuntime *runtime, int snode_id) {
+  if (runtime->element_lists[snode_id] != nullptr) {
+    runtime->element_lists[snode_id]->release();
+    runtime->element_lists[snode_id] = nullptr;
+  }
+  if (runtime->node_allocators[snode_id] != nullptr) {
+    runtime->node_allocators[snode_id]->release();
+    runtime->node_allocators[snode_id] = nullptr;
+  }
+}
+
+void runtime_release_snode_tree(LLVMRuntime *runtime, int snode_tree_id) {
+  if (runtime->memory_release != nullptr) {
+    runtime->memory_release(runtime->prog, runtime->roots[snode_tree_id],
+                            runtime->root_mem_sizes[snode_tree_id]);
+  }
+  runtime->roots[snode_tree_id] = nullptr;
+  runtime->root_mem_sizes[snode_tree_id] = 0;
 }
 
 void runtime_allocate_ambient(LLVMRuntime *runtime,
@@ -1090,9 +1416,13 @@ void element_listgen_root(LLVMRuntime *runtime,
   }
 }
 
-void element_listgen_nonroot(LLVMRuntime *runtime,
-                             StructMeta *parent,
-                             StructMeta *child) {
+// If |lower| is not null, only the parent cells whose coordinates lie in
+// [lower, upper] (inclusive) are expanded
+void element_listgen_nonroot_impl(LLVMRuntime *runtime,
+                                  StructMeta *parent,
+                                  StructMeta *child,
+                                  PhysicalCoordinates *lower,
+                                  PhysicalCoordinates *upper) {
   auto parent_list = runtime->element_lists[parent->snode_id];
   int num_parent_elements = parent_list->size();
   auto child_list = runtime->element_lists[child->snode_id];
@@ -1122,6 +1452,15 @@ void element_listgen_nonroot(LLVMRuntime *runtime,
     for (int j = j_lower; j < j_higher; j += j_step) {
       PhysicalCoordinates refined_coord;
       parent_refine_coordinates(&element.pcoord, &refined_coord, j);
+      if (lower != nullptr) {
+        bool inside = true;
+        for (int k = 0; k < taichi_max_num_indices; k++) {
+          inside = inside && lower->val[k] <= refined_coord.val[k] &&
+                   refined_coord.val[k] <= upper->val[k];
+        }
+        if (!inside)
+          continue;
+      }
       if (parent_is_active((Ptr)parent, element.element, j)) {
         auto ch_element =
             parent_lookup_element((Ptr)parent, element.element, j);
@@ -1144,7 +1483,60 @@ void element_listgen_nonroot(LLVMRuntime *runtime,
   }
 }
 
+void element_listgen_nonroot(LLVMRuntime *runtime,
+                             StructMeta *parent,
+                             StructMeta *child) {
+  element_listgen_nonroot_impl(runtime, parent, child, nullptr, nullptr);
+}
+
+// For struct-fors restricted to a bounding box, see CodeGenLLVM::emit_list_gen
+void element_listgen_nonroot_bounded(LLVMRuntime *runtime,
+                                     StructMeta *parent,
+                                     StructMeta *child,
+                                     PhysicalCoordinates *lower,
+                                     PhysicalCoordinates *upper) {
+  element_listgen_nonroot_impl(runtime, parent, child, lower, upper);
+}
+
 using BlockTask = void(Context *, char *, Element *, int, int);
+using range_for_xlogue = void (*)(Context *, /*TLS*/ char *tls_base);
+
+// On CPUs, thread-local storage lives with the worker threads of the pool
+// for the whole offloaded task: each worker uses the slot indexed by its
+// stable worker id. The TLS prologue and epilogue therefore run once per
+// slot, before and after the task, instead of once per block.
+struct cpu_thread_local_storage {
+  char *buffer;
+  std::size_t slot_size;
+
+  // Slot 0 is for a thread outside the pool (worker id -1). It is also the
+  // fallback when LLVMRuntime::cpu_thread_id has not been set.
+  static int num_slots(int num_threads) {
+    return num_threads + 1;
+  }
+
+  char *get_slot(LLVMRuntime *runtime) {
+    if (runtime->cpu_thread_id == nullptr)
+      return buffer;
+    return buffer + (runtime->cpu_thread_id() + 1) * slot_size;
+  }
+};
+
+std::size_t cpu_tls_slot_size(std::size_t tls_size) {
+  // Keep the slots 8-byte aligned, and on different cache lines
+  return (tls_size + 63) / 64 * 64;
+}
+
+void cpu_tls_run_xlogue(Context *context,
+                        cpu_thread_local_storage &tls,
+                        int num_slots,
+                        range_for_xlogue xlogue) {
+  if (xlogue == nullptr)
+    return;
+  for (int i = 0; i < num_slots; i++) {
+    xlogue(context, tls.buffer + i * tls.slot_size);
+  }
+}
 
 struct cpu_block_task_helper_context {
   Context *context;
@@ -1152,16 +1544,13 @@ struct cpu_block_task_helper_context {
   ListManager *list;
   int element_size;
   int element_split;
-  std::size_t tls_buffer_size;
+  cpu_thread_local_storage tls;
 };
 
 // TODO: To enforce inlining, we need to create in LLVM a new function that
 // calls block_helper and the BLS xlogues, and pass that function to the
 // scheduler.
 
-// TODO: TLS should be directly passed to the scheduler, so that it lives
-// with the threads (instead of blocks).
-
 void block_helper(void *ctx_, int i) {
   auto ctx = (cpu_block_task_helper_context *)(ctx_);
   int element_id = i / ctx->element_split;
@@ -1171,9 +1560,9 @@ void block_helper(void *ctx_, int i) {
   int lower = e.loop_bounds[0] + part_id * part_size;
   int upper = e.loop_bounds[0] + (part_id + 1) * part_size;
   upper = std::min(upper, e.loop_bounds[1]);
-  alignas(8) char tls_buffer[ctx->tls_buffer_size];
   if (lower < upper) {
-    (*ctx->task)(ctx->context, tls_buffer, &ctx->list->get<Element>(element_id),
+    auto tls_ptr = ctx->tls.get_slot(ctx->context->runtime);
+    (*ctx->task)(ctx->context, tls_ptr, &ctx->list->get<Element>(element_id),
                  lower, upper);
   }
 }
@@ -1183,6 +1572,8 @@ void parallel_struct_for(Context *context,
                          int element_size,
                          int element_split,
                          BlockTask *task,
+                         range_for_xlogue tls_prologue,
+                         range_for_xlogue tls_epilogue,
                          std::size_t tls_buffer_size,
                          int num_threads) {
   auto list = (context->runtime)->element_lists[snode_id];
@@ -1215,21 +1606,22 @@ void parallel_struct_for(Context *context,
   ctx.list = list;
   ctx.element_size = element_size;
   ctx.element_split = element_split;
-  ctx.tls_buffer_size = tls_buffer_size;
+  ctx.tls.slot_size = cpu_tls_slot_size(tls_buffer_size);
+  auto num_tls_slots = cpu_thread_local_storage::num_slots(num_threads);
+  alignas(64) char tls_buffer[ctx.tls.slot_size * num_tls_slots];
+  ctx.tls.buffer = &tls_buffer[0];
+  cpu_tls_run_xlogue(context, ctx.tls, num_tls_slots, tls_prologue);
   auto runtime = context->runtime;
   runtime->parallel_for(runtime->thread_pool, list_tail * element_split,
                         num_threads, &ctx, block_helper);
+  cpu_tls_run_xlogue(context, ctx.tls, num_tls_slots, tls_epilogue);
 #endif
 }
 
-using range_for_xlogue = void (*)(Context *, /*TLS*/ char *tls_base);
-
 struct range_task_helper_context {
   Context *context;
-  range_for_xlogue prologue{nullptr};
-  RangeForTaskFunc *body{nullptr};
-  range_for_xlogue epilogue{nullptr};
-  std::size_t tls_size{1};
+  RangeForBlockTaskFunc *body{nullptr};
+  cpu_thread_local_storage tls;
   int begin;
   int end;
   int block_size;
@@ -1238,25 +1630,17 @@ struct range_task_helper_context {
 
 void cpu_parallel_range_for_task(void *range_context, int task_id) {
   auto ctx = *(range_task_helper_context *)range_context;
-  alignas(8) char tls_buffer[ctx.tls_size];
-  auto tls_ptr = &tls_buffer[0];
-  if (ctx.prologue)
-    ctx.prologue(ctx.context, tls_ptr);
+  auto tls_ptr = ctx.tls.get_slot(ctx.context->runtime);
+  // The body iterates over the block in the order of |step|
   if (ctx.step == 1) {
     int block_start = ctx.begin + task_id * ctx.block_size;
     int block_end = std::min(block_start + ctx.block_size, ctx.end);
-    for (int i = block_start; i < block_end; i++) {
-      ctx.body(ctx.context, tls_ptr, i);
-    }
+    ctx.body(ctx.context, tls_ptr, block_start, block_end);
   } else if (ctx.step == -1) {
-    int block_start = ctx.end - task_id * ctx.block_size;
-    int block_end = std::max(ctx.begin, block_start * ctx.block_size);
-    for (int i = block_start - 1; i >= block_end; i--) {
-      ctx.body(ctx.context, tls_ptr, i);
-    }
+    int block_end = ctx.end - task_id * ctx.block_size;
+    int block_start = std::max(ctx.begin, block_end - ctx.block_size);
+    ctx.body(ctx.context, tls_ptr, block_start, block_end);
   }
-  if (ctx.epilogue)
-    ctx.epilogue(ctx.context, tls_ptr);
 }
 
 void cpu_parallel_range_for(Context *context,
@@ -1266,15 +1650,12 @@ void cpu_parallel_range_for(Context *context,
                             int step,
                             int block_dim,
                             range_for_xlogue prologue,
-                            RangeForTaskFunc *body,
+                            RangeForBlockTaskFunc *body,
                             range_for_xlogue epilogue,
                             std::size_t tls_size) {
   range_task_helper_context ctx;
   ctx.context = context;
-  ctx.prologue = prologue;
-  ctx.tls_size = tls_size;
   ctx.body = body;
-  ctx.epilogue = epilogue;
   ctx.begin = begin;
   ctx.end = end;
   ctx.step = step;
@@ -1290,10 +1671,16 @@ void cpu_parallel_range_for(Context *context,
     block_dim = std::min(512, std::max(1, num_items / (num_threads * 32)));
   }
   ctx.block_size = block_dim;
+  ctx.tls.slot_size = cpu_tls_slot_size(tls_size);
+  auto num_tls_slots = cpu_thread_local_storage::num_slots(num_threads);
+  alignas(64) char tls_buffer[ctx.tls.slot_size * num_tls_slots];
+  ctx.tls.buffer = &tls_buffer[0];
+  cpu_tls_run_xlogue(context, ctx.tls, num_tls_slots, prologue);
   auto runtime = context->runtime;
   runtime->parallel_for(runtime->thread_pool,
                         (end - begin + block_dim - 1) / block_dim, num_threads,
                         &ctx, cpu_parallel_range_for_task);
+  cpu_tls_run_xlogue(context, ctx.tls, num_tls_slots, epilogue);
 }
 
 void gpu_parallel_range_for(Context *context,
@@ -1326,20 +1713,109 @@ i32 linear_thread_idx() {
 #include "node_root.h"
 #include "node_bitmasked.h"
 
+Ptr *ListManager::get_chunk_slot(i32 chunk_id) {
+  if (chunk_id < (i32)max_num_chunks) {
+    return &chunks[chunk_id];
+  }
+  auto overflow_id = chunk_id - (i32)max_num_chunks;
+  auto directory_id = overflow_id >> log2directory_size;
+  taichi_assert_runtime(runtime, directory_id < (i32)max_num_directories,
+                        "ListManager has run out of chunks.");
+  auto p_directory = &directories[directory_id];
+  if (!*p_directory) {
+    locked_task(&lock, [&] {
+      // may have been allocated during lock contention
+      if (!*p_directory) {
+        grid_memfence();
+        auto directory_ptr =
+            runtime->request_allocate_aligned(sizeof(Ptr) * directory_size, 64);
+        atomic_exchange_u64((u64 *)p_directory, (u64)directory_ptr);
+      }
+    });
+  }
+  return &(*p_directory)[overflow_id & (directory_size - 1)];
+}
+
 void ListManager::touch_chunk(int chunk_id) {
-  if (!chunks[chunk_id]) {
+  auto p_chunk = get_chunk_slot(chunk_id);
+  if (!*p_chunk) {
     locked_task(&lock, [&] {
       // may have been allocated during lock contention
-      if (!chunks[chunk_id]) {
+      if (!*p_chunk) {
+        grid_memfence();
+        auto chunk_ptr =
+            runtime->request_allocate_aligned(get_chunk_size(), 4096);
+        if (use_chunk_index)
+          add_to_chunk_index(chunk_id, chunk_ptr);
         grid_memfence();
-        auto chunk_ptr = runtime->request_allocate_aligned(
-            max_num_elements_per_chunk * element_size, 4096);
-        atomic_exchange_u64((u64 *)&chunks[chunk_id], (u64)chunk_ptr);
+        atomic_exchange_u64((u64 *)p_chunk, (u64)chunk_ptr);
       }
     });
   }
 }
 
+void ListManager::add_to_chunk_index(i32 chunk_id, Ptr chunk) {
+  auto index = chunk_index;
+  // A chunk adds at most two entries
+  if (index == nullptr || (index->num_entries + 2) * 2 > index->capacity()) {
+    i32 log2capacity = index == nullptr ? 4 : index->log2capacity + 1;
+    std::size_t capacity = (std::size_t)1 << log2capacity;
+    // Page-aligned so that release() can return it to the OS
+    auto new_index = (ListChunkIndex *)runtime->request_allocate_aligned(
+        sizeof(ListChunkIndex) + capacity * (sizeof(u64) + sizeof(i32)), 4096);
+    new_index->log2capacity = log2capacity;
+    new_index->num_entries = 0;
+    new_index->previous = index;
+    new_index->buckets = (u64 *)(new_index + 1);
+    new_index->chunk_ids = (i32 *)(new_index->buckets + capacity);
+    if (index != nullptr) {
+      for (int i = 0; i < index->capacity(); i++) {
+        if (index->buckets[i] != 0)
+          new_index->insert(index->buckets[i] - 1, index->chunk_ids[i]);
+      }
+    }
+    grid_memfence();
+    atomic_exchange_u64((u64 *)&chunk_index, (u64)new_index);
+    index = new_index;
+  }
+  auto first_bucket = (u64)chunk >> log2index_bucket_size;
+  auto last_bucket =
+      ((u64)chunk + get_chunk_size() - 1) >> log2index_bucket_size;
+  index->insert(first_bucket, chunk_id);
+  if (last_bucket != first_bucket)
+    index->insert(last_bucket, chunk_id);
+}
+
+void ListManager::release() {
+  auto rt = runtime;
+  if (rt->memory_release == nullptr)
+    return;
+  auto chunk_size = get_chunk_size();
+  for (std::size_t i = 0; i < max_num_chunks; i++) {
+    if (chunks[i] != nullptr)
+      rt->memory_release(rt->prog, chunks[i], chunk_size);
+  }
+  for (std::size_t d = 0; d < max_num_directories; d++) {
+    if (directories[d] == nullptr)
+      break;
+    for (std::size_t i = 0; i < directory_size; i++) {
+      if (directories[d][i] != nullptr)
+        rt->memory_release(rt->prog, directories[d][i], chunk_size);
+    }
+    rt->memory_release(rt->prog, (Ptr)directories[d],
+                       sizeof(Ptr) * directory_size);
+  }
+  for (auto index = chunk_index; index != nullptr;) {
+    auto previous = index->previous;
+    rt->memory_release(rt->prog, (Ptr)index,
+                       sizeof(ListChunkIndex) +
+                           index->capacity() * (sizeof(u64) + sizeof(i32)));
+    index = previous;
+  }
+  // Released pages read as zeros, so |rt| has been saved above
+  rt->memory_release(rt->prog, (Ptr)this, sizeof(ListManager));
+}
+
 void ListManager::append(void *data_ptr) {
   auto ptr = allocate();
   std::memcpy(ptr, data_ptr, element_size);
@@ -1354,6 +1830,10 @@ void node_gc(LLVMRuntime *runtime, int snode_id) {
   runtime->node_allocators[snode_id]->gc_serial();
 }
 
+void node_compact(LLVMRuntime *runtime, int snode_id) {
+  runtime->node_allocators[snode_id]->compact();
+}
+
 void gc_parallel_0(LLVMRuntime *runtime, int snode_id) {
   auto allocator = runtime->node_allocators[snode_id];
   auto free_list = allocator->free_list;
@@ -1390,6 +1870,7 @@ void gc_parallel_1(LLVMRuntime *runtime, int snode_id) {
   free_list->resize(num_unused);
 
   allocator->free_list_used = 0;
+  allocator->num_in_use -= allocator->recycled_list->size();
   allocator->recycle_list_size_backup = allocator->recycled_list->size();
   allocator->recycled_list->clear();
 }
@@ -1409,6 +1890,11 @@ void gc_parallel_2(LLVMRuntime *runtime, int snode_id) {
     if (thread_idx() == 0) {
       free_list->push_back(idx);
     }
+    if (allocator->lazy_zero_fill) {
+      // Zero-filled upon reallocation instead.
+      i += grid_dim();
+      continue;
+    }
     // memset
     auto ptr_stop = ptr + element_size;
     if ((uint64)ptr % 4 != 0) {
@@ -1433,6 +1919,100 @@ void gc_parallel_2(LLVMRuntime *runtime, int snode_id) {
     i += grid_dim();
   }
 }
+
+// CPU counterpart of gc_parallel_0/1/2. Free list compaction and zero-filling
+// of recycled nodes are split into blocks and scheduled on the thread pool.
+
+struct cpu_gc_task_helper_context {
+  NodeManager *allocator;
+  i32 num_items;
+  i32 src_offset;
+  i32 block_size;
+};
+
+void cpu_gc_compact_task(void *ctx_, int task_id) {
+  auto ctx = (cpu_gc_task_helper_context *)ctx_;
+  auto free_list = ctx->allocator->free_list;
+  using T = NodeManager::list_data_type;
+  int begin = task_id * ctx->block_size;
+  int end = std::min(begin + ctx->block_size, ctx->num_items);
+  for (int i = begin; i < end; i++) {
+    free_list->get<T>(i) = free_list->get<T>(ctx->src_offset + i);
+  }
+}
+
+void cpu_gc_recycle_task(void *ctx_, int task_id) {
+  auto ctx = (cpu_gc_task_helper_context *)ctx_;
+  auto allocator = ctx->allocator;
+  auto free_list = allocator->free_list;
+  auto recycled_list = allocator->recycled_list;
+  auto data_list = allocator->data_list;
+  auto element_size = allocator->element_size;
+  using T = NodeManager::list_data_type;
+  int begin = task_id * ctx->block_size;
+  int end = std::min(begin + ctx->block_size, ctx->num_items);
+  for (int i = begin; i < end; i++) {
+    auto idx = recycled_list->get<T>(i);
+    if (!allocator->lazy_zero_fill) {
+      std::memset(data_list->get_element_ptr(idx), 0, element_size);
+    }
+    // Slots [src_offset, src_offset + num_items) have been reserved in
+    // advance, so that no atomics are needed here.
+    free_list->get<T>(ctx->src_offset + i) = idx;
+  }
+}
+
+void gc_parallel_cpu(LLVMRuntime *runtime, int snode_id, int num_threads) {
+  auto allocator = runtime->node_allocators[snode_id];
+  auto free_list = allocator->free_list;
+  auto free_list_size = free_list->size();
+  auto free_list_used = allocator->free_list_used;
+  // Small tasks are not worth the scheduling overhead.
+  constexpr i32 block_size = 4096;
+
+  // Phase 0: move unused elements to the beginning of the free_list
+  cpu_gc_task_helper_context ctx;
+  ctx.allocator = allocator;
+  ctx.block_size = block_size;
+  if (free_list_used * 2 > free_list_size) {
+    // Directly copy. Dst and src does not overlap
+    ctx.num_items = free_list_size - free_list_used;
+    ctx.src_offset = free_list_used;
+  } else {
+    // Move only non-overlapping parts
+    ctx.num_items = free_list_used;
+    ctx.src_offset = free_list_size - free_list_used;
+  }
+  if (ctx.num_items > 0) {
+    runtime->parallel_for(runtime->thread_pool,
+                          (ctx.num_items + block_size - 1) / block_size,
+                          num_threads, &ctx, cpu_gc_compact_task);
+  }
+
+  // Phase 1: reinitialize the lists
+  const i32 num_unused = max_i32(free_list_size - free_list_used, 0);
+  allocator->drain_thread_cache();
+  const i32 num_recycled = allocator->recycled_list->size();
+  allocator->num_in_use -= num_recycled;
+  allocator->free_list_used = 0;
+  free_list->resize(num_unused + num_recycled);
+  // Make sure the chunks holding the reserved slots are allocated
+  for (int c = num_unused >> free_list->log2chunk_num_elements;
+       c << free_list->log2chunk_num_elements < num_unused + num_recycled;
+       c++) {
+    free_list->touch_chunk(c);
+  }
+
+  // Phase 2: zero-fill recycled nodes and push them to the free list
+  ctx.num_items = num_recycled;
+  ctx.src_offset = num_unused;
+  if (num_recycled > 0) {
+    runtime->parallel_for(runtime->thread_pool,
+                          (num_recycled + block_size - 1) / block_size,
+                          num_threads, &ctx, cpu_gc_recycle_task);
+  }
+  allocator->recycled_list->clear();
+}
 }
 
 #if ARCH_cuda
@@ -1545,8 +2125,18 @@ void stack_pop(Ptr stack) {
 void stack_push(Ptr stack, size_t max_num_elements, std::size_t element_size) {
   u64 &n = *(u64 *)stack;
   n += 1;
-  // TODO: assert n <= max_elements
-  std::memset(stack_top_primal(stack, element_size), 0, element_size * 2);
+  // The primal is always written right after the push, so only the adjoint
+  // needs to be zero-filled.
+  std::memset(stack_top_adjoint(stack, element_size), 0, element_size);
+}
+
+void stack_push_with_check(LLVMRuntime *runtime,
+                           Ptr stack,
+                           size_t max_num_elements,
+                           std::size_t element_size) {
+  taichi_assert_runtime(runtime, *(u64 *)stack < max_num_elements,
+                        "Adstack overflow. Consider increasing ad_stack_size.");
+  stack_push(stack, max_num_elements, element_size);
 }
 
 #include "internal_functions.h"
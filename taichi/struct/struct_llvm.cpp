@@ -13,9 +13,22 @@ TLANG_NAMESPACE_BEGIN
 
 using namespace llvm;
 
+namespace {
+
+// The first SNode tree is compiled into a fresh copy of the runtime module.
+// Trees added later extend the current struct module instead, so that it keeps
+// the types and accessors of the existing trees.
+std::unique_ptr<llvm::Module> get_base_module(TaichiLLVMContext *tlctx) {
+  if (tlctx->runtime_jit_module != nullptr)
+    return tlctx->clone_struct_module();
+  return tlctx->clone_runtime_module();
+}
+
+}  // namespace
+
 StructCompilerLLVM::StructCompilerLLVM(Program *prog, Arch arch)
     : StructCompiler(prog),
-      LLVMModuleBuilder(prog->get_llvm_context(arch)->clone_runtime_module(),
+      LLVMModuleBuilder(get_base_module(prog->get_llvm_context(arch)),
                         prog->get_llvm_context(arch)),
       arch(arch) {
   tlctx = prog->get_llvm_context(arch);
@@ -43,7 +56,6 @@ void StructCompilerLLVM::generate_types(SNode &snode) {
 
   llvm::Type *body_type = nullptr, *aux_type = nullptr;
   if (type == SNodeType::dense || type == SNodeType::bitmasked) {
-    TI_ASSERT(snode._morton == false);
     body_type = llvm::ArrayType::get(ch_type, snode.max_num_elements());
     if (type == SNodeType::bitmasked) {
       aux_type = llvm::ArrayType::get(llvm::Type::getInt32Ty(*llvm_ctx),
@@ -61,10 +73,22 @@ void StructCompilerLLVM::generate_types(SNode &snode) {
                                      snode.max_num_elements());
   } else if (type == SNodeType::dynamic) {
     // mutex and n (number of elements)
-    aux_type =
-        llvm::StructType::get(*ctx, {llvm::PointerType::getInt32Ty(*ctx),
-                                     llvm::PointerType::getInt32Ty(*ctx)});
-    body_type = llvm::PointerType::getInt8PtrTy(*ctx);
+    std::vector<llvm::Type *> aux_fields(2, llvm::Type::getInt32Ty(*ctx));
+    if (snode.chunk_directory) {
+      // number of allocated chunks
+      aux_fields.push_back(llvm::Type::getInt32Ty(*ctx));
+    }
+    aux_type = llvm::StructType::get(*ctx, aux_fields);
+    if (snode.chunk_directory) {
+      // one pointer per chunk
+      auto num_chunks =
+          (snode.max_num_elements() + snode.chunk_size - 1) / snode.chunk_size;
+      body_type = llvm::ArrayType::get(llvm::PointerType::getInt8PtrTy(*ctx),
+                                       num_chunks);
+    } else {
+      // head of the linked list of chunks
+      body_type = llvm::PointerType::getInt8PtrTy(*ctx);
+    }
   } else {
     TI_P(snode.type_name());
     TI_NOT_IMPLEMENTED;
@@ -123,12 +147,17 @@ void StructCompilerLLVM::generate_refine_coordinates(SNode *snode) {
   auto outp_coords = args[1];
   auto l = args[2];
 
+  auto layout_masks = snode->get_index_bit_masks();
   for (int i = 0; i < taichi_max_num_indices; i++) {
     auto addition = tlctx->get_constant(0);
     if (snode->extractors[i].num_bits) {
-      auto mask = ((1 << snode->extractors[i].num_bits) - 1);
-      addition = builder.CreateAnd(
-          builder.CreateAShr(l, snode->extractors[i].acc_offset), mask);
+      if (layout_masks.empty()) {
+        auto mask = ((1 << snode->extractors[i].num_bits) - 1);
+        addition = builder.CreateAnd(
+            builder.CreateAShr(l, snode->extractors[i].acc_offset), mask);
+      } else {
+        addition = create_bit_gather(&builder, l, layout_masks[i]);
+      }
       addition = builder.CreateShl(
           addition, tlctx->get_constant(snode->extractors[i].start));
     }
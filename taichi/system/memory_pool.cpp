@@ -1,5 +1,6 @@
 #include "memory_pool.h"
 #include "taichi/system/timer.h"
+#include "taichi/system/virtual_memory.h"
 #include "taichi/program/program.h"
 #include "taichi/backends/cuda/cuda_driver.h"
 
@@ -48,6 +49,14 @@ void *MemoryPool::allocate(std::size_t size, std::size_t alignment) {
   return ret;
 }
 
+std::size_t MemoryPool::release(void *ptr, std::size_t size) {
+  if (!arch_use_host_memory(prog->config.arch)) {
+    // Unified memory is managed by the CUDA driver.
+    return 0;
+  }
+  return VirtualMemoryAllocator::release_pages(ptr, size);
+}
+
 template <typename T>
 T MemoryPool::fetch(volatile void *ptr) {
   T ret;
@@ -41,6 +41,10 @@ class MemoryPool {
 
   void *allocate(std::size_t size, std::size_t alignment);
 
+  // Returns the pages of a previously allocated range to the OS. The range
+  // stays valid and reads as zeros afterwards.
+  std::size_t release(void *ptr, std::size_t size);
+
   void set_queue(MemRequestQueue *queue);
 
   void daemon();
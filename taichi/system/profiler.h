@@ -13,6 +13,7 @@
 
 #include "taichi/common/core.h"
 #include "taichi/system/timer.h"
+#include "taichi/system/tracer.h"
 #include "spdlog/fmt/bundled/color.h"
 
 TI_NAMESPACE_BEGIN
@@ -52,7 +53,10 @@ class Profiling {
   std::unordered_map<std::thread::id, ProfilerRecords *> profilers;
 };
 
-#define TI_PROFILER(name) taichi::ScopedProfiler _profiler_##__LINE__(name);
+// Also emits a trace event when the tracer is enabled
+#define TI_PROFILER(name) \
+  TI_TRACE_SCOPE(name);   \
+  taichi::ScopedProfiler _profiler_##__LINE__(name);
 
 #define TI_AUTO_PROF TI_PROFILER(__FUNCTION__)
 
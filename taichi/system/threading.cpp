@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <condition_variable>
 #include "taichi/system/threading.h"
+#include "taichi/system/tracer.h"
 #include <thread>
 #include <vector>
 #if defined(TI_PLATFORM_WINDOWS)
@@ -19,6 +20,10 @@
 
 TI_NAMESPACE_BEGIN
 
+namespace {
+thread_local int current_worker_id = -1;
+}  // namespace
+
 bool test_threading() {
   auto tp = ThreadPool();
   for (int j = 0; j < 100; j++) {
@@ -70,6 +75,7 @@ void ThreadPool::run(int splits,
                      int desired_num_threads,
                      void *context,
                      RangeForTaskFunc *func) {
+  TI_TRACE_SCOPE("ThreadPool::run");
   {
     std::lock_guard _(mutex);
     this->context = context;
@@ -101,6 +107,7 @@ void ThreadPool::target() {
     std::lock_guard<std::mutex> lock(mutex);
     thread_id = thread_counter++;
   }
+  current_worker_id = thread_id;
   while (true) {
     {
       std::unique_lock<std::mutex> lock(mutex);
@@ -125,15 +132,19 @@ void ThreadPool::target() {
       }
     }
 
-    while (true) {
-      // For a single parallel task
-      int task_id;
-      {
-        task_id = task_head.fetch_add(1, std::memory_order_relaxed);
-        if (task_id >= task_tail)
-          break;
+    {
+      // One event per worker and parallel task, not per split
+      TI_TRACE_SCOPE("ThreadPool worker");
+      while (true) {
+        // For a single parallel task
+        int task_id;
+        {
+          task_id = task_head.fetch_add(1, std::memory_order_relaxed);
+          if (task_id >= task_tail)
+            break;
+        }
+        func(context, task_id);
       }
-      func(context, task_id);
     }
 
     bool all_finished = false;
@@ -150,6 +161,10 @@ void ThreadPool::target() {
   }
 }
 
+int ThreadPool::get_current_worker_id() {
+  return current_worker_id;
+}
+
 ThreadPool::~ThreadPool() {
   {
     std::lock_guard<std::mutex> lg(mutex);
@@ -58,6 +58,11 @@ class ThreadPool {
 
   void target();
 
+  // Returns the index of the calling worker thread in its pool, or -1 if the
+  // caller is not a worker thread. The index is stable during the lifetime of
+  // the pool.
+  static int get_current_worker_id();
+
   ~ThreadPool();
 };
 
@@ -0,0 +1,168 @@
+#include "taichi/system/tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+TI_NAMESPACE_BEGIN
+
+namespace {
+
+struct TraceEvent {
+  int name_id;
+  uint64 begin_ns;
+  uint64 end_ns;
+};
+
+struct TraceBuffer {
+  int thread_id;
+  // Only written by the owning thread
+  std::atomic<uint64> head{0};
+  // Events before |tail| have been cleared
+  std::atomic<uint64> tail{0};
+  TraceEvent events[Tracer::buffer_size];
+};
+
+struct TraceRegistry {
+  std::mutex mut;
+  std::vector<std::string> names;
+  std::unordered_map<std::string, int> name_ids;
+  std::vector<TraceBuffer *> buffers;
+  // Buffers of exited threads, handed to the next threads that trace. Their
+  // events are kept until then.
+  std::vector<TraceBuffer *> free_buffers;
+};
+
+TraceRegistry &get_registry() {
+  // Lives together with the process, like the buffers
+  static auto registry = new TraceRegistry;
+  return *registry;
+}
+
+// Returns the buffer of its thread to the registry when the thread exits, so
+// that programs creating many short-lived threads keep only as many buffers as
+// threads tracing at the same time.
+struct ThreadTraceBuffer {
+  TraceBuffer *buffer{nullptr};
+
+  ~ThreadTraceBuffer() {
+    if (buffer == nullptr)
+      return;
+    auto &registry = get_registry();
+    std::lock_guard<std::mutex> _(registry.mut);
+    registry.free_buffers.push_back(buffer);
+  }
+};
+
+TraceBuffer *get_this_thread_buffer() {
+  static thread_local ThreadTraceBuffer this_thread;
+  if (this_thread.buffer == nullptr) {
+    auto &registry = get_registry();
+    std::lock_guard<std::mutex> _(registry.mut);
+    if (!registry.free_buffers.empty()) {
+      // Threads sharing a buffer never overlap in time, so they may share a
+      // row in the trace as well.
+      this_thread.buffer = registry.free_buffers.back();
+      registry.free_buffers.pop_back();
+    } else {
+      this_thread.buffer = new TraceBuffer;
+      this_thread.buffer->thread_id = (int)registry.buffers.size();
+      registry.buffers.push_back(this_thread.buffer);
+    }
+  }
+  return this_thread.buffer;
+}
+
+std::string escape_json(const std::string &s) {
+  std::string ret;
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      ret += '\\';
+    ret += c;
+  }
+  return ret;
+}
+
+}  // namespace
+
+std::atomic<bool> Tracer::enabled{false};
+
+void Tracer::enable() {
+  enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::disable() {
+  enabled.store(false, std::memory_order_relaxed);
+}
+
+int Tracer::intern(const std::string &name) {
+  auto &registry = get_registry();
+  std::lock_guard<std::mutex> _(registry.mut);
+  auto it = registry.name_ids.find(name);
+  if (it != registry.name_ids.end())
+    return it->second;
+  int id = (int)registry.names.size();
+  registry.names.push_back(name);
+  registry.name_ids[name] = id;
+  return id;
+}
+
+uint64 Tracer::get_time_ns() {
+  return (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Tracer::record(int name_id, uint64 begin_ns, uint64 end_ns) {
+  auto buffer = get_this_thread_buffer();
+  auto head = buffer->head.load(std::memory_order_relaxed);
+  buffer->events[head % buffer_size] = {name_id, begin_ns, end_ns};
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::clear() {
+  auto &registry = get_registry();
+  std::lock_guard<std::mutex> _(registry.mut);
+  for (auto buffer : registry.buffers) {
+    buffer->tail.store(buffer->head.load(std::memory_order_acquire),
+                       std::memory_order_relaxed);
+  }
+}
+
+void Tracer::export_chrome_trace(const std::string &filename) {
+  auto &registry = get_registry();
+  std::lock_guard<std::mutex> _(registry.mut);
+  std::vector<std::pair<int, TraceEvent>> events;
+  for (auto buffer : registry.buffers) {
+    auto head = buffer->head.load(std::memory_order_acquire);
+    auto begin = std::max(buffer->tail.load(std::memory_order_relaxed),
+                          head > (uint64)buffer_size ? head - buffer_size : 0);
+    for (auto i = begin; i < head; i++) {
+      events.emplace_back(buffer->thread_id, buffer->events[i % buffer_size]);
+    }
+  }
+  uint64 base_ns = events.empty() ? 0 : events[0].second.begin_ns;
+  for (auto &e : events) {
+    base_ns = std::min(base_ns, e.second.begin_ns);
+  }
+
+  std::ofstream os(filename);
+  TI_ERROR_UNLESS(os, "Cannot open {}", filename);
+  os << "{\"traceEvents\":[";
+  for (int i = 0; i < (int)events.size(); i++) {
+    auto &e = events[i].second;
+    os << (i ? ",\n" : "\n")
+       << fmt::format(
+              "{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},"
+              "\"ts\":{:.3f},\"dur\":{:.3f}}}",
+              escape_json(registry.names[e.name_id]), events[i].first,
+              (e.begin_ns - base_ns) * 1e-3, (e.end_ns - e.begin_ns) * 1e-3);
+  }
+  os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+  TI_INFO("{} trace events written to {}", events.size(), filename);
+}
+
+TI_NAMESPACE_END
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "taichi/common/core.h"
+
+TI_NAMESPACE_BEGIN
+
+// A low-overhead tracer for nested scopes on all threads, meant to be left on
+// in production. Scope names are interned once per call site, and each thread
+// appends events to its own ring buffer without locking. The latest events can
+// be exported as Chrome trace JSON, viewable in chrome://tracing or Perfetto.
+class Tracer {
+ public:
+  // Events kept per thread. Older events are overwritten.
+  static constexpr int buffer_size = 1 << 16;
+
+  static bool is_enabled() {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  static void enable();
+
+  static void disable();
+
+  // Thread-safe. Returns the same id for the same name.
+  static int intern(const std::string &name);
+
+  // Nanoseconds from a steady clock
+  static uint64 get_time_ns();
+
+  static void record(int name_id, uint64 begin_ns, uint64 end_ns);
+
+  // Drops the events recorded so far
+  static void clear();
+
+  // Events recorded by threads that are still tracing may be incomplete, so
+  // disable the tracer first for an exact trace.
+  static void export_chrome_trace(const std::string &filename);
+
+ private:
+  static std::atomic<bool> enabled;
+};
+
+class ScopedTrace {
+ public:
+  explicit ScopedTrace(int name_id) : name_id(name_id), begin_ns(0) {
+    if (Tracer::is_enabled())
+      begin_ns = Tracer::get_time_ns();
+  }
+
+  ~ScopedTrace() {
+    if (begin_ns != 0)
+      Tracer::record(name_id, begin_ns, Tracer::get_time_ns());
+  }
+
+ private:
+  int name_id;
+  uint64 begin_ns;
+};
+
+#define TI_TRACE_CONCAT_IMPL(a, b) a##b
+#define TI_TRACE_CONCAT(a, b) TI_TRACE_CONCAT_IMPL(a, b)
+
+// |name| must not change between executions of the same call site
+#define TI_TRACE_SCOPE(name)                                          \
+  static const int TI_TRACE_CONCAT(_trace_id_, __LINE__) =            \
+      taichi::Tracer::intern(name);                                   \
+  taichi::ScopedTrace TI_TRACE_CONCAT(_trace_scope_, __LINE__)(       \
+      TI_TRACE_CONCAT(_trace_id_, __LINE__))
+
+TI_NAMESPACE_END
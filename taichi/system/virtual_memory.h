@@ -41,6 +41,30 @@ class VirtualMemoryAllocator {
                 page_size);
   }
 
+  // Returns the physical pages backing [ptr, ptr + size) to the OS while
+  // keeping the address range reserved. The pages read as zeros when touched
+  // again. Only pages entirely inside the range are released, and the number
+  // of released bytes is returned.
+  static size_t release_pages(void *ptr, size_t size) {
+    auto begin = ((uint64_t)ptr + page_size - 1) / page_size * page_size;
+    auto end = ((uint64_t)ptr + size) / page_size * page_size;
+    if (end <= begin)
+      return 0;
+#if defined(TI_PLATFORM_UNIX)
+    if (madvise((void *)begin, end - begin, MADV_DONTNEED) != 0)
+      return 0;
+#else
+    // MEM_RESET does not guarantee zero-filled pages, so decommit and
+    // recommit the range instead.
+    if (!VirtualFree((void *)begin, end - begin, MEM_DECOMMIT))
+      return 0;
+    TI_ERROR_IF(VirtualAlloc((void *)begin, end - begin, MEM_COMMIT,
+                             PAGE_READWRITE) == nullptr,
+                "Failed to recommit virtual memory ({} B)", end - begin);
+#endif
+    return end - begin;
+  }
+
   ~VirtualMemoryAllocator() {
 #if defined(TI_PLATFORM_UNIX)
     if (munmap(ptr, size) != 0)
@@ -202,8 +202,8 @@ class ReplaceLocalVarWithStacks : public BasicStmtVisitor {
                          .empty();
     if (!load_only) {
       auto dtype = alloc->ret_type;
-      auto stack_alloca = Stmt::make<StackAllocaStmt>(
-          dtype, alloc->get_kernel()->program.config.ad_stack_size);
+      // The size is determined by determine_ad_stack_size later.
+      auto stack_alloca = Stmt::make<StackAllocaStmt>(dtype, 0);
       auto stack_alloca_ptr = stack_alloca.get();
 
       alloc->replace_with(std::move(stack_alloca));
@@ -818,6 +818,33 @@ class BackupSSA : public BasicStmtVisitor {
 
 namespace irpass {
 
+// Sizes each adstack by the number of pushes it can receive, falling back to
+// the configured size if the number is unknown at compile time, or too large
+// for a stack allocated per thread.
+void determine_ad_stack_size(IRNode *root, const CompileConfig &config) {
+  constexpr std::size_t max_inferred_size = 1 << 12;
+  auto bounds = irpass::analysis::bound_stack_pushes(root);
+  irpass::analysis::gather_statements(root, [&](Stmt *s) {
+    if (auto stack = s->cast<StackAllocaStmt>()) {
+      auto it = bounds.find(stack);
+      if (it != bounds.end() && it->second <= max_inferred_size) {
+        stack->max_size = std::max(it->second, std::size_t(1));
+        TI_TRACE("Adstack {} size inferred to be {}", stack->id,
+                 stack->max_size);
+      } else {
+        if (it != bounds.end()) {
+          TI_WARN(
+              "Adstack {} may receive {} pushes, more than the maximum "
+              "inferred size {}. Using ad_stack_size={} instead.",
+              stack->id, it->second, max_inferred_size, config.ad_stack_size);
+        }
+        stack->max_size = config.ad_stack_size;
+      }
+    }
+    return false;
+  });
+}
+
 void auto_diff(IRNode *root, bool use_stack) {
   TI_AUTO_PROF;
   if (use_stack) {
@@ -834,6 +861,7 @@ void auto_diff(IRNode *root, bool use_stack) {
       BackupSSA::run(ib);
       irpass::analysis::verify(root);
     }
+    determine_ad_stack_size(root, root->get_config());
   } else {
     auto IB = IdentifyIndependentBlocks::run(root);
     ReverseOuterLoops::run(root, IB);
@@ -120,9 +120,21 @@ void convert_to_range_for(OffloadedStmt *offloaded) {
   offloaded->task_type = TaskType::range_for;
 }
 
+bool has_custom_layout_on_path(SNode *snode) {
+  for (; snode; snode = snode->parent) {
+    if (snode->has_custom_layout())
+      return true;
+  }
+  return false;
+}
+
 void maybe_convert(OffloadedStmt *stmt) {
+  // The demoted loop recovers the indices from row-major bits, so Morton and
+  // tiled layouts keep their struct-fors, which visit the elements in memory
+  // order.
   if ((stmt->task_type == TaskType::struct_for) &&
-      stmt->snode->is_path_all_dense) {
+      stmt->snode->is_path_all_dense &&
+      !has_custom_layout_on_path(stmt->snode)) {
     convert_to_range_for(stmt);
   }
 }
@@ -339,9 +339,16 @@ class IRPrinter : public IRVisitor {
   }
 
   void visit(StructForStmt *for_stmt) override {
-    print("{} : struct for in {} (vectorize {}) {}{}{{", for_stmt->name(),
+    std::string bbox_info;
+    for (int i = 0; i < (int)for_stmt->bbox_lower.size(); i++) {
+      bbox_info += fmt::format("[{}, {})", for_stmt->bbox_lower[i]->name(),
+                               for_stmt->bbox_upper[i]->name());
+    }
+    if (!bbox_info.empty())
+      bbox_info = "bbox=" + bbox_info + " ";
+    print("{} : struct for in {} (vectorize {}) {}{}{}{{", for_stmt->name(),
           for_stmt->snode->get_node_type_name_hinted(), for_stmt->vectorize,
-          scratch_pad_info(for_stmt->scratch_opt),
+          bbox_info, scratch_pad_info(for_stmt->scratch_opt),
           block_dim_info(for_stmt->block_dim));
     for_stmt->body->accept(this);
     print("}}");
@@ -431,8 +438,16 @@ class IRPrinter : public IRVisitor {
         stmt->strides,
         [&](const int &stride) { return std::to_string(stride); }, "{");
 
-    print("{}{} = linearized(ind {}, stride {})", stmt->type_hint(),
-          stmt->name(), ind, stride);
+    if (stmt->bit_masks.empty()) {
+      print("{}{} = linearized(ind {}, stride {})", stmt->type_hint(),
+            stmt->name(), ind, stride);
+    } else {
+      auto masks = make_list<int>(
+          stmt->bit_masks,
+          [&](const int &mask) { return fmt::format("{:#x}", mask); }, "{");
+      print("{}{} = linearized(ind {}, bit_masks {})", stmt->type_hint(),
+            stmt->name(), ind, masks);
+    }
   }
 
   void visit(IntegerOffsetStmt *stmt) override {
@@ -446,7 +461,8 @@ class IRPrinter : public IRVisitor {
   }
 
   void visit(GetRootStmt *stmt) override {
-    print("{}{} = get root", stmt->type_hint(), stmt->name());
+    print("{}{} = get root [{}]", stmt->type_hint(), stmt->name(),
+          stmt->root->get_node_type_name_hinted());
   }
 
   void visit(SNodeLookupStmt *stmt) override {
@@ -508,9 +524,18 @@ class IRPrinter : public IRVisitor {
                       stmt->block_dim, scratch_pad_info(stmt->scratch_opt));
     }
     if (stmt->task_type == OffloadedTaskType::listgen) {
-      print("{} = offloaded listgen {}->{}", stmt->name(),
+      std::string bbox_info;
+      for (int i = 0; i < (int)stmt->bbox_indices.size(); i++) {
+        bbox_info += fmt::format(" {}:[tmp(offset={}B), tmp(offset={}B))",
+                                 stmt->bbox_indices[i],
+                                 stmt->bbox_lower_offsets[i],
+                                 stmt->bbox_upper_offsets[i]);
+      }
+      if (!bbox_info.empty())
+        bbox_info = " bbox" + bbox_info;
+      print("{} = offloaded listgen {}->{}{}", stmt->name(),
             stmt->snode->parent->get_node_type_name_hinted(),
-            stmt->snode->get_node_type_name_hinted());
+            stmt->snode->get_node_type_name_hinted(), bbox_info);
     } else if (stmt->task_type == OffloadedTaskType::gc) {
       print("{} = offloaded garbage collect {}", stmt->name(),
             stmt->snode->get_node_type_name_hinted());
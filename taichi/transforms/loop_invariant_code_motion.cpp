@@ -0,0 +1,277 @@
+#include "taichi/ir/ir.h"
+#include "taichi/ir/analysis.h"
+#include "taichi/ir/statements.h"
+#include "taichi/ir/transforms.h"
+#include "taichi/ir/visitors.h"
+#include "taichi/program/kernel.h"
+#include "taichi/util/statistics.h"
+
+TLANG_NAMESPACE_BEGIN
+
+// Collect the serial loops in post order, so that the statements hoisted out
+// of an inner loop can be hoisted further out of the outer ones.
+class GatherSerialLoops : public BasicStmtVisitor {
+ public:
+  using BasicStmtVisitor::visit;
+  std::vector<Stmt *> loops;
+
+  GatherSerialLoops() {
+    allow_undefined_visitor = true;
+    invoke_default_visitor = false;
+  }
+
+  static bool is_serial(Stmt *loop) {
+    // Before offloading, the loops at the top level of the kernel are the
+    // parallel ones
+    return loop->parent->parent_stmt != nullptr;
+  }
+
+  void visit(RangeForStmt *stmt) override {
+    stmt->body->accept(this);
+    if (is_serial(stmt))
+      loops.push_back(stmt);
+  }
+
+  void visit(WhileStmt *stmt) override {
+    stmt->body->accept(this);
+    if (is_serial(stmt))
+      loops.push_back(stmt);
+  }
+
+  static std::vector<Stmt *> run(IRNode *root) {
+    GatherSerialLoops gather;
+    root->accept(&gather);
+    return gather.loops;
+  }
+};
+
+// Loop-invariant code motion for serial RangeForStmts and WhileStmts.
+// A statement at the top level of a loop body is hoisted when all its operands
+// are defined outside the loop, and it is either free of side effects and
+// traps (arithmetic, address computation), or it reads memory that the loop
+// does not modify and is executed in the first iteration anyway. The latter
+// covers SNode lookups and GlobalLoadStmts, which must not be hoisted when the
+// loop activates or deactivates SNodes (see flag_access), or stores to an
+// address that may alias (see alias_analysis). Since a RangeForStmt may run
+// zero iterations, such statements are hoisted into a guard
+//   if (begin < end) { <hoisted statements> <loop> }
+class LoopInvariantCodeMotion {
+ private:
+  enum class HoistKind { none, speculatable, needs_execution };
+
+  Stmt *loop;
+  Block *body;
+  // Whether the loop contains statements that change the sparse structure or
+  // write to unknown memory
+  bool changes_structure;
+  bool has_opaque_calls;
+  std::vector<Stmt *> store_destinations;
+  std::unordered_set<Stmt *> hoisted;
+
+  explicit LoopInvariantCodeMotion(Stmt *loop)
+      : loop(loop), changes_structure(false), has_opaque_calls(false) {
+    if (auto range_for = loop->cast<RangeForStmt>()) {
+      body = range_for->body.get();
+    } else {
+      body = loop->as<WhileStmt>()->body.get();
+    }
+    auto stmts = irpass::analysis::gather_statements(
+        body, [](Stmt *) { return true; });
+    for (auto stmt : stmts) {
+      if (stmt->is<SNodeOpStmt>()) {
+        changes_structure = true;
+      } else if (auto ptr = stmt->cast<GlobalPtrStmt>()) {
+        if (ptr->activate)
+          changes_structure = true;
+      } else if (auto lookup = stmt->cast<SNodeLookupStmt>()) {
+        if (lookup->activate)
+          changes_structure = true;
+      } else if (stmt->is<ExternalFuncCallStmt>()) {
+        has_opaque_calls = true;
+      }
+      for (auto dest : irpass::analysis::get_store_destination(stmt)) {
+        if (!dest->is<AllocaStmt>())
+          store_destinations.push_back(dest);
+      }
+    }
+  }
+
+  bool defined_in_loop(Stmt *stmt) const {
+    for (auto block = stmt->parent; block != nullptr;) {
+      if (block->parent_stmt == loop)
+        return true;
+      if (block->parent_stmt == nullptr)
+        break;
+      block = block->parent_stmt->parent;
+    }
+    return false;
+  }
+
+  bool is_invariant(Stmt *stmt) const {
+    for (auto op : stmt->get_operands()) {
+      if (op != nullptr && defined_in_loop(op) &&
+          hoisted.find(op) == hoisted.end())
+        return false;
+    }
+    return true;
+  }
+
+  bool may_be_written(Stmt *ptr) const {
+    if (changes_structure || has_opaque_calls)
+      return true;
+    for (auto dest : store_destinations) {
+      if (irpass::analysis::maybe_same_address(ptr, dest))
+        return true;
+    }
+    return false;
+  }
+
+  HoistKind classify(Stmt *stmt) const {
+    if (stmt->is_container_statement() || stmt->width() != 1)
+      return HoistKind::none;
+    if (stmt->is<ConstStmt>() || stmt->is<UnaryOpStmt>() ||
+        stmt->is<TernaryOpStmt>() || stmt->is<ArgLoadStmt>() ||
+        stmt->is<GetRootStmt>() || stmt->is<GetChStmt>() ||
+        stmt->is<BitExtractStmt>() || stmt->is<LinearizeStmt>() ||
+        stmt->is<IntegerOffsetStmt>() || stmt->is<ExternalPtrStmt>() ||
+        stmt->is<GlobalTemporaryStmt>() || stmt->is<ThreadLocalPtrStmt>() ||
+        stmt->is<BlockLocalPtrStmt>()) {
+      return HoistKind::speculatable;
+    }
+    if (auto bin = stmt->cast<BinaryOpStmt>()) {
+      bool may_trap = (bin->op_type == BinaryOpType::div ||
+                       bin->op_type == BinaryOpType::floordiv ||
+                       bin->op_type == BinaryOpType::mod) &&
+                      is_integral(bin->rhs->element_type());
+      return may_trap ? HoistKind::needs_execution : HoistKind::speculatable;
+    }
+    // Lookups of inactive nodes return the ambient element, so they may only
+    // be reused while nothing is (de)activated.
+    if (auto ptr = stmt->cast<GlobalPtrStmt>()) {
+      return ptr->activate || changes_structure ? HoistKind::none
+                                                : HoistKind::needs_execution;
+    }
+    if (auto lookup = stmt->cast<SNodeLookupStmt>()) {
+      return lookup->activate || changes_structure
+                 ? HoistKind::none
+                 : HoistKind::needs_execution;
+    }
+    if (auto load = stmt->cast<GlobalLoadStmt>()) {
+      return may_be_written(load->ptr) ? HoistKind::none
+                                       : HoistKind::needs_execution;
+    }
+    return HoistKind::none;
+  }
+
+  // Statements that may skip the rest of the iteration. Failing assertions
+  // stop the kernel, so the statements after them may not run either.
+  static bool may_end_iteration(Stmt *stmt) {
+    auto test = [](Stmt *s) {
+      return s->is<ContinueStmt>() || s->is<WhileControlStmt>() ||
+             s->is<AssertStmt>();
+    };
+    return test(stmt) ||
+           (stmt->is_container_statement() &&
+            !irpass::analysis::gather_statements(stmt, test).empty());
+  }
+
+  // Whether the RangeForStmt runs at least one iteration, or is already
+  // guarded by a previous run
+  static bool runs_at_least_once(RangeForStmt *range_for) {
+    auto begin = range_for->begin->cast<ConstStmt>();
+    auto end = range_for->end->cast<ConstStmt>();
+    if (begin && end && is_integral(begin->element_type()) &&
+        is_integral(end->element_type()) &&
+        begin->val[0].val_int() < end->val[0].val_int()) {
+      return true;
+    }
+    auto parent = range_for->parent;
+    if (auto guard = parent->parent_stmt ? parent->parent_stmt->cast<IfStmt>()
+                                         : nullptr) {
+      if (auto cond = guard->cond->cast<BinaryOpStmt>()) {
+        return parent == guard->true_statements.get() &&
+               cond->op_type == BinaryOpType::cmp_lt &&
+               cond->lhs == range_for->begin && cond->rhs == range_for->end;
+      }
+    }
+    return false;
+  }
+
+  void guard(RangeForStmt *range_for) {
+    auto parent = range_for->parent;
+    int location = parent->locate(range_for);
+    auto cond = Stmt::make<BinaryOpStmt>(BinaryOpType::cmp_lt,
+                                         range_for->begin, range_for->end);
+    cond->ret_type = LegacyVectorType(1, PrimitiveType::i32);
+    auto if_stmt = Stmt::make_typed<IfStmt>(cond.get());
+    auto true_statements = std::make_unique<Block>();
+    true_statements->insert(parent->extract(location));
+    if_stmt->set_true_statements(std::move(true_statements));
+    parent->insert(std::move(cond), location);
+    parent->insert(std::move(if_stmt), location + 1);
+  }
+
+  std::vector<Stmt *> hoist() {
+    std::vector<Stmt *> to_hoist;
+    bool executed_in_first_iteration = true;
+    bool needs_guard = false;
+    for (auto &owned : body->statements) {
+      auto stmt = owned.get();
+      auto kind = classify(stmt);
+      if (kind != HoistKind::none && is_invariant(stmt) &&
+          (kind == HoistKind::speculatable || executed_in_first_iteration)) {
+        to_hoist.push_back(stmt);
+        hoisted.insert(stmt);
+        if (kind == HoistKind::needs_execution)
+          needs_guard = true;
+      }
+      if (may_end_iteration(stmt))
+        executed_in_first_iteration = false;
+    }
+    if (to_hoist.empty())
+      return to_hoist;
+
+    // The body of a WhileStmt always runs at least once.
+    if (auto range_for = loop->cast<RangeForStmt>()) {
+      if (needs_guard && !runs_at_least_once(range_for))
+        guard(range_for);
+    }
+    auto parent = loop->parent;
+    int location = parent->locate(loop);
+    for (auto stmt : to_hoist) {
+      parent->insert(body->extract(stmt), location++);
+    }
+    return to_hoist;
+  }
+
+ public:
+  static int run(IRNode *root) {
+    int num_hoisted = 0;
+    for (auto loop : GatherSerialLoops::run(root)) {
+      LoopInvariantCodeMotion licm(loop);
+      num_hoisted += (int)licm.hoist().size();
+    }
+    return num_hoisted;
+  }
+};
+
+namespace irpass {
+
+bool loop_invariant_code_motion(IRNode *root) {
+  TI_AUTO_PROF;
+  // The adjoint loops generated by auto_diff rely on the primal loop bodies
+  // being left in place
+  if (root->get_kernel()->grad)
+    return false;
+  int num_hoisted = LoopInvariantCodeMotion::run(root);
+  if (num_hoisted == 0)
+    return false;
+  stat.add("licm_hoisted_statements", num_hoisted);
+  TI_DEBUG("[{}] {} loop-invariant statements hoisted",
+           root->get_kernel()->name, num_hoisted);
+  return true;
+}
+
+}  // namespace irpass
+
+TLANG_NAMESPACE_END
@@ -6,6 +6,7 @@
 #include "taichi/program/kernel.h"
 #include "taichi/program/program.h"
 
+#include <cstdlib>
 #include <deque>
 #include <set>
 
@@ -18,12 +19,14 @@ class LowerAccess : public IRVisitor {
  public:
   DelayedIRModifier modifier;
   StructForStmt *current_struct_for;
+  OffloadedStmt *current_struct_for_task;
   bool lower_atomic_ptr;
 
   LowerAccess(bool lower_atomic_ptr) : lower_atomic_ptr(lower_atomic_ptr) {
     // TODO: change this to false
     allow_undefined_visitor = true;
     current_struct_for = nullptr;
+    current_struct_for_task = nullptr;
   }
 
   void visit(Block *stmt_list) override {
@@ -41,7 +44,10 @@ class LowerAccess : public IRVisitor {
   }
 
   void visit(OffloadedStmt *stmt) override {
+    if (stmt->task_type == OffloadedStmt::TaskType::struct_for)
+      current_struct_for_task = stmt;
     stmt->all_blocks_accept(this);
+    current_struct_for_task = nullptr;
   }
 
   void visit(WhileStmt *stmt) override {
@@ -58,12 +64,15 @@ class LowerAccess : public IRVisitor {
     current_struct_for = nullptr;
   }
 
+  // If |block_ptr| is given, it points to the parent of |leaf_snode| that
+  // contains the element, and only the last level is looked up.
   void lower_scalar_ptr(VecStatement &lowered,
                         SNode *leaf_snode,
                         std::vector<Stmt *> indices,
                         bool pointer_needs_activation,
                         Kernel *kernel,
-                        SNodeOpType snode_op = SNodeOpType::undefined) {
+                        SNodeOpType snode_op = SNodeOpType::undefined,
+                        Stmt *block_ptr = nullptr) {
     if (snode_op == SNodeOpType::is_active) {
       // For ti.is_active
       TI_ASSERT(!pointer_needs_activation);
@@ -81,7 +90,8 @@ class LowerAccess : public IRVisitor {
     for (auto s = leaf_snode; s != nullptr; s = s->parent)
       snodes.push_front(s);
 
-    Stmt *last = lowered.push_back<GetRootStmt>();
+    Stmt *last =
+        block_ptr ? block_ptr : lowered.push_back<GetRootStmt>(snodes[0]);
 
     const auto &offsets = snodes.back()->index_offsets;
     if (!offsets.empty()) {
@@ -95,10 +105,13 @@ class LowerAccess : public IRVisitor {
     }
 
     int path_inc = int(snode_op != SNodeOpType::undefined);
-    for (int i = 0; i < (int)snodes.size() - 1 + path_inc; i++) {
+    int first_level = block_ptr ? (int)snodes.size() - 2 : 0;
+    for (int i = first_level; i < (int)snodes.size() - 1 + path_inc; i++) {
       auto snode = snodes[i];
       std::vector<Stmt *> lowered_indices;
       std::vector<int> strides;
+      std::vector<int> bit_masks;
+      auto layout_masks = snode->get_index_bit_masks();
       // extract bits
       for (int k_ = 0; k_ < (int)indices.size(); k_++) {
         for (int k = 0; k < taichi_max_num_indices; k++) {
@@ -110,6 +123,8 @@ class LowerAccess : public IRVisitor {
             lowered_indices.push_back(extracted.get());
             lowered.push_back(std::move(extracted));
             strides.push_back(1 << snode->extractors[k].num_bits);
+            if (!layout_masks.empty())
+              bit_masks.push_back((int)layout_masks[k]);
           }
         }
       }
@@ -136,8 +151,8 @@ class LowerAccess : public IRVisitor {
       }
 
       // linearize
-      auto linearized =
-          lowered.push_back<LinearizeStmt>(lowered_indices, strides);
+      auto linearized = lowered.push_back<LinearizeStmt>(lowered_indices,
+                                                         strides, bit_masks);
 
       if (snode_op != SNodeOpType::undefined && i == (int)snodes.size() - 1) {
         // Create a SNodeOp querying if element i(linearized) of node is active
@@ -188,8 +203,120 @@ class LowerAccess : public IRVisitor {
     return lowered;
   }
 
+  bool in_body_of(Stmt *stmt, OffloadedStmt *task) {
+    for (auto block = stmt->parent; block->parent_stmt != nullptr;
+         block = block->parent_stmt->parent) {
+      if (block->parent_stmt == task)
+        return block == task->body.get();
+    }
+    return false;
+  }
+
+  // In a struct-for over the blocks of a sparse field, a stencil access such
+  // as x[i + 1, j] mostly falls into the same block as x[i, j]. Such loads are
+  // lowered into
+  //   if (the indices of all ancestors of the block are those of x[i, j])
+  //     look up only the last level, starting from the block of x[i, j]
+  //   else
+  //     look up the full root-to-leaf path
+  // The block of x[i, j] is computed outside the branch, so that CSE shares
+  // its sparse lookups among all the neighbors. Returns false if |stmt| is not
+  // such a load.
+  bool lower_neighbor_load(GlobalLoadStmt *stmt, GlobalPtrStmt *ptr) {
+    auto task = current_struct_for_task;
+    if (task == nullptr || ptr->width() != 1 ||
+        !ptr->get_config().reuse_neighbor_lookups)
+      return false;
+    auto leaf = ptr->snodes[0];
+    auto block = leaf->parent;
+    if (block != task->snode || (block->type != SNodeType::dense &&
+                                 block->type != SNodeType::bitmasked))
+      return false;
+    // Lookups of dense ancestors are arithmetic only, which is cheaper than
+    // the branch
+    SNode *root = block->parent;
+    bool has_sparse_ancestor = false;
+    for (; root->parent != nullptr; root = root->parent) {
+      if (root->type != SNodeType::dense)
+        has_sparse_ancestor = true;
+    }
+    if (!has_sparse_ancestor || !in_body_of(stmt, task) ||
+        (int)ptr->indices.size() != block->num_active_indices)
+      return false;
+    auto kernel = ptr->get_kernel();
+
+    VecStatement lowered;
+    std::vector<Stmt *> loop_indices;
+    Stmt *same_block = nullptr;
+    for (int k_ = 0; k_ < (int)ptr->indices.size(); k_++) {
+      int k = block->physical_index_position[k_];
+      auto diff =
+          irpass::analysis::value_diff_loop_index(ptr->indices[k_], task, k);
+      if (!diff.linear_related() || !diff.certain())
+        return false;
+      auto loop_index = lowered.push_back<LoopIndexStmt>(task, k);
+      loop_index->ret_type = PrimitiveType::i32;
+      loop_indices.push_back(loop_index);
+
+      // The ancestors of the block extract the bits [begin, end) of the index
+      int begin = block->extractors[k].start + block->extractors[k].num_bits;
+      int end = root->extractors[k].start;
+      int offset = leaf->index_offsets.empty() ? 0 : leaf->index_offsets[k_];
+      // |delta| is the distance from the element visited by the struct-for
+      int delta = diff.low - offset;
+      if (std::abs(delta) >= (1 << begin))
+        return false;
+      if (delta == 0 || begin >= end)
+        continue;
+      auto index = ptr->indices[k_];
+      if (offset != 0) {
+        auto offset_stmt = lowered.push_back<ConstStmt>(TypedConstant(offset));
+        index = lowered.push_back<BinaryOpStmt>(BinaryOpType::sub, index,
+                                                offset_stmt);
+      }
+      auto bits = lowered.push_back<BitExtractStmt>(index, begin, end);
+      auto loop_bits =
+          lowered.push_back<BitExtractStmt>(loop_index, begin, end);
+      auto same = lowered.push_back<BinaryOpStmt>(BinaryOpType::cmp_eq, bits,
+                                                  loop_bits);
+      same_block = same_block ? lowered.push_back<BinaryOpStmt>(
+                                    BinaryOpType::bit_and, same_block, same)
+                              : same;
+    }
+    lower_scalar_ptr(lowered, block, loop_indices, false, kernel);
+    auto block_ptr = lowered.back().get();
+    if (same_block == nullptr) {
+      // The access is always in the block, e.g. x[i, j] itself
+      lower_scalar_ptr(lowered, leaf, ptr->indices, false, kernel,
+                       SNodeOpType::undefined, block_ptr);
+      stmt->ptr = lowered.back().get();
+      modifier.insert_before(stmt, std::move(lowered));
+      return true;
+    }
+
+    auto result = lowered.push_back<AllocaStmt>(leaf->dt);
+    auto load_into_result = [&](Stmt *start) {
+      VecStatement branch;
+      lower_scalar_ptr(branch, leaf, ptr->indices, false, kernel,
+                       SNodeOpType::undefined, start);
+      auto load = branch.push_back<GlobalLoadStmt>(branch.back().get());
+      branch.push_back<LocalStoreStmt>(result, load);
+      auto body = std::make_unique<Block>();
+      body->insert(std::move(branch));
+      return body;
+    };
+    auto if_stmt = lowered.push_back<IfStmt>(same_block);
+    if_stmt->set_true_statements(load_into_result(block_ptr));
+    if_stmt->set_false_statements(load_into_result(nullptr));
+    lowered.push_back<LocalLoadStmt>(LocalAddress(result, 0));
+    modifier.replace_with(stmt, std::move(lowered));
+    return true;
+  }
+
   void visit(GlobalLoadStmt *stmt) override {
     if (stmt->ptr->is<GlobalPtrStmt>()) {
+      if (lower_neighbor_load(stmt, stmt->ptr->as<GlobalPtrStmt>()))
+        return;
       // No need to activate for all read accesses
       auto lowered = lower_vector_ptr(stmt->ptr->as<GlobalPtrStmt>(), false);
       stmt->ptr = lowered.back().get();
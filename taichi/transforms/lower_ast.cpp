@@ -280,11 +280,37 @@ class LowerAST : public IRVisitor {
         offsets = snode->index_offsets;
         snode = snode->parent;
       }
+      // The bounding box, if any, in the coordinates of the loop indices and
+      // in physical coordinates
+      std::vector<Stmt *> bbox_lower, bbox_upper;
+      std::vector<Stmt *> physical_lower, physical_upper;
+      if (!stmt->bbox_lower.empty()) {
+        TI_ASSERT(stmt->bbox_lower.size() == stmt->loop_var_id.size());
+        TI_ASSERT(stmt->bbox_upper.size() == stmt->loop_var_id.size());
+        for (int i = 0; i < (int)stmt->loop_var_id.size(); i++) {
+          stmt->bbox_lower[i]->flatten(&fctx);
+          bbox_lower.push_back(stmt->bbox_lower[i]->stmt);
+          stmt->bbox_upper[i]->flatten(&fctx);
+          bbox_upper.push_back(stmt->bbox_upper[i]->stmt);
+          if ((int)offsets.size() > i && offsets[i] != 0) {
+            auto offset_const =
+                fctx.push_back<ConstStmt>(TypedConstant(offsets[i]));
+            physical_lower.push_back(fctx.push_back<BinaryOpStmt>(
+                BinaryOpType::sub, bbox_lower[i], offset_const));
+            physical_upper.push_back(fctx.push_back<BinaryOpStmt>(
+                BinaryOpType::sub, bbox_upper[i], offset_const));
+          } else {
+            physical_lower.push_back(bbox_lower[i]);
+            physical_upper.push_back(bbox_upper[i]);
+          }
+        }
+      }
       auto &&new_for = std::make_unique<StructForStmt>(
           snode, std::move(stmt->body), stmt->vectorize, stmt->parallelize,
-          stmt->block_dim);
+          stmt->block_dim, physical_lower, physical_upper);
       new_for->index_offsets = offsets;
       VecStatement new_statements;
+      Stmt *outside_bbox = nullptr;
       for (int i = 0; i < (int)stmt->loop_var_id.size(); i++) {
         Stmt *loop_index = new_statements.push_back<LoopIndexStmt>(
             new_for.get(), snode->physical_index_position[i]);
@@ -296,6 +322,27 @@ class LowerAST : public IRVisitor {
           loop_index = result;
         }
         new_for->body->local_var_to_stmt[stmt->loop_var_id[i]] = loop_index;
+        if (!bbox_lower.empty()) {
+          auto below = new_statements.push_back<BinaryOpStmt>(
+              BinaryOpType::cmp_lt, loop_index, bbox_lower[i]);
+          auto above = new_statements.push_back<BinaryOpStmt>(
+              BinaryOpType::cmp_ge, loop_index, bbox_upper[i]);
+          auto outside = new_statements.push_back<BinaryOpStmt>(
+              BinaryOpType::bit_or, below, above);
+          if (outside_bbox) {
+            outside = new_statements.push_back<BinaryOpStmt>(
+                BinaryOpType::bit_or, outside_bbox, outside);
+          }
+          outside_bbox = outside;
+        }
+      }
+      if (outside_bbox) {
+        // Skip the elements outside the box, in the parent cells that
+        // intersect it
+        auto skip = std::make_unique<Block>();
+        skip->insert(Stmt::make<ContinueStmt>());
+        auto if_stmt = new_statements.push_back<IfStmt>(outside_bbox);
+        if_stmt->set_true_statements(std::move(skip));
       }
       new_for->body->insert(std::move(new_statements), 0);
       new_for->scratch_opt = stmt->scratch_opt;
@@ -16,6 +16,7 @@ void make_block_local_offload(OffloadedStmt *offload) {
     return;
 
   bool debug = offload->get_kernel()->program.config.debug;
+  auto arch = offload->get_kernel()->arch;
 
   auto pads = irpass::initialize_scratch_pad(offload);
 
@@ -67,6 +68,73 @@ void make_block_local_offload(OffloadedStmt *offload) {
             block = std::make_unique<Block>();
             block->parent_stmt = offload;
           }
+          // Emits the fetch/store of BLS element |bls_element_id| into
+          // |element_block|.
+          auto emit_element = [&](Block *element_block,
+                                  Stmt *bls_element_id) {
+            auto bls_element_offset_bytes =
+                element_block->push_back<BinaryOpStmt>(
+                    BinaryOpType::mul, bls_element_id,
+                    element_block->push_back<ConstStmt>(
+                        TypedConstant(dtype_size)));
+
+            bls_element_offset_bytes = element_block->push_back<BinaryOpStmt>(
+                BinaryOpType::add, bls_element_offset_bytes,
+                element_block->push_back<ConstStmt>(
+                    TypedConstant((int32)bls_offset)));
+
+            std::vector<Stmt *> global_indices(dim);
+
+            // Convert bls_element_id to global indices
+            // via a series of % and /.
+            auto bls_element_id_partial = bls_element_id;
+            for (int i = dim - 1; i >= 0; i--) {
+              auto size = element_block->push_back<ConstStmt>(
+                  TypedConstant(pad.second.pad_size[i]));
+
+              auto bls_coord = element_block->push_back<BinaryOpStmt>(
+                  BinaryOpType::mod, bls_element_id_partial, size);
+              bls_element_id_partial = element_block->push_back<BinaryOpStmt>(
+                  BinaryOpType::div, bls_element_id_partial, size);
+
+              auto global_index = element_block->push_back<BinaryOpStmt>(
+                  BinaryOpType::add,
+                  element_block->push_back<ConstStmt>(
+                      TypedConstant(pad.second.bounds[0][i])),
+                  bls_coord);
+
+              global_index = element_block->push_back<BinaryOpStmt>(
+                  BinaryOpType::add, global_index,
+                  element_block->push_back<BlockCornerIndexStmt>(offload, i));
+
+              global_indices[i] = global_index;
+            }
+
+            operation(element_block, global_indices, bls_element_offset_bytes);
+            // TODO: do not use GlobalStore for BLS ptr.
+          };
+
+          if (arch_is_cpu(arch)) {
+            /*
+            On CPUs a whole block is processed by a single thread, which owns
+            the BLS buffer. Instead of a block-stride loop, simply loop over
+            all BLS elements:
+
+            for (bls_element_id = 0; bls_element_id < bls_size; ...)
+              bls[bls_element_id] = x[bls_to_global(bls_element_id)]
+            */
+            auto loop = block->push_back<RangeForStmt>(
+                block->push_back<ConstStmt>(TypedConstant(0)),
+                block->push_back<ConstStmt>(TypedConstant(bls_num_elements)),
+                std::make_unique<Block>(), /*vectorize=*/1,
+                /*parallelize=*/0, /*block_dim=*/1,
+                /*strictly_serialized=*/true);
+            auto loop_body = loop->as<RangeForStmt>()->body.get();
+            emit_element(loop_body,
+                         loop_body->push_back<LoopIndexStmt>(loop, 0));
+            return;
+          }
+
           Stmt *block_linear_index =
               block->push_back<LoopLinearIndexStmt>(offload);
 
@@ -99,14 +167,6 @@ void make_block_local_offload(OffloadedStmt *offload) {
             auto bls_element_id_this_iteration = block->push_back<BinaryOpStmt>(
                 BinaryOpType::add, loop_offset_stmt, block_linear_index);
 
-            auto bls_element_offset_bytes = block->push_back<BinaryOpStmt>(
-                BinaryOpType::mul, bls_element_id_this_iteration,
-                block->push_back<ConstStmt>(TypedConstant(dtype_size)));
-
-            bls_element_offset_bytes = block->push_back<BinaryOpStmt>(
-                BinaryOpType::add, bls_element_offset_bytes,
-                block->push_back<ConstStmt>(TypedConstant((int32)bls_offset)));
-
             if (loop_offset + block_dim > bls_num_elements) {
               // Need to create an IfStmt to safeguard since bls size may not be
               // a multiple of block_size, and this iteration some threads may
@@ -124,35 +184,7 @@ void make_block_local_offload(OffloadedStmt *offload) {
               element_block = block.get();
             }
 
-            std::vector<Stmt *> global_indices(dim);
-
-            // Convert bls_element_id to global indices
-            // via a series of % and /.
-            auto bls_element_id_partial = bls_element_id_this_iteration;
-            for (int i = dim - 1; i >= 0; i--) {
-              auto size = element_block->push_back<ConstStmt>(
-                  TypedConstant(pad.second.pad_size[i]));
-
-              auto bls_coord = element_block->push_back<BinaryOpStmt>(
-                  BinaryOpType::mod, bls_element_id_partial, size);
-              bls_element_id_partial = element_block->push_back<BinaryOpStmt>(
-                  BinaryOpType::div, bls_element_id_partial, size);
-
-              auto global_index = element_block->push_back<BinaryOpStmt>(
-                  BinaryOpType::add,
-                  element_block->push_back<ConstStmt>(
-                      TypedConstant(pad.second.bounds[0][i])),
-                  bls_coord);
-
-              global_index = element_block->push_back<BinaryOpStmt>(
-                  BinaryOpType::add, global_index,
-                  element_block->push_back<BlockCornerIndexStmt>(offload, i));
-
-              global_indices[i] = global_index;
-            }
-
-            operation(element_block, global_indices, bls_element_offset_bytes);
-            // TODO: do not use GlobalStore for BLS ptr.
+            emit_element(element_block, bls_element_id_this_iteration);
 
             loop_offset += block_dim;
           }
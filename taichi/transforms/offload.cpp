@@ -21,6 +21,13 @@ struct OffloadedRanges {
   using Map = std::unordered_map<const OffloadedStmt *, Stmt *>;
   Map begin_stmts;
   Map end_stmts;
+
+  // The bounding box of a bounded struct-for, for each of its listgens
+  struct BoundingBox {
+    std::vector<int> indices;
+    std::vector<Stmt *> lower, upper;
+  };
+  std::unordered_map<const OffloadedStmt *, BoundingBox> bboxes;
 };
 
 // Break kernel into multiple parts and emit struct for listgens
@@ -81,6 +88,7 @@ class Offloader {
         offloaded->num_cpu_threads =
             std::min(s->parallelize,
                      root->get_kernel()->program.config.cpu_max_num_threads);
+        offloaded->reversed = s->reversed;
         replace_all_usages_with(s, s, offloaded.get());
         for (int j = 0; j < (int)s->body->statements.size(); j++) {
           offloaded->body->insert(std::move(s->body->statements[j]));
@@ -88,7 +96,7 @@ class Offloader {
         root_block->insert(std::move(offloaded));
       } else if (auto s = stmt->cast<StructForStmt>()) {
         assemble_serial_statements();
-        emit_struct_for(s, root_block, s->scratch_opt);
+        emit_struct_for(s, root_block, s->scratch_opt, &offloaded_ranges);
       } else {
         pending_serial_statements->body->insert(std::move(stmt));
       }
@@ -100,7 +108,8 @@ class Offloader {
  private:
   static void emit_struct_for(StructForStmt *for_stmt,
                               Block *root_block,
-                              const ScratchPadOptions &scratch_opt) {
+                              const ScratchPadOptions &scratch_opt,
+                              OffloadedRanges *offloaded_ranges) {
     auto leaf = for_stmt->snode;
     // make a list of nodes, from the leaf block (instead of 'place') to root
     std::vector<SNode *> path;
@@ -139,6 +148,17 @@ class Offloader {
             std::min(snode_child->max_num_elements(),
                      std::min(program->default_block_dim(),
                               program->config.max_block_dim));
+        // The only cell of the root always intersects the bounding box
+        if (!for_stmt->bbox_lower.empty() &&
+            snode_child->parent->type != SNodeType::root) {
+          OffloadedRanges::BoundingBox bbox;
+          for (int j = 0; j < (int)for_stmt->bbox_lower.size(); j++) {
+            bbox.indices.push_back(leaf->physical_index_position[j]);
+          }
+          bbox.lower = for_stmt->bbox_lower;
+          bbox.upper = for_stmt->bbox_upper;
+          offloaded_ranges->bboxes[offloaded_listgen.get()] = bbox;
+        }
         root_block->insert(std::move(offloaded_listgen));
       }
     }
@@ -277,6 +297,17 @@ class IdentifyValuesUsedInOtherOffloads : public BasicStmtVisitor {
         end != offloaded_ranges_->end_stmts.end()) {
       test_and_allocate(end->second);
     }
+    if (auto bbox = offloaded_ranges_->bboxes.find(stmt);
+        bbox != offloaded_ranges_->bboxes.end()) {
+      // Listgens read all the bounds from the global temporaries, including
+      // constant ones
+      for (auto bounds : {&bbox->second.lower, &bbox->second.upper}) {
+        for (auto bound : *bounds) {
+          if (local_to_global.find(bound) == local_to_global.end())
+            local_to_global[bound] = allocate_global(bound->ret_type);
+        }
+      }
+    }
     if (stmt->body)
       stmt->body->accept(this);
     current_offloaded = nullptr;
@@ -404,6 +435,20 @@ class FixCrossOffloadReferences : public BasicStmtVisitor {
         stmt->end_offset =
             local_to_global_offset[offloaded_ranges_->end_stmts.find(stmt)
                                        ->second];
+    } else if (stmt->task_type == OffloadedStmt::TaskType::listgen) {
+      if (auto bbox = offloaded_ranges_->bboxes.find(stmt);
+          bbox != offloaded_ranges_->bboxes.end()) {
+        // This may be visited again after the IR is modified
+        stmt->bbox_indices = bbox->second.indices;
+        stmt->bbox_lower_offsets.clear();
+        stmt->bbox_upper_offsets.clear();
+        for (int i = 0; i < (int)stmt->bbox_indices.size(); i++) {
+          stmt->bbox_lower_offsets.push_back(
+              local_to_global_offset[bbox->second.lower[i]]);
+          stmt->bbox_upper_offsets.push_back(
+              local_to_global_offset[bbox->second.upper[i]]);
+        }
+      }
     }
   }
 
@@ -247,6 +247,10 @@ class BasicBlockSimplify : public IRVisitor {
   }
 
   void visit(LinearizeStmt *stmt) override {
+    if (!stmt->bit_masks.empty()) {
+      // Bit interleaving is left to the backend
+      return;
+    }
     if (!stmt->inputs.empty() && stmt->inputs.back()->is<IntegerOffsetStmt>()) {
       auto previous_offset = stmt->inputs.back()->as<IntegerOffsetStmt>();
       // push forward offset
@@ -613,6 +617,10 @@ void full_simplify(IRNode *root, bool after_lower_access, Kernel *kernel) {
       // not modified.
       if ((first_iteration || modified) && whole_kernel_cse(root))
         modified = true;
+      if ((first_iteration || modified) && loop_invariant_code_motion(root))
+        modified = true;
+      if ((first_iteration || modified) && strength_reduce_indices(root))
+        modified = true;
       if ((first_iteration || modified) &&
           cfg_optimization(root, after_lower_access))
         modified = true;
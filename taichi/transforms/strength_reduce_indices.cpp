@@ -0,0 +1,295 @@
+#include <array>
+#include <optional>
+
+#include "taichi/ir/ir.h"
+#include "taichi/ir/analysis.h"
+#include "taichi/ir/statements.h"
+#include "taichi/ir/transforms.h"
+#include "taichi/program/kernel.h"
+#include "taichi/util/statistics.h"
+
+TLANG_NAMESPACE_BEGIN
+
+namespace {
+
+// An i32 value whose bits are bits of a single loop index: bit d of the value
+// is bit |bits[d]| of the index, or zero if |bits[d]| is -1. The sign bit is
+// always zero.
+struct IndexBits {
+  static constexpr int num_bits = 31;
+
+  // The loop index, or nullptr if the value is zero
+  Stmt *loop{nullptr};
+  int index{0};
+  std::array<int, num_bits> bits;
+
+  IndexBits() {
+    bits.fill(-1);
+  }
+
+  bool is_zero() const {
+    for (auto b : bits) {
+      if (b != -1)
+        return false;
+    }
+    return true;
+  }
+
+  // Whether the value is BitExtract(index, |begin|, |begin| + |size|)
+  bool is_bit_extract(int &begin, int &size) const {
+    size = 0;
+    while (size < num_bits && bits[size] != -1) {
+      if (bits[size] != bits[0] + size)
+        return false;
+      size++;
+    }
+    for (int d = size; d < num_bits; d++) {
+      if (bits[d] != -1)
+        return false;
+    }
+    begin = bits[0];
+    return size > 0;
+  }
+};
+
+// Strength reduction of the index arithmetic derived from loop indices.
+// demote_dense_struct_fors splits the loop index of a dense struct-for into
+// the coordinates of each SNode index (BitExtract, mul), and lower_access
+// splits the coordinates again and linearizes them (BitExtract, Linearize)
+// for each level of the SNode path. When the coordinates are accessed at the
+// loop index, this is an identity on the bits of the loop index, and the
+// whole chain is replaced with a single BitExtract of the loop index, which
+// simplify() then drops. The address of the element is then affine in the
+// loop index, so that the backend compiler can strength-reduce it to a
+// pointer increment across iterations. The same applies to nested range-fors
+// over power-of-two ranges, e.g. x[i, j] in a dense field of the same shape.
+//
+// The bits of each integer value are tracked through BitExtract, mul and shl
+// by a power of two, shr, sar and bit_and by a constant, and add and bit_or of
+// values with disjoint bits, starting from loop indices with a known number
+// of bits (see LoopIndexStmt::max_num_bits). Values that cannot be tracked,
+// such as x[i + 1], are left alone.
+class StrengthReduceIndices {
+ private:
+  std::unordered_map<Stmt *, std::optional<IndexBits>> cache;
+  DelayedIRModifier modifier;
+  int num_reduced{0};
+
+  static std::optional<int64> get_const(Stmt *stmt) {
+    auto c = stmt->cast<ConstStmt>();
+    if (!c || c->width() != 1 || c->ret_type != PrimitiveType::i32)
+      return std::nullopt;
+    return c->val[0].val_int();
+  }
+
+  // The number of bits of a loop index that is never negative, or -1
+  static int loop_index_num_bits(LoopIndexStmt *stmt) {
+    // The indices of struct-fors may be shifted by the offsets of the SNode,
+    // so only range-fors are considered (including demoted dense
+    // struct-fors)
+    if (auto offload = stmt->loop->cast<OffloadedStmt>()) {
+      if (offload->task_type != OffloadedStmt::TaskType::range_for)
+        return -1;
+    } else if (!stmt->loop->is<RangeForStmt>()) {
+      return -1;
+    }
+    return stmt->max_num_bits();
+  }
+
+  static std::optional<IndexBits> shift(const IndexBits &a, int amount) {
+    IndexBits result = a;
+    result.bits.fill(-1);
+    for (int d = 0; d < IndexBits::num_bits; d++) {
+      if (a.bits[d] == -1)
+        continue;
+      int dst = d + amount;
+      if (dst >= IndexBits::num_bits)
+        return std::nullopt;  // may overflow
+      if (dst >= 0)
+        result.bits[dst] = a.bits[d];
+    }
+    return result;
+  }
+
+  // The sum of two values with disjoint bits
+  static std::optional<IndexBits> combine(const IndexBits &a,
+                                          const IndexBits &b) {
+    if (a.loop == nullptr)
+      return b;
+    if (b.loop == nullptr)
+      return a;
+    if (a.loop != b.loop || a.index != b.index)
+      return std::nullopt;
+    IndexBits result = a;
+    for (int d = 0; d < IndexBits::num_bits; d++) {
+      if (b.bits[d] == -1)
+        continue;
+      if (a.bits[d] != -1)
+        return std::nullopt;
+      result.bits[d] = b.bits[d];
+    }
+    return result;
+  }
+
+  std::optional<IndexBits> analyze(Stmt *stmt) {
+    auto it = cache.find(stmt);
+    if (it != cache.end())
+      return it->second;
+    auto result = compute(stmt);
+    cache[stmt] = result;
+    return result;
+  }
+
+  std::optional<IndexBits> compute(Stmt *stmt) {
+    if (stmt->width() != 1 || stmt->ret_type != PrimitiveType::i32)
+      return std::nullopt;
+    if (auto c = get_const(stmt)) {
+      if (*c == 0)
+        return IndexBits();
+      return std::nullopt;
+    }
+    if (auto loop_index = stmt->cast<LoopIndexStmt>()) {
+      int n = loop_index_num_bits(loop_index);
+      if (n < 0 || n >= IndexBits::num_bits)
+        return std::nullopt;
+      IndexBits result;
+      result.loop = loop_index->loop;
+      result.index = loop_index->index;
+      for (int d = 0; d < n; d++)
+        result.bits[d] = d;
+      return result;
+    }
+    if (auto extract = stmt->cast<BitExtractStmt>()) {
+      if (extract->bit_begin < 0)
+        return std::nullopt;
+      auto input = analyze(extract->input);
+      if (!input)
+        return std::nullopt;
+      // Shifting right never overflows
+      auto result = *shift(*input, -extract->bit_begin);
+      for (int d = std::max(extract->bit_end - extract->bit_begin, 0);
+           d < IndexBits::num_bits; d++) {
+        result.bits[d] = -1;
+      }
+      return result;
+    }
+    auto bin = stmt->cast<BinaryOpStmt>();
+    if (!bin)
+      return std::nullopt;
+    auto op = bin->op_type;
+    if (op == BinaryOpType::add || op == BinaryOpType::bit_or) {
+      auto lhs = analyze(bin->lhs);
+      auto rhs = analyze(bin->rhs);
+      if (!lhs || !rhs)
+        return std::nullopt;
+      return combine(*lhs, *rhs);
+    }
+    if (op == BinaryOpType::mul) {
+      auto a = bin->lhs;
+      auto c = get_const(bin->rhs);
+      if (!c) {
+        a = bin->rhs;
+        c = get_const(bin->lhs);
+      }
+      if (!c || *c < 0 || (*c & (*c - 1)) != 0)
+        return std::nullopt;
+      if (*c == 0)
+        return IndexBits();
+      auto input = analyze(a);
+      if (!input)
+        return std::nullopt;
+      return shift(*input, bit::log2int(*c));
+    }
+    if (op == BinaryOpType::bit_shl || op == BinaryOpType::bit_shr ||
+        op == BinaryOpType::bit_sar) {
+      auto c = get_const(bin->rhs);
+      if (!c || *c < 0 || *c >= IndexBits::num_bits)
+        return std::nullopt;
+      auto input = analyze(bin->lhs);
+      if (!input)
+        return std::nullopt;
+      // The sign bit is zero, so shr and sar are the same
+      return shift(*input, op == BinaryOpType::bit_shl ? (int)*c : -(int)*c);
+    }
+    if (op == BinaryOpType::bit_and) {
+      auto a = bin->lhs;
+      auto c = get_const(bin->rhs);
+      if (!c) {
+        a = bin->rhs;
+        c = get_const(bin->lhs);
+      }
+      if (!c)
+        return std::nullopt;
+      auto input = analyze(a);
+      if (!input)
+        return std::nullopt;
+      for (int d = 0; d < IndexBits::num_bits; d++) {
+        if (!((*c >> d) & 1))
+          input->bits[d] = -1;
+      }
+      return input;
+    }
+    return std::nullopt;
+  }
+
+  void reduce(Stmt *stmt) {
+    auto bits = analyze(stmt);
+    if (!bits)
+      return;
+    VecStatement replacement;
+    int begin, size;
+    if (bits->is_zero()) {
+      replacement.push_back<ConstStmt>(TypedConstant(0));
+    } else if (bits->is_bit_extract(begin, size)) {
+      if (auto extract = stmt->cast<BitExtractStmt>()) {
+        // Already reduced
+        if (extract->input->is<LoopIndexStmt>())
+          return;
+      }
+      auto loop_index =
+          replacement.push_back<LoopIndexStmt>(bits->loop, bits->index);
+      loop_index->ret_type = PrimitiveType::i32;
+      auto extract = replacement.push_back<BitExtractStmt>(loop_index, begin,
+                                                           begin + size);
+      extract->ret_type = PrimitiveType::i32;
+    } else {
+      return;
+    }
+    modifier.replace_with(stmt, std::move(replacement));
+    num_reduced++;
+  }
+
+ public:
+  static int run(IRNode *root) {
+    StrengthReduceIndices pass;
+    auto stmts = irpass::analysis::gather_statements(root, [](Stmt *stmt) {
+      return stmt->is<BinaryOpStmt>() || stmt->is<BitExtractStmt>();
+    });
+    for (auto stmt : stmts) {
+      pass.reduce(stmt);
+    }
+    pass.modifier.modify_ir();
+    return pass.num_reduced;
+  }
+};
+
+}  // namespace
+
+namespace irpass {
+
+bool strength_reduce_indices(IRNode *root) {
+  TI_AUTO_PROF;
+  if (!root->get_config().strength_reduce_indices)
+    return false;
+  int num_reduced = StrengthReduceIndices::run(root);
+  if (num_reduced == 0)
+    return false;
+  stat.add("strength_reduced_indices", num_reduced);
+  TI_DEBUG("[{}] {} index computations strength-reduced",
+           root->get_kernel()->name, num_reduced);
+  return true;
+}
+
+}  // namespace irpass
+
+TLANG_NAMESPACE_END
@@ -1,9 +1,11 @@
+#include <mutex>
 #include <unordered_map>
 
 #include "taichi/common/core.h"
 
 TI_NAMESPACE_BEGIN
 
+// Thread-safe, since passes also run on background compilation threads
 class Statistics {
  public:
   using value_type = float64;
@@ -17,11 +19,10 @@ class Statistics {
 
   void clear();
 
-  inline const counters_map &get_counters() {
-    return counters_;
-  }
+  counters_map get_counters();
 
  private:
+  std::mutex mut_;
   counters_map counters_;
 };
 
@@ -0,0 +1,58 @@
+#include "taichi/ir/frontend.h"
+#include "taichi/ir/statements.h"
+#include "taichi/util/testing.h"
+
+TLANG_NAMESPACE_BEGIN
+
+// The frontend does not generate reversed parallel range-fors, so build one
+// directly: for i in reversed(range(n)): a[i] += 1
+TI_TEST("range_for") {
+  SECTION("reversed_block_bounds") {
+    TI_TEST_PROGRAM;
+    auto &prog = get_current_program();
+    if (!arch_is_cpu(prog.config.arch))
+      return;
+
+    // Block sizes that divide n or not, including adaptive (0)
+    for (int n : {1, 7, 64, 1000}) {
+      for (int block_dim : {0, 1, 3, 16}) {
+        auto kernel = std::make_unique<Kernel>(
+            prog, []() {}, "reversed_range_for");
+        kernel->insert_arg(PrimitiveType::i32, /*is_nparray=*/true);
+        auto block = kernel->ir->as<Block>();
+        auto begin = block->push_back<ConstStmt>(TypedConstant(0));
+        auto end = block->push_back<ConstStmt>(TypedConstant(n));
+        auto range_for =
+            block
+                ->push_back<RangeForStmt>(begin, end, std::make_unique<Block>(),
+                                          /*vectorize=*/1,
+                                          prog.config.cpu_max_num_threads,
+                                          block_dim,
+                                          /*strictly_serialized=*/false)
+                ->as<RangeForStmt>();
+        range_for->reverse();
+        auto body = range_for->body.get();
+        auto index = body->push_back<LoopIndexStmt>(range_for, 0);
+        auto arg = body->push_back<ArgLoadStmt>(0, PrimitiveType::i32,
+                                                /*is_ptr=*/true);
+        auto ptr = body->push_back<ExternalPtrStmt>(
+            LaneAttribute<Stmt *>(arg), std::vector<Stmt *>{index});
+        auto one = body->push_back<ConstStmt>(TypedConstant(1));
+        body->push_back<AtomicOpStmt>(AtomicOpType::add, ptr, one);
+
+        std::vector<int32> a(n, 0);
+        auto ctx = kernel->make_launch_context();
+        ctx.set_arg_nparray(0, (uint64)a.data(), n * sizeof(int32));
+        ctx.set_extra_arg_int(0, 0, n);
+        (*kernel)(ctx);
+        prog.synchronize();
+        // Every iteration runs exactly once
+        for (int i = 0; i < n; i++) {
+          CHECK(a[i] == 1);
+        }
+      }
+    }
+  }
+}
+
+TLANG_NAMESPACE_END
@@ -1,3 +1,5 @@
+import pytest
+
 import taichi as ti
 from taichi import approx
 
@@ -269,3 +271,96 @@ def test_ad_precision_2():
         func()
 
     assert x.grad[None] == 1
+
+
+@ti.all_archs
+def test_tape_checkpointing():
+    steps = 20
+    loss = ti.field(ti.f32, shape=(), needs_grad=True)
+    x = ti.field(ti.f32, shape=steps + 1, needs_grad=True)
+    # A scratch field overwritten in every step. Without checkpointing,
+    # the backward sweep would only see its value of the last step.
+    g = ti.field(ti.f32, shape=())
+
+    @ti.kernel
+    def set_g(t: ti.i32):
+        g[None] = 1 + t * 0.1
+
+    @ti.kernel
+    def advance(t: ti.i32):
+        x[t + 1] = x[t] * g[None]
+
+    @ti.kernel
+    def compute_loss():
+        loss[None] = x[steps]
+
+    x[0] = 1
+    with ti.Tape(loss, checkpoint_fields=[g]):
+        for t in range(steps):
+            set_g(t)
+            advance(t)
+        compute_loss()
+
+    expected = 1.0
+    for t in range(steps):
+        expected *= 1 + t * 0.1
+    assert loss[None] == approx(expected, rel=1e-4)
+    assert x.grad[0] == approx(expected, rel=1e-4)
+
+
+@ti.all_archs
+def test_tape_checkpointing_accumulated_loss():
+    steps = 10
+    loss = ti.field(ti.f32, shape=(), needs_grad=True)
+    x = ti.field(ti.f32, shape=steps + 1, needs_grad=True)
+    g = ti.field(ti.f32, shape=())
+
+    @ti.kernel
+    def set_g(t: ti.i32):
+        g[None] = 1 + t * 0.1
+
+    # Not re-run during the backward pass, as it writes no checkpoint field
+    @ti.kernel
+    def accumulate_loss(t: ti.i32):
+        loss[None] += 0.5 * x[t]
+
+    @ti.kernel
+    def advance(t: ti.i32):
+        x[t + 1] = x[t] * g[None]
+
+    @ti.kernel
+    def compute_loss():
+        loss[None] += x[steps]
+
+    x[0] = 1
+    with ti.Tape(loss, checkpoint_fields=[g]):
+        for t in range(steps):
+            set_g(t)
+            accumulate_loss(t)
+            advance(t)
+        compute_loss()
+
+    prod = 1.0
+    expected = 0.0
+    for t in range(steps):
+        expected += 0.5 * prod
+        prod *= 1 + t * 0.1
+    expected += prod
+    assert loss[None] == approx(expected, rel=1e-4)
+    assert x.grad[0] == approx(expected, rel=1e-4)
+
+
+@ti.all_archs
+def test_tape_checkpointing_mixed_writes():
+    loss = ti.field(ti.f32, shape=(), needs_grad=True)
+    x = ti.field(ti.f32, shape=(), needs_grad=True)
+    g = ti.field(ti.f32, shape=())
+
+    @ti.kernel
+    def set_g_and_loss():
+        g[None] = 2
+        loss[None] += x[None]
+
+    with pytest.raises(RuntimeError):
+        with ti.Tape(loss, checkpoint_fields=[g]):
+            set_g_and_loss()
@@ -364,3 +364,35 @@ def test_complex_body():
 
     for i in range(N):
         assert a.grad[i] == g[i]
+
+
+@ti.test(require=ti.extension.adstack, ad_stack_size=4)
+def test_ad_stack_size_inferred():
+    # The constant trip count exceeds ad_stack_size, so the adstacks must be
+    # sized by the number of pushes instead.
+    N = 10
+    M = 50
+    a = ti.field(ti.f32, shape=N, needs_grad=True)
+    p = ti.field(ti.f32, shape=N, needs_grad=True)
+
+    @ti.kernel
+    def compute():
+        for i in range(N):
+            ret = 1.0
+            for j in range(M):
+                ret = ret * 0.5 + a[i]
+            p[i] = ret
+
+    for i in range(N):
+        a[i] = i
+
+    compute()
+
+    for i in range(N):
+        p.grad[i] = 1
+
+    compute.grad()
+
+    expected = sum(0.5**k for k in range(M))
+    for i in range(N):
+        assert a.grad[i] == ti.approx(expected)
@@ -0,0 +1,86 @@
+import ctypes
+import os
+import shutil
+import tempfile
+
+import pytest
+import taichi as ti
+
+
+@pytest.mark.skipif(shutil.which('cc') is None, reason='No C compiler')
+@ti.test(arch=ti.cpu)
+def test_aot_export_cpu():
+    n = 16
+    x = ti.field(ti.i32, shape=n)
+
+    @ti.kernel
+    def fill(k: ti.i32):
+        for i in x:
+            x[i] = i * k
+
+    @ti.kernel
+    def total() -> ti.i32:
+        s = 0
+        for i in x:
+            s += x[i]
+        return s
+
+    m = ti.aot.Module()
+    m.add_kernel(fill, 0)
+    m.add_kernel(total)
+
+    class Context(ctypes.Structure):
+        _fields_ = [('runtime', ctypes.c_void_p),
+                    ('args', ctypes.c_uint64 * 8),
+                    ('extra_args', (ctypes.c_int32 * 8) * 8)]
+
+    with tempfile.TemporaryDirectory() as dirname:
+        m.save(dirname, 'sim')
+        for ext in ['o', 'h', 'c', 'so']:
+            assert os.path.exists(os.path.join(dirname, f'sim.{ext}'))
+        lib = ctypes.CDLL(os.path.join(dirname, 'sim.so'))
+
+    lib.sim_initialize.restype = ctypes.c_void_p
+    lib.sim_initialize.argtypes = [ctypes.c_size_t]
+    lib.sim_context_init.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+    lib.sim_get_ret_raw.restype = ctypes.c_uint64
+    lib.sim_get_ret_raw.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.sim_finalize.argtypes = [ctypes.c_void_p]
+
+    rt = lib.sim_initialize(64 * 1024 * 1024)
+    assert rt
+    ctx = Context()
+    lib.sim_context_init(rt, ctypes.byref(ctx))
+    ctx.args[0] = 3
+    lib.sim_fill(ctypes.byref(ctx))
+    lib.sim_total(ctypes.byref(ctx))
+    assert ctypes.c_int32(lib.sim_get_ret_raw(rt, 0)).value == 3 * n * (n -
+                                                                        1) // 2
+    lib.sim_finalize(rt)
+
+    # The exported module has its own copy of the fields
+    assert x.to_numpy().sum() == 0
+
+
+@ti.test(arch=ti.cpu)
+def test_aot_export_cpu_rejects_snode_trees():
+    x = ti.field(ti.i32, shape=8)
+    fb = ti.FieldsBuilder()
+    y = ti.field(ti.i32)
+    fb.dense(ti.i, 8).place(y)
+    fb.finalize()
+
+    @ti.kernel
+    def fill_x():
+        for i in x:
+            x[i] = i
+
+    @ti.kernel
+    def copy():
+        for i in y:
+            y[i] = x[i]
+
+    m = ti.aot.Module()
+    m.add_kernel(fill_x)
+    with pytest.raises(RuntimeError, match='outside of ti.root'):
+        m.add_kernel(copy)
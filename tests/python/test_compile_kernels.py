@@ -0,0 +1,32 @@
+import taichi as ti
+
+
+@ti.all_archs
+def test_compile_kernels():
+    n = 8
+    x = ti.field(ti.i32, shape=n)
+
+    def make_kernel(k):
+        @ti.kernel
+        def fill():
+            for i in x:
+                x[i] += i * k
+
+        return fill
+
+    kernels = [make_kernel(k) for k in range(n)]
+
+    @ti.kernel
+    def scale(a: ti.i32):
+        for i in x:
+            x[i] *= a
+
+    compile_times = ti.compile_kernels(*kernels, (scale, 0), num_threads=4)
+    assert len(compile_times) == n + 1
+    assert all(t >= 0 for t in compile_times.values())
+
+    for k in kernels:
+        k()
+    scale(2)
+    for i in range(n):
+        assert x[i] == i * n * (n - 1)
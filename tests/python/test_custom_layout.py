@@ -0,0 +1,72 @@
+import taichi as ti
+
+
+def check_layout(shape, make_layout, bitmasked=False):
+    x = ti.field(ti.i32)
+    count = ti.field(ti.i32, shape=())
+    index = ti.indices(*range(len(shape)))
+    if bitmasked:
+        block = ti.root.bitmasked(index, shape)
+    else:
+        block = ti.root.dense(index, shape)
+    make_layout(block)
+    block.place(x)
+
+    @ti.kernel
+    def fill():
+        for I in ti.grouped(ti.ndrange(*shape)):
+            linear = 0
+            for k in ti.static(range(len(shape))):
+                linear = linear * shape[k] + I[k]
+            if not ti.static(bitmasked) or linear % 3 == 0:
+                x[I] = linear
+
+    @ti.kernel
+    def visit():
+        for I in ti.grouped(x):
+            linear = 0
+            for k in ti.static(range(len(shape))):
+                linear = linear * shape[k] + I[k]
+            # Struct-fors must recover the right indices from the layout
+            if x[I] == linear:
+                count[None] += 1
+
+    fill()
+    visit()
+    num_active = 1
+    for s in shape:
+        num_active *= s
+    if bitmasked:
+        num_active = (num_active + 2) // 3
+    assert count[None] == num_active
+
+    for I in [(0, ) * len(shape), tuple(s - 1 for s in shape)]:
+        linear = 0
+        for k in range(len(shape)):
+            linear = linear * shape[k] + I[k]
+        assert x[I] == linear
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_morton_2d():
+    check_layout((64, 32), lambda block: block.morton())
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_morton_3d_non_pot():
+    check_layout((20, 9, 16), lambda block: block.morton())
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_morton_bitmasked():
+    check_layout((32, 32), lambda block: block.morton(), bitmasked=True)
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_tiled_2d():
+    check_layout((64, 64), lambda block: block.tile(8))
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_tiled_3d():
+    check_layout((16, 32, 8), lambda block: block.tile((4, 8, 2)))
@@ -0,0 +1,45 @@
+import taichi as ti
+
+
+@ti.test(arch=ti.cpu)
+def test_delete_kernel():
+    x = ti.field(ti.i32, shape=4)
+
+    @ti.kernel
+    def fill(k: ti.template()):
+        for i in x:
+            x[i] = i * k
+
+    fill(2)
+    fill(3)
+    assert ti.get_runtime().get_num_compiled_functions() == 2
+    ti.delete_kernel(fill, (2, ))
+    assert ti.get_runtime().get_num_compiled_functions() == 1
+    # Deleting an instance twice has no effect
+    ti.delete_kernel(fill, (2, ))
+
+    fill(2)
+    for i in range(4):
+        assert x[i] == i * 2
+    fill(3)
+    for i in range(4):
+        assert x[i] == i * 3
+
+
+@ti.test(arch=ti.cpu, max_num_kernels=3)
+def test_max_num_kernels():
+    x = ti.field(ti.i32, shape=4)
+
+    @ti.kernel
+    def add(k: ti.template()):
+        for i in x:
+            x[i] += k
+
+    total = 0
+    for r in range(2):
+        for k in range(8):
+            add(k)
+            total += k
+            assert ti.get_runtime().get_num_compiled_functions() <= 3
+    for i in range(4):
+        assert x[i] == total
@@ -208,3 +208,93 @@ def test_dynamic_activate():
     assert l[0] == m
     assert l[1] == 21
     assert l[2] == 21
+
+
+@ti.test(require=ti.extension.sparse)
+def test_dynamic_chunk_directory():
+    n = 64
+    x = ti.field(ti.i32)
+    l = ti.field(ti.i32, shape=n)
+
+    block = ti.root.dense(ti.i, n).dynamic(ti.j,
+                                           1024,
+                                           chunk_size=16,
+                                           chunk_directory=True)
+    block.place(x)
+
+    @ti.kernel
+    def fill():
+        for i in range(n):
+            for j in range(i * 7):
+                ti.append(x.parent(), i, i * 10000 + j)
+
+    @ti.kernel
+    def get_lengths():
+        for i in range(n):
+            l[i] = ti.length(x.parent(), i)
+
+    fill()
+    get_lengths()
+    for i in range(n):
+        assert l[i] == i * 7
+        for j in range(0, i * 7, 5):
+            assert x[i, j] == i * 10000 + j
+
+    # Activating a far element also allocates the chunks before it
+    x[3, 900] = 42
+    assert x[3, 900] == 42
+    assert x[3, 500] == 0
+    get_lengths()
+    assert l[3] == 901
+
+    @ti.kernel
+    def fill_row():
+        for i, j in x:
+            if i == 3 and j >= 21:
+                x[i, j] = j
+
+    fill_row()
+    for j in range(21, 901, 13):
+        assert x[3, j] == j
+
+    block.deactivate_all()
+    get_lengths()
+    for i in range(n):
+        assert l[i] == 0
+    fill()
+    get_lengths()
+    assert l[n - 1] == (n - 1) * 7
+    assert x[n - 1, 1] == (n - 1) * 10000 + 1
+
+
+@ti.test(require=ti.extension.sparse)
+def test_dynamic_chunk_directory_watermark():
+    x = ti.field(ti.i32)
+    chunk_size = 16
+    block = ti.root.dense(ti.i, 4).dynamic(ti.j,
+                                           4096,
+                                           chunk_size=chunk_size,
+                                           chunk_directory=True)
+    block.place(x)
+
+    @ti.kernel
+    def append(i: ti.i32, n: ti.i32):
+        for j in range(n):
+            ti.append(x.parent(), i, j)
+
+    def num_chunks(n):
+        return (n + chunk_size - 1) // chunk_size
+
+    # Appending far past many chunks allocates each chunk exactly once
+    append(0, 3000)
+    assert block.num_dynamically_allocated == num_chunks(3000)
+    assert sorted(x[0, j] for j in range(3000)) == list(range(3000))
+
+    # Activating a far element allocates all the chunks below it
+    x[1, 2000] = 1
+    assert block.num_dynamically_allocated == num_chunks(3000) + num_chunks(
+        2001)
+    append(1, 100)
+    assert block.num_dynamically_allocated == num_chunks(3000) + num_chunks(
+        2101)
+    assert sorted(x[1, j] for j in range(2001, 2101)) == list(range(100))
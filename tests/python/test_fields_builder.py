@@ -0,0 +1,127 @@
+import taichi as ti
+import pytest
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_fields_builder_dense():
+    n = 16
+    x = ti.field(ti.i32, shape=n)
+
+    @ti.kernel
+    def fill_x():
+        for i in x:
+            x[i] += i
+
+    fill_x()
+
+    fb = ti.FieldsBuilder()
+    y = ti.field(ti.i32)
+    fb.dense(ti.i, n).place(y)
+    fb.finalize()
+
+    @ti.kernel
+    def copy():
+        for i in y:
+            y[i] = x[i] * 2
+
+    # Kernels compiled before the new tree still work
+    fill_x()
+    copy()
+    for i in range(n):
+        assert x[i] == i * 2
+        assert y[i] == i * 4
+    y[3] = 7
+    assert y[3] == 7
+    assert x[3] == 6
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_fields_builder_sparse():
+    n = 64
+    x = ti.field(ti.i32, shape=())
+    x[None] = 1
+
+    def make_tree():
+        fb = ti.FieldsBuilder()
+        y = ti.field(ti.i32)
+        fb.pointer(ti.ij, n // 8).dense(ti.ij, 8).place(y)
+        return y, fb.finalize()
+
+    y, tree = make_tree()
+    z, _ = make_tree()
+
+    @ti.kernel
+    def activate(y: ti.template(), k: ti.i32):
+        for i in range(n):
+            y[i, (i * k) % n] = i
+
+    @ti.kernel
+    def total(y: ti.template()) -> ti.i32:
+        s = 0
+        for i, j in y:
+            s += y[i, j] + x[None]
+        return s
+
+    activate(y, 3)
+    activate(z, 5)
+    assert total(y) == n * (n - 1) // 2 + n
+    assert total(z) == n * (n - 1) // 2 + n
+
+    tree.destroy()
+    # z is not affected. The kernels compiled for y still exist, so w takes
+    # another slot.
+    w, tree_w = make_tree()
+    assert tree_w.ptr.snode_tree_id != tree.ptr.snode_tree_id
+    activate(w, 7)
+    assert total(w) == n * (n - 1) // 2 + n
+    assert total(z) == n * (n - 1) // 2 + n
+
+
+@ti.test(arch=ti.cpu)
+def test_fields_builder_destroyed():
+    fb = ti.FieldsBuilder()
+    y = ti.field(ti.i32)
+    fb.dense(ti.i, 8).place(y)
+    tree = fb.finalize()
+
+    @ti.kernel
+    def fill():
+        for i in y:
+            y[i] = i
+
+    fill()
+    assert y[5] == 5
+    tree.destroy()
+
+    with pytest.raises(RuntimeError, match='destroyed SNode tree'):
+        print(y[5])
+    with pytest.raises(RuntimeError, match='destroyed SNode tree'):
+        y[5] = 1
+    # Kernels compiled before, or after, raise as well
+    with pytest.raises(RuntimeError):
+        fill()
+    with pytest.raises(RuntimeError):
+        y.to_numpy()
+
+
+@ti.test(arch=ti.cpu)
+def test_fields_builder_many_trees():
+    # More trees than can exist at the same time
+    for r in range(40):
+        fb = ti.FieldsBuilder()
+        y = ti.field(ti.f32)
+        fb.dense(ti.i, 4).place(y)
+        tree = fb.finalize()
+        y[r % 4] = r
+        assert y[r % 4] == r
+        tree.destroy()
+
+
+@ti.test(arch=ti.cpu)
+def test_root_after_materialization():
+    x = ti.field(ti.f32, shape=4)
+    x[0] = 1
+
+    y = ti.field(ti.f32)
+    with pytest.raises(RuntimeError, match='declared after'):
+        ti.root.dense(ti.i, 4).place(y)
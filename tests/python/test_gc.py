@@ -79,3 +79,76 @@ def test_pointer_gc():
 
         # Note that being inactive doesn't mean it's not allocated.
         assert L.num_dynamically_allocated == 1
+
+
+def _test_pointer_gc_reactivate():
+    x = ti.field(dtype=ti.i32)
+
+    L = ti.root.pointer(ti.i, 64)
+    L.dense(ti.i, 16).place(x)
+
+    @ti.kernel
+    def fill(k: ti.i32):
+        for i in range(64 * 16):
+            if i % 3 == k % 3:
+                x[i] = i + k
+
+    @ti.kernel
+    def check(k: ti.i32):
+        for i in x:
+            if i % 3 == k % 3:
+                assert x[i] == i + k
+            else:
+                # Recycled nodes must be zero-filled before reuse
+                assert x[i] == 0
+
+    for k in range(10):
+        fill(k)
+        check(k)
+        L.deactivate_all()
+        assert L.num_dynamically_allocated <= 64
+
+
+@ti.test(require=ti.extension.sparse, debug=True)
+def test_pointer_gc_reactivate():
+    _test_pointer_gc_reactivate()
+
+
+@ti.test(require=ti.extension.sparse, debug=True, gc_lazy_zero_fill=True)
+def test_pointer_gc_reactivate_lazy_zero_fill():
+    _test_pointer_gc_reactivate()
+
+
+@ti.test(arch=ti.cpu, debug=True, cpu_parallel_gc=False)
+def test_pointer_gc_reactivate_serial():
+    _test_pointer_gc_reactivate()
+
+
+@ti.test(arch=ti.cpu, compact_sparse_memory=True)
+def test_pointer_gc_release_memory():
+    x = ti.field(dtype=ti.i32)
+
+    L = ti.root.pointer(ti.ij, 128)
+    L.dense(ti.ij, 4).place(x)
+
+    @ti.kernel
+    def fill():
+        for i, j in ti.ndrange(512, 512):
+            x[i, j] = 1
+
+    @ti.kernel
+    def count() -> ti.i32:
+        s = 0
+        for i, j in x:
+            s += x[i, j]
+        return s
+
+    for k in range(3):
+        fill()
+        assert L.num_dynamically_allocated == 128 * 128
+        L.deactivate_all()
+        assert L.num_bytes_released >= 128 * 128 * 4 * 4 * 4 // 2
+        x[0, 0] += 0
+        # Released nodes must read as zeros once reactivated
+        assert count() == 0
+        L.deactivate_all()
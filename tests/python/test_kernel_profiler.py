@@ -0,0 +1,35 @@
+import json
+import os
+import tempfile
+
+import taichi as ti
+
+
+@ti.test(arch=ti.cpu, kernel_profiler=True)
+def test_kernel_profiler_dump():
+    n = 1024
+    x = ti.field(ti.i32, shape=n)
+
+    @ti.kernel
+    def fill():
+        for i in x:
+            x[i] = i
+
+    for _ in range(10):
+        fill()
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        filename = os.path.join(tmpdir, 'profile.json')
+        ti.kernel_profiler_dump(filename)
+        with open(filename) as f:
+            profile = json.load(f)
+
+    records = [r for r in profile['records'] if r['name'].startswith('fill')]
+    assert len(records) == 1
+    rec = records[0]
+    assert rec['count'] == 10
+    assert rec['task_type'] == 'range_for'
+    assert rec['min_ms'] <= rec['avg_ms'] <= rec['max_ms']
+    # Percentiles are bucket midpoints, which may exceed the bounds slightly
+    assert rec['p50_ms'] <= rec['p99_ms'] <= rec['max_ms'] * 1.1
+    assert 'range_for' in [t['task_type'] for t in profile['task_types']]
@@ -0,0 +1,88 @@
+import os
+import tempfile
+
+import taichi as ti
+
+
+def particles():
+    n = 1024
+    pos, vel, s, a, b, c = [ti.field(ti.f32) for _ in range(6)]
+    for f in [pos, vel, s]:
+        ti.root.dense(ti.i, n).place(f)
+    ti.root.dense(ti.i, n).place(a, b, c)
+
+    @ti.kernel
+    def init():
+        for i in range(n):
+            pos[i] = i
+            vel[i] = i * 2
+            a[i] = 1
+            b[i] = i
+            c[i] = 3
+
+    # pos and vel are gathered together
+    @ti.kernel
+    def gather():
+        for i in range(n):
+            j = i * 37 % n
+            s[i] = pos[j] + vel[j]
+
+    # a is streamed alone
+    @ti.kernel
+    def scale():
+        for i in a:
+            a[i] = a[i] * 2
+
+    # b and c are streamed together
+    @ti.kernel
+    def add():
+        for i in range(n):
+            s[i] += b[i] + c[i]
+
+    init()
+    for _ in range(10):
+        gather()
+        scale()
+        add()
+    for i in range(n):
+        j = i * 37 % n
+        assert s[i] == j * 3 + i + 3
+        assert a[i] == 1024
+    return pos, vel, s, a, b, c
+
+
+def group_ids(groups):
+    return sorted(sorted(f.ptr.id for f in g) for g in groups)
+
+
+@ti.test(arch=[ti.cpu, ti.cuda], layout_advisor=True)
+def test_layout_advisor_proposal():
+    pos, vel, s, a, b, c = particles()
+    ids = lambda *fields: sorted(f.snode.ptr.id for f in fields)
+
+    advice = ti.layout_advice()
+    assert group_ids(advice['current']) == sorted(
+        [ids(pos), ids(vel), ids(s), ids(a, b, c)])
+    assert group_ids(advice['proposed']) == sorted(
+        [ids(pos, vel), ids(s), ids(a), ids(b, c)])
+    assert advice['proposed_bytes'] < advice['current_bytes']
+    ti.print_layout_advice()
+
+
+@ti.test(arch=ti.cpu, layout_advisor=True)
+def test_layout_advisor_apply():
+    particles()
+    with tempfile.TemporaryDirectory() as dirname:
+        filename = os.path.join(dirname, 'advice.txt')
+        ti.save_layout_advice(filename)
+
+        ti.init(arch=ti.cpu, layout_advisor=True, layout_advice_file=filename)
+        pos, vel, s, a, b, c = particles()
+    parent = lambda f: f.snode.parent().ptr.id
+    assert parent(pos) == parent(vel)
+    assert parent(b) == parent(c)
+    assert len({parent(pos), parent(s), parent(a), parent(b)}) == 4
+
+    # Nothing left to improve
+    advice = ti.layout_advice()
+    assert advice['proposed_bytes'] == advice['current_bytes']
@@ -0,0 +1,141 @@
+import taichi as ti
+
+
+@ti.all_archs
+def test_licm_invariant_load():
+    n, m = 16, 32
+    a = ti.field(ti.f32, shape=n)
+    b = ti.field(ti.f32, shape=m)
+    c = ti.field(ti.f32, shape=(n, m))
+
+    @ti.kernel
+    def run(k: ti.i32):
+        for i in range(n):
+            for j in range(m):
+                # a[i] and a[i] * k are invariant in the inner loop
+                c[i, j] = a[i] * k + b[j]
+
+    for i in range(n):
+        a[i] = i
+    for j in range(m):
+        b[j] = j * 0.5
+    stats = ti.get_kernel_stats()
+    stats.clear()
+    run(3)
+    assert stats.get_counters().get('licm_hoisted_statements', 0) > 0
+    for i in range(n):
+        for j in range(m):
+            assert c[i, j] == i * 3 + j * 0.5
+
+
+@ti.all_archs
+def test_licm_aliased_store():
+    n = 16
+    x = ti.field(ti.i32, shape=n)
+    y = ti.field(ti.i32, shape=n)
+
+    @ti.kernel
+    def run():
+        for _ in range(1):
+            for j in range(n):
+                # x[0] is written in the loop and must be reloaded
+                x[0] += 1
+                y[j] = x[0]
+
+    run()
+    for j in range(n):
+        assert y[j] == j + 1
+
+
+@ti.all_archs
+def test_licm_empty_range():
+    x = ti.field(ti.i32, shape=())
+    y = ti.field(ti.i32, shape=())
+
+    @ti.kernel
+    def run(d: ti.i32, k: ti.i32):
+        for _ in range(1):
+            for j in range(k):
+                # Must not divide by zero when the loop runs no iteration
+                y[None] += x[None] // d
+
+    x[None] = 10
+    run(0, 0)
+    assert y[None] == 0
+    run(2, 4)
+    assert y[None] == 20
+
+
+@ti.all_archs
+def test_licm_continue():
+    n = 16
+    x = ti.field(ti.i32, shape=n)
+    y = ti.field(ti.i32, shape=())
+
+    @ti.kernel
+    def run(d: ti.i32):
+        for _ in range(1):
+            for j in range(n):
+                if j < n - 1:
+                    continue
+                # Only executed in the last iteration
+                x[j] = y[None] // d
+
+    y[None] = 6
+    run(3)
+    assert x[n - 1] == 2
+
+
+@ti.test(require=ti.extension.assertion, debug=True, gdb_trigger=False)
+def test_licm_assert():
+    n = 16
+    x = ti.field(ti.i32, shape=n)
+    y = ti.field(ti.i32, shape=())
+
+    @ti.kernel
+    def checked_first(d: ti.i32):
+        for _ in range(1):
+            for j in range(n):
+                assert d != 0
+                # May only be evaluated once the assertion has passed
+                x[j] = y[None] // d
+
+    @ti.kernel
+    def checked_last(d: ti.i32):
+        for _ in range(1):
+            for j in range(n):
+                x[j] = y[None] // d
+                assert d != 0
+
+    def num_hoisted(kernel):
+        stats = ti.get_kernel_stats()
+        stats.clear()
+        kernel(3)
+        return stats.get_counters().get('licm_hoisted_statements', 0)
+
+    y[None] = 6
+    # The load of y[None] and the division are hoisted only if they are
+    # executed before the assertion
+    assert num_hoisted(checked_first) < num_hoisted(checked_last)
+    for j in range(n):
+        assert x[j] == 2
+
+
+@ti.all_archs
+def test_licm_sparse():
+    n = 16
+    x = ti.field(ti.i32)
+    ti.root.pointer(ti.i, n).place(x)
+
+    @ti.kernel
+    def run():
+        for _ in range(1):
+            for j in range(n):
+                # Activating x[j] changes what the lookup of x[0] returns
+                s = x[0]
+                x[j] = s + 1
+
+    run()
+    assert x[0] == 1
+    for j in range(1, n):
+        assert x[j] == 2
@@ -113,3 +113,38 @@ def test_reduction_different_scale():
     # 1024 and 100000 since OpenGL max threads per group ~= 1792
     for n in [1, 10, 60, 1024, 100000]:
         assert n == func(n)
+
+
+@ti.test(arch=ti.cpu)
+def test_reduction_many_blocks():
+    # Thread-local storage on CPUs lives with the worker threads across
+    # blocks, so every block must keep accumulating into the same slot.
+    n = 100000
+    x = ti.field(ti.i32)
+    ti.root.pointer(ti.i, n // 16).dense(ti.i, 16).place(x)
+    s = ti.field(ti.i32, shape=())
+
+    @ti.kernel
+    def fill():
+        for i in range(n):
+            x[i] = i % 7
+
+    @ti.kernel
+    def range_sum() -> ti.i32:
+        total = 0
+        ti.block_dim(8)
+        for i in range(n):
+            total += x[i]
+        return total
+
+    @ti.kernel
+    def struct_sum():
+        for i in x:
+            s[None] += x[i]
+
+    fill()
+    expected = sum(i % 7 for i in range(n))
+    for _ in range(3):
+        assert range_sum() == expected
+    struct_sum()
+    assert s[None] == expected
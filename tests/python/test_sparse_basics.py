@@ -75,3 +75,64 @@ def test_pointer2():
     assert s[None] == 5 * n
     print(x[257 + n * n * 7])
     assert s[None] == 5 * n
+
+
+@ti.test(require=ti.extension.sparse)
+def test_pointer_small_list_chunks():
+    x = ti.field(ti.i32)
+    n = 4096
+
+    # Enough chunks to overflow the inline chunk table of the runtime lists
+    ptr = ti.root.pointer(ti.i, n, list_chunk_size=2)
+    ptr.dense(ti.i, 2, list_chunk_size=2).place(x)
+
+    @ti.kernel
+    def fill():
+        for i in range(n * 2):
+            x[i] = i
+
+    @ti.kernel
+    def total() -> ti.i32:
+        s = 0
+        for i in x:
+            s += x[i]
+        return s
+
+    fill()
+    assert total() == n * (2 * n - 1)
+    assert ptr.num_dynamically_allocated == n
+
+
+@ti.test(require=ti.extension.sparse)
+def test_pointer_contended_activation():
+    x = ti.field(ti.i32)
+    c = ti.field(ti.i32, shape=())
+    n = 16
+
+    ptr = ti.root.pointer(ti.i, n)
+    ptr.dense(ti.i, 64).place(x)
+
+    @ti.kernel
+    def scatter():
+        # All iterations race to activate the same few cells
+        for i in range(1024 * 64):
+            x[i % 4 * 64 + i // 1024 % 64] += 1
+
+    @ti.kernel
+    def count():
+        for i in ptr:
+            c[None] += 1
+
+    @ti.kernel
+    def clear():
+        for i in ptr:
+            ti.deactivate(ptr, i)
+
+    for _ in range(3):
+        c[None] = 0
+        scatter()
+        count()
+        assert c[None] == 4
+        for i in range(4 * 64):
+            assert x[i] == 256
+        clear()
@@ -22,3 +22,56 @@ def test_simple():
     for i in range(n - 1):
         assert x[i] == 1
         assert y[i + 1] == 2
+
+
+def _test_sparse_stencil(offset):
+    x = ti.field(ti.i32)
+    y = ti.field(ti.i32)
+    n, b = 64, 8
+
+    block = ti.root.pointer(ti.ij, n // b).dense(ti.ij, b)
+    block.place(x, offset=offset)
+    block.place(y, offset=offset)
+    lo = offset or (0, 0)
+
+    @ti.kernel
+    def activate():
+        # Leave the blocks at the border inactive
+        for i, j in ti.ndrange((lo[0] + b, lo[0] + n - b),
+                               (lo[1] + b, lo[1] + n - b)):
+            x[i, j] = i * 100 + j
+
+    @ti.kernel
+    def stencil():
+        for i, j in x:
+            y[i, j] = x[i - 1, j] + x[i + 1, j] + x[i, j - 1] + x[i, j + 1] + \
+                x[i - 2, j + 2] - 4 * x[i, j]
+
+    activate()
+    stencil()
+
+    def value(i, j):
+        if lo[0] + b <= i < lo[0] + n - b and lo[1] + b <= j < lo[1] + n - b:
+            return i * 100 + j
+        return 0
+
+    neighbors = [(-1, 0), (1, 0), (0, -1), (0, 1), (-2, 2)]
+    for i in range(lo[0] + b, lo[0] + n - b):
+        for j in range(lo[1] + b, lo[1] + n - b):
+            expected = sum(value(i + di, j + dj) for di, dj in neighbors)
+            assert y[i, j] == expected - 4 * value(i, j)
+
+
+@ti.test(require=ti.extension.sparse)
+def test_sparse_stencil():
+    _test_sparse_stencil(None)
+
+
+@ti.test(require=ti.extension.sparse)
+def test_sparse_stencil_offset():
+    _test_sparse_stencil((-16, 8))
+
+
+@ti.test(require=ti.extension.sparse, reuse_neighbor_lookups=False)
+def test_sparse_stencil_no_reuse():
+    _test_sparse_stencil(None)
@@ -0,0 +1,101 @@
+import taichi as ti
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_dense_sweep_3d():
+    x = ti.field(ti.i32, shape=(8, 16, 4))
+    y = ti.field(ti.i32, shape=(8, 16, 4))
+
+    @ti.kernel
+    def fill():
+        for i, j, k in x:
+            x[i, j, k] = i * 100 + j * 10 + k
+
+    @ti.kernel
+    def copy():
+        for i, j, k in y:
+            y[i, j, k] = x[i, j, k] * 2
+
+    fill()
+    copy()
+    for i in range(8):
+        for j in range(16):
+            for k in range(4):
+                assert y[i, j, k] == (i * 100 + j * 10 + k) * 2
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_blocked_layout():
+    x = ti.field(ti.i32)
+    y = ti.field(ti.i32)
+    ti.root.dense(ti.ijk, (2, 4, 2)).dense(ti.ijk, 4).place(x, y)
+
+    @ti.kernel
+    def fill():
+        for i, j, k in x:
+            x[i, j, k] = i * 1000 + j * 10 + k
+
+    @ti.kernel
+    def copy():
+        for i, j, k in x:
+            # Accessed at the loop index, and at a shifted one
+            y[i, j, k] = x[i, j, k] + x[(i + 1) % 8, j, k]
+
+    fill()
+    copy()
+    for i in range(8):
+        for j in range(16):
+            for k in range(8):
+                expected = i * 1000 + j * 10 + k
+                expected += (i + 1) % 8 * 1000 + j * 10 + k
+                assert y[i, j, k] == expected
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_non_power_of_two_shape():
+    x = ti.field(ti.i32, shape=(5, 7, 3))
+
+    @ti.kernel
+    def fill():
+        for i, j, k in x:
+            x[i, j, k] = i * 100 + j * 10 + k
+
+    fill()
+    for i in range(5):
+        for j in range(7):
+            for k in range(3):
+                assert x[i, j, k] == i * 100 + j * 10 + k
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_nested_range_fors():
+    n, m = 16, 32
+    x = ti.field(ti.i32, shape=(n, m))
+
+    @ti.kernel
+    def fill():
+        for i in range(n):
+            for j in range(m):
+                x[i, j] = i * m + j
+
+    fill()
+    for i in range(n):
+        for j in range(m):
+            assert x[i, j] == i * m + j
+
+
+@ti.test(arch=[ti.cpu, ti.cuda])
+def test_range_for_continue():
+    n = 1000
+    x = ti.field(ti.i32, shape=n)
+
+    @ti.kernel
+    def fill():
+        for i in range(n):
+            if i % 3 == 0:
+                continue
+            x[i] = i
+
+    fill()
+    for i in range(n):
+        assert x[i] == (0 if i % 3 == 0 else i)
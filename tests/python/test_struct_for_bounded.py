@@ -0,0 +1,126 @@
+import taichi as ti
+
+
+def _activate_all(x, n):
+    @ti.kernel
+    def activate():
+        for i, j in ti.ndrange(n, n):
+            x[i, j] = i * n + j
+
+    activate()
+
+
+@ti.test(require=ti.extension.sparse)
+def test_bounded_pointer():
+    n = 32
+    x = ti.field(ti.i32)
+    total = ti.field(ti.i32, shape=())
+    count = ti.field(ti.i32, shape=())
+    ti.root.pointer(ti.ij, n // 4).dense(ti.ij, 4).place(x)
+
+    @ti.kernel
+    def sum_box(lo0: ti.i32, lo1: ti.i32, hi0: ti.i32, hi1: ti.i32):
+        for i, j in ti.bounded(x, (lo0, lo1), (hi0, hi1)):
+            total[None] += x[i, j]
+            count[None] += 1
+
+    _activate_all(x, n)
+    for lo0, lo1, hi0, hi1 in [(0, 0, n, n), (3, 5, 18, 7), (4, 8, 12, 16),
+                               (10, 10, 10, 20), (-5, 30, 2, 40)]:
+        total[None] = 0
+        count[None] = 0
+        sum_box(lo0, lo1, hi0, hi1)
+        expected_total = 0
+        expected_count = 0
+        for i in range(max(lo0, 0), min(hi0, n)):
+            for j in range(max(lo1, 0), min(hi1, n)):
+                expected_total += i * n + j
+                expected_count += 1
+        assert total[None] == expected_total
+        assert count[None] == expected_count
+
+
+@ti.test(require=ti.extension.sparse)
+def test_bounded_partially_active():
+    n = 64
+    x = ti.field(ti.i32)
+    ti.root.bitmasked(ti.i, n // 8).dense(ti.i, 8).place(x)
+
+    @ti.kernel
+    def activate():
+        for i in range(n):
+            if i % 16 < 8:
+                x[i] = 1
+
+    @ti.kernel
+    def shift(lo: ti.i32, hi: ti.i32):
+        for i in ti.bounded(x, lo, hi):
+            x[i] += i
+
+    activate()
+    shift(5, 37)
+    for i in range(n):
+        active = i % 16 < 8
+        inside = 5 <= i < 37
+        assert x[i] == (int(active) + (i if active and inside else 0))
+
+
+@ti.test(require=ti.extension.sparse)
+def test_bounded_offset():
+    x = ti.field(ti.i32)
+    ti.root.pointer(ti.ij, 4).dense(ti.ij, 8).place(x, offset=(-16, -16))
+
+    @ti.kernel
+    def fill():
+        for i, j in ti.ndrange((-16, 16), (-16, 16)):
+            x[i, j] = 1
+
+    @ti.kernel
+    def mark(lo: ti.i32, hi: ti.i32):
+        for i, j in ti.bounded(x, (lo, lo), (hi, hi)):
+            x[i, j] = 2
+
+    fill()
+    mark(-10, 3)
+    for i in range(-16, 16):
+        for j in range(-16, 16):
+            inside = -10 <= i < 3 and -10 <= j < 3
+            assert x[i, j] == (2 if inside else 1)
+
+
+@ti.test(require=ti.extension.sparse)
+def test_bounded_grouped():
+    x = ti.field(ti.i32)
+    ti.root.pointer(ti.ij, 4).dense(ti.ij, 4).place(x)
+
+    @ti.kernel
+    def mark():
+        for I in ti.grouped(ti.bounded(x, (2, 6), (9, 14))):
+            x[I] = I[0] * 100 + I[1]
+
+    @ti.kernel
+    def fill():
+        for i, j in ti.ndrange(16, 16):
+            x[i, j] = -1
+
+    fill()
+    mark()
+    for i in range(16):
+        for j in range(16):
+            inside = 2 <= i < 9 and 6 <= j < 14
+            assert x[i, j] == (i * 100 + j if inside else -1)
+
+
+@ti.all_archs
+def test_bounded_dense():
+    x = ti.field(ti.i32, shape=(12, 10))
+
+    @ti.kernel
+    def mark(lo: ti.i32, hi: ti.i32):
+        for i, j in ti.bounded(x, ti.Vector([lo, lo]), ti.Vector([hi, hi])):
+            x[i, j] = 1
+
+    mark(3, 7)
+    for i in range(12):
+        for j in range(10):
+            assert x[i, j] == int(3 <= i < 7 and 3 <= j < 7)
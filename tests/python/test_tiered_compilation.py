@@ -0,0 +1,55 @@
+import time
+
+import taichi as ti
+from taichi.lang.kernel import materialize_kernel
+
+
+@ti.test(arch=ti.cpu, tiered_compilation=True, tiered_compilation_threshold=2)
+def test_tiered_compilation():
+    n = 128
+    x = ti.field(ti.f32, shape=n)
+
+    @ti.kernel
+    def inc(a: ti.f32):
+        for i in x:
+            x[i] += a * i
+
+    for _ in range(50):
+        inc(0.5)
+    # The optimized version is swapped in by the first launch after it is ready
+    t_kernel = materialize_kernel(inc, (0.5, ))
+    num_launches = 50
+    deadline = time.time() + 60
+    while not t_kernel.fully_optimized:
+        assert time.time() < deadline
+        time.sleep(0.01)
+        inc(0.5)
+        num_launches += 1
+    ti.sync()
+    for i in range(n):
+        assert x[i] == num_launches * 0.5 * i
+
+
+@ti.test(arch=ti.cpu, tiered_compilation=True, tiered_compilation_threshold=1)
+def test_tiered_compilation_sparse():
+    x = ti.field(ti.i32)
+    ti.root.pointer(ti.i, 16).bitmasked(ti.i, 8).place(x)
+
+    @ti.kernel
+    def activate(k: ti.i32):
+        for i in range(128):
+            if i % 3 == k % 3:
+                x[i] += 1
+
+    @ti.kernel
+    def count() -> ti.i32:
+        s = 0
+        for i in x:
+            s += x[i]
+        return s
+
+    total = 0
+    for k in range(30):
+        activate(k)
+        total += len([i for i in range(128) if i % 3 == k % 3])
+        assert count() == total
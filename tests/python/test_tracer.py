@@ -0,0 +1,33 @@
+import json
+import os
+import tempfile
+
+import taichi as ti
+
+
+@ti.test(arch=ti.cpu)
+def test_export_trace():
+    x = ti.field(ti.i32, shape=16)
+
+    @ti.kernel
+    def fill():
+        for i in x:
+            x[i] = i
+
+    ti.clear_trace()
+    ti.start_tracing()
+    fill()
+    fill()
+    ti.stop_tracing()
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        filename = os.path.join(tmpdir, 'trace.json')
+        ti.export_trace(filename)
+        with open(filename) as f:
+            events = json.load(f)['traceEvents']
+
+    launches = [e for e in events if e['name'].startswith('fill')]
+    assert len(launches) == 2
+    for e in events:
+        assert e['ph'] == 'X'
+        assert e['dur'] >= 0